@@ -2,6 +2,7 @@
 // This source code is licensed under the BSD license found in the LICENSE file in the root directory of this source tree.
 
 #include "Action.h"
+#include "CompiledExpression.h"
 #include "LaTeXSupport.h"
 #include "Ownership.h"
 #include "Plan.h"
@@ -26,7 +27,21 @@ using std::vector;
 namespace VAL {
 
 Action::~Action() {
-    if (pre) pre->destroy();
+    if (shared)
+        shared->giveBack();
+    else if (pre)
+        pre->destroy();
+    for (map< const expression *, const CompiledExpression * >::iterator i =
+                programs.begin();
+            i != programs.end(); ++i)
+        delete i->second;
+};
+
+const CompiledExpression *Action::getProgram(const expression *e) const {
+    if (shared) return shared->getProgram(vld, e);
+    const CompiledExpression *&p = programs[e];
+    if (!p) p = new CompiledExpression(vld, e, bindings);
+    return p;
 };
 
 bool Action::operator==(const plan_step &ps) const {
@@ -172,7 +187,7 @@ bool DurativeActionElement::confirmPrecondition(const State *s) const {
     if (durs)
         for (goal_list::const_iterator i = durs->begin(); i != durs->end(); ++i) {
             const comparison *c = dynamic_cast< const comparison * >(*i);
-            double d = s->evaluate(c->getRHS(), bindings);
+            double d = getProgram(c->getRHS())->evaluate(s);
             bool test = true;
             switch (c->getOp()) {
             case E_GREATER:
@@ -494,20 +509,24 @@ bool Action::handleEffects(Ownership &o, EffectsRecord &e, const State *s,
     for (list< cond_effect * >::const_iterator i2 = effs->cond_effects.begin();
             i2 != effs->cond_effects.end(); ++i2) {
         // First check preconditions are satisfied.
+        const Proposition *cp =
+            (shared && &bds == &bindings)
+            ? shared->getCondition(vld, (*i2)->getCondition())
+            : 0;
         const Proposition *p =
-            vld->pf.buildProposition((*i2)->getCondition(), bds);
+            cp ? cp : vld->pf.buildProposition((*i2)->getCondition(), bds);
         // cout << "Checking " << *p << " in " << *s << " to get " <<
         // p->evaluate(s)
         // << "\n";
         if (p->evaluate(s)) {
             if ((markPreCons && !p->markOwnedPreconditions(this, o)) ||
                     !handleEffects(o, e, s, (*i2)->getEffects(), bds, markPreCons)) {
-                p->destroy();
+                if (!cp) p->destroy();
                 if (Verbose) *report << "Violation in conditional effect in " << this;
                 return false;
             };
         };
-        p->destroy();
+        if (!cp) p->destroy();
     };
 
     for (list< assignment * >::const_iterator i3 = effs->assign_effects.begin();
@@ -519,7 +538,9 @@ bool Action::handleEffects(Ownership &o, EffectsRecord &e, const State *s,
         // Assignment cannot be applied because of the usual problem of
         // conditional effects. RHS can be evaluated and then the update recorded.
         const FuncExp *lhs = vld->fef.buildFuncExp((*i3)->getFTerm(), bds);
-        FEScalar v = s->evaluate((*i3)->getExpr(), bds);
+        FEScalar v = (&bds == &bindings)
+                     ? getProgram((*i3)->getExpr())->evaluate(s)
+                     : s->evaluate((*i3)->getExpr(), bds);
         if (!o.markOwnedEffectFE(this, lhs, (*i3)->getOp(), (*i3)->getExpr(),
                                  bds)) {
             return false;
@@ -543,12 +564,24 @@ bool Action::handleEffects(Ownership &o, EffectsRecord &e, const State *s,
     return handleEffects(o, e, s, effs, bindings, markPreCons);
 };
 
+CompiledAction *Action::borrowCompiled() {
+    CompiledProblem *cp = vld->getCompiledProblem();
+    return cp ? cp->borrow(vld, act->precondition, bindings) : 0;
+};
+
+void Action::setDuration(double d) {
+    bindings.duration = d;
+    if (shared) shared->setDuration(d);
+};
+
 Action::Action(Validator *v, const operator_ *a, const const_symbol_list *bs)
     : act(a),
       bindings(buildBindings(a, *bs)),
       timedInitialLiteral(a->name->getName().substr(0, 6) == "Timed "),
       vld(v),
-      pre(vld->pf.buildProposition(act->precondition, bindings)),
+      shared(borrowCompiled()),
+      pre(shared ? shared->getPrecondition()
+          : vld->pf.buildProposition(act->precondition, bindings)),
       planStep(0) {
     string n = act->name->getName();
 
@@ -565,7 +598,9 @@ Action::Action(Validator *v, const operator_ *a, Environment *bs)
       bindings(*bs),
       timedInitialLiteral(a->name->getName().substr(0, 6) == "Timed "),
       vld(v),
-      pre(vld->pf.buildProposition(act->precondition, bindings)),
+      shared(borrowCompiled()),
+      pre(shared ? shared->getPrecondition()
+          : vld->pf.buildProposition(act->precondition, bindings)),
       planStep(0) {
     string n = act->name->getName();
 
@@ -585,7 +620,9 @@ Action::Action(Validator *v, const operator_ *a,
       bindings(buildBindings(a, bs)),
       timedInitialLiteral(a->name->getName().substr(0, 6) == "Timed "),
       vld(v),
-      pre(vld->pf.buildProposition(act->precondition, bindings)),
+      shared(borrowCompiled()),
+      pre(shared ? shared->getPrecondition()
+          : vld->pf.buildProposition(act->precondition, bindings)),
       planStep(0) {
     string n = act->name->getName();
 
@@ -603,7 +640,9 @@ Action::Action(Validator *v, const operator_ *a, const const_symbol_list *bs,
       bindings(buildBindings(a, *bs)),
       timedInitialLiteral(a->name->getName().substr(0, 6) == "Timed "),
       vld(v),
-      pre(vld->pf.buildProposition(act->precondition, bindings)),
+      shared(borrowCompiled()),
+      pre(shared ? shared->getPrecondition()
+          : vld->pf.buildProposition(act->precondition, bindings)),
       planStep(ps) {
     string n = act->name->getName();
 
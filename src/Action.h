@@ -26,6 +26,7 @@ struct ExecutionContext;
 struct ActiveCtsEffects;
 class StartAction;
 class EndAction;
+class CompiledAction;
 
 struct safeaction : public action {
     safeaction(operator_symbol *nm, var_symbol_list *ps, goal *pre,
@@ -74,10 +75,20 @@ protected:
 
     Validator *vld;
 
+    // The compiled form of the action lent by the CompiledProblem of vld, if
+    // it has one and the precondition can be shared.
+    CompiledAction *shared;
+    CompiledAction *borrowCompiled();
+    void setDuration(double d);
+
     const Proposition *pre;
     string actionName;
     const plan_step *planStep;
 
+    // numeric expressions of the action compiled against its bindings
+    mutable map< const expression *, const CompiledExpression * > programs;
+    const CompiledExpression *getProgram(const expression *e) const;
+
     bool handleEffects(Ownership &o, EffectsRecord &e, const State *s,
                        const effect_lists *effs, const Environment &env,
                        bool markPreCons) const;
@@ -338,7 +349,7 @@ public:
           invariant(inv),
           ctsEffects(ctsEff),
           condActions(cas) {
-        bindings.duration = duration;
+        setDuration(duration);
     };
     virtual ~DurativeActionElement();
 
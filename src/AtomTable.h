@@ -0,0 +1,161 @@
+// Copyright 2019 - University of Strathclyde, King's College London and Schlumberger Ltd
+// This source code is licensed under the BSD license found in the LICENSE file in the root directory of this source tree.
+
+#ifndef __ATOMTABLE
+#define __ATOMTABLE
+
+#include <cstddef>
+#include <vector>
+
+using std::vector;
+
+// AtomTable interns ground atoms: a head symbol applied to a tuple of argument
+// symbols, each atom mapped to a value. It is a flat open-addressing hash table
+// whose keys are held in a single argument pool, so a lookup hashes and
+// compares the caller's arguments in place and only an insertion copies them.
+//
+// The argument ranges passed in must be forward iterators (though they need
+// not have iterator traits) dereferencing to something convertible to
+// const A *.
+template < class H, class A, class V >
+class AtomTable {
+private:
+    struct Slot {
+        const H *head;  // 0 marks an empty slot
+        size_t hash;
+        unsigned int args;  // offset of the arguments in the pool
+        unsigned int arity;
+        V value;
+
+        Slot() : head(0), hash(0), args(0), arity(0), value() {};
+    };
+
+    vector< Slot > slots;
+    vector< const A * > pool;
+    size_t used;
+
+    static size_t mix(size_t h, const void *p) {
+        h ^= reinterpret_cast< size_t >(p) >> 3;
+        h *= static_cast< size_t >(0x9E3779B97F4A7C15ULL);
+        return h ^ (h >> 29);
+    };
+
+    template < class TI >
+    static size_t hashOf(const H *h, TI s, TI e, unsigned int &arity) {
+        size_t hs = mix(0, h);
+        arity = 0;
+        for (; s != e; ++s, ++arity) hs = mix(hs, static_cast< const A * >(*s));
+        return hs;
+    };
+
+    template < class TI >
+    size_t probe(const H *h, size_t hs, TI s, unsigned int arity) const {
+        const size_t mask = slots.size() - 1;
+        for (size_t i = hs & mask;; i = (i + 1) & mask) {
+            const Slot &sl = slots[i];
+            if (!sl.head) return i;
+            if (sl.hash != hs || sl.head != h || sl.arity != arity) continue;
+            TI a = s;
+            unsigned int k = 0;
+            for (; k < arity; ++k, ++a) {
+                if (pool[sl.args + k] != static_cast< const A * >(*a)) break;
+            };
+            if (k == arity) return i;
+        };
+    };
+
+    void grow() {
+        vector< Slot > old(slots.size() * 2);
+        old.swap(slots);
+        const size_t mask = slots.size() - 1;
+        for (typename vector< Slot >::const_iterator i = old.begin();
+                i != old.end(); ++i) {
+            if (!i->head) continue;
+            size_t j = i->hash & mask;
+            while (slots[j].head) j = (j + 1) & mask;
+            slots[j] = *i;
+        };
+    };
+
+public:
+    AtomTable() : slots(16), pool(), used(0) {};
+
+    // Returns the value interned for the atom, or 0 if it is not present.
+    template < class TI >
+    V *find(const H *h, TI s, TI e) {
+        unsigned int arity;
+        const size_t hs = hashOf(h, s, e, arity);
+        Slot &sl = slots[probe(h, hs, s, arity)];
+        return sl.head ? &sl.value : 0;
+    };
+
+    // Returns the value interned for the atom, inserting v for it first if it
+    // is not already present.
+    template < class TI >
+    V &insert(const H *h, TI s, TI e, const V &v) {
+        unsigned int arity;
+        const size_t hs = hashOf(h, s, e, arity);
+        size_t i = probe(h, hs, s, arity);
+        if (slots[i].head) return slots[i].value;
+
+        if (2 * (used + 1) > slots.size()) {
+            grow();
+            i = probe(h, hs, s, arity);
+        };
+        Slot &sl = slots[i];
+        sl.head = h;
+        sl.hash = hs;
+        sl.args = pool.size();
+        sl.arity = arity;
+        sl.value = v;
+        for (; s != e; ++s) pool.push_back(static_cast< const A * >(*s));
+        ++used;
+        return sl.value;
+    };
+
+    // Removes the atom, if it is present. The entries after it in its run of
+    // slots are moved back into the gap, so lookups never need to step over
+    // removed atoms; its arguments stay in the pool until the table is
+    // cleared.
+    template < class TI >
+    void erase(const H *h, TI s, TI e) {
+        unsigned int arity;
+        const size_t hs = hashOf(h, s, e, arity);
+        size_t i = probe(h, hs, s, arity);
+        if (!slots[i].head) return;
+
+        const size_t mask = slots.size() - 1;
+        for (size_t j = (i + 1) & mask; slots[j].head; j = (j + 1) & mask) {
+            // An entry can fill the gap unless its home lies cyclically
+            // after the gap and no later than the entry itself.
+            const size_t home = slots[j].hash & mask;
+            if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+                continue;
+            slots[i] = slots[j];
+            i = j;
+        };
+        slots[i] = Slot();
+        --used;
+    };
+
+    size_t size() const {
+        return used;
+    };
+
+    void clear() {
+        vector< Slot >(16).swap(slots);
+        pool.clear();
+        used = 0;
+    };
+
+    // Visit every interned value, in no particular order.
+    template < class F >
+    void forEach(F f) const {
+        for (typename vector< Slot >::const_iterator i = slots.begin();
+                i != slots.end(); ++i) {
+            if (i->head) f(i->value);
+        };
+    };
+};
+
+#endif
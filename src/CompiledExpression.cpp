@@ -0,0 +1,146 @@
+// Copyright 2019 - University of Strathclyde, King's College London and Schlumberger Ltd
+// This source code is licensed under the BSD license found in the LICENSE file in the root directory of this source tree.
+
+#include "CompiledExpression.h"
+#include "FuncExp.h"
+#include "Validator.h"
+#include <algorithm>
+
+using std::max;
+
+namespace VAL {
+
+CompiledExpression::CompiledExpression(Validator *v, const expression *e,
+                                       const Environment &bs)
+    : exprn(e), bindings(bs), code(), stack(), interpreted(false) {
+    const unsigned int depth = compile(v, e);
+
+    if (interpreted) {
+        code.clear();
+    } else {
+        stack.resize(depth);
+    };
+};
+
+// Appends the postfix code for e and returns the stack depth it needs.
+unsigned int CompiledExpression::compile(Validator *v, const expression *e) {
+    if (const binary_expression *be =
+                dynamic_cast< const binary_expression * >(e)) {
+        OpCode op;
+        if (dynamic_cast< const div_expression * >(e)) {
+            op = DIV;
+        } else if (dynamic_cast< const minus_expression * >(e)) {
+            op = MINUS;
+        } else if (dynamic_cast< const mul_expression * >(e)) {
+            op = MUL;
+        } else if (dynamic_cast< const plus_expression * >(e)) {
+            op = PLUS;
+        } else {
+            interpreted = true;
+            return 0;
+        };
+        const unsigned int lhs = compile(v, be->getLHS());
+        const unsigned int rhs = compile(v, be->getRHS());
+        code.push_back(Instruction(op));
+        return max(lhs, rhs + 1);
+    };
+
+    if (const num_expression *ne = dynamic_cast< const num_expression * >(e)) {
+        Instruction i(PUSH_VALUE);
+        i.value = ne->double_value();
+        code.push_back(i);
+        return 1;
+    };
+
+    if (const uminus_expression *ue =
+                dynamic_cast< const uminus_expression * >(e)) {
+        const unsigned int d = compile(v, ue->getExpr());
+        code.push_back(Instruction(UMINUS));
+        return d;
+    };
+
+    if (const func_term *ft = dynamic_cast< const func_term * >(e)) {
+        Instruction i(PUSH_FE);
+        i.fe = v->fef.buildFuncExp(ft, bindings);
+        code.push_back(i);
+        return 1;
+    };
+
+    if (const special_val_expr *sp = dynamic_cast< const special_val_expr * >(e)) {
+        if (sp->getKind() == E_TOTAL_TIME) {
+            code.push_back(Instruction(TOTAL_TIME));
+            return 1;
+        };
+        if (sp->getKind() == E_DURATION_VAR) {
+            code.push_back(Instruction(DURATION));
+            return 1;
+        };
+    };
+
+    if (const violation_term *vt = dynamic_cast< const violation_term * >(e)) {
+        Instruction i(VIOLATIONS);
+        i.vt = vt;
+        code.push_back(i);
+        return 1;
+    };
+
+    // #t and anything unrecognised keep the error reporting of the interpreter.
+    interpreted = true;
+    return 0;
+};
+
+FEScalar CompiledExpression::evaluate(const State *s) const {
+    if (interpreted) return s->evaluate(exprn, bindings);
+
+    FEScalar *const st = &stack[0];
+    unsigned int top = 0;
+
+    for (vector< Instruction >::const_iterator i = code.begin(); i != code.end();
+            ++i) {
+        switch (i->op) {
+        case PUSH_VALUE:
+            st[top++] = i->value;
+            break;
+        case PUSH_FE:
+            st[top++] = i->fe->evaluate(s);
+            break;
+        case PLUS:
+            --top;
+            st[top - 1] += st[top];
+            break;
+        case MINUS:
+            --top;
+            st[top - 1] -= st[top];
+            break;
+        case MUL:
+            --top;
+            st[top - 1] *= st[top];
+            break;
+        case DIV:
+            --top;
+            st[top - 1] /= st[top];
+            break;
+        case UMINUS:
+            st[top - 1] = -st[top - 1];
+            break;
+        case DURATION:
+            st[top++] = bindings.duration;
+            break;
+        case TOTAL_TIME:
+            DerivedGoal::noteVolatileRead();
+            if (s->getValidator()->durativePlan())
+                st[top++] = s->getTime();
+            else
+                st[top++] = s->getValidator()->simpleLength();
+            break;
+        case VIOLATIONS:
+            DerivedGoal::noteVolatileRead();
+            st[top++] = s->getValidator()->violationsFor(i->vt->getName());
+            break;
+        };
+    };
+
+    return st[0];
+};
+
+};  // namespace VAL
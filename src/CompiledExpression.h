@@ -0,0 +1,67 @@
+// Copyright 2019 - University of Strathclyde, King's College London and Schlumberger Ltd
+// This source code is licensed under the BSD license found in the LICENSE file in the root directory of this source tree.
+
+#include "State.h"
+#include "ptree.h"
+#include <vector>
+
+#ifndef __COMPILEDEXPRESSION
+#define __COMPILEDEXPRESSION
+
+using std::vector;
+
+namespace VAL {
+
+class FuncExp;
+class Validator;
+
+// A numeric expression lowered, against a fixed set of bindings, into a flat
+// postfix program in which every PNE has already been resolved to its
+// FuncExp. Evaluating it is a single pass over the instructions, without the
+// node type tests and FuncExp lookups that State::evaluate performs on every
+// call. Expressions using anything the compiler does not handle are left to
+// State::evaluate.
+class CompiledExpression {
+private:
+    enum OpCode {
+        PUSH_VALUE,
+        PUSH_FE,
+        PLUS,
+        MINUS,
+        MUL,
+        DIV,
+        UMINUS,
+        DURATION,
+        TOTAL_TIME,
+        VIOLATIONS
+    };
+
+    struct Instruction {
+        OpCode op;
+        union {
+            FEScalar value;
+            const FuncExp *fe;
+            const violation_term *vt;
+        };
+
+        Instruction(OpCode o) : op(o), value(0) {};
+    };
+
+    const expression *exprn;
+    const Environment &bindings;
+
+    vector< Instruction > code;
+    mutable vector< FEScalar > stack;
+    bool interpreted;
+
+    unsigned int compile(Validator *v, const expression *e);
+
+public:
+    CompiledExpression(Validator *v, const expression *e, const Environment &bs);
+
+    FEScalar evaluate(const State *s) const;
+};
+
+};  // namespace VAL
+
+#endif
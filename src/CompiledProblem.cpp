@@ -0,0 +1,126 @@
+// Copyright 2019 - University of Strathclyde, King's College London and Schlumberger Ltd
+// This source code is licensed under the BSD license found in the LICENSE file in the root directory of this source tree.
+
+#include "CompiledProblem.h"
+#include "CompiledExpression.h"
+#include "Validator.h"
+
+namespace VAL {
+
+CompiledAction::~CompiledAction() {
+    if (pre) pre->destroy();
+    for (map< const expression *, const CompiledExpression * >::iterator i =
+                programs.begin();
+            i != programs.end(); ++i)
+        delete i->second;
+    for (map< pair< bool, vector< const goal * > >,
+            const Proposition * >::iterator i = conditions.begin();
+            i != conditions.end(); ++i)
+        if (i->second) i->second->destroy();
+};
+
+const CompiledExpression *CompiledAction::getProgram(Validator *v,
+        const expression *e) {
+    const CompiledExpression *&p = programs[e];
+    if (!p) p = new CompiledExpression(v, e, bindings);
+    return p;
+};
+
+const Proposition *CompiledAction::getCondition(Validator *v,
+        const goal *g) {
+    CompiledProblem *cp = v->getCompiledProblem();
+    pair< bool, vector< const goal * > > key;
+    key.first = CompiledProblem::conjunction(g, key.second);
+    for (vector< const goal * >::const_iterator i = key.second.begin();
+            i != key.second.end(); ++i)
+        if (!cp->isShareable(v, *i)) return 0;
+
+    map< pair< bool, vector< const goal * > >, const Proposition * >::iterator
+    c = conditions.find(key);
+    if (c == conditions.end()) {
+        c = conditions.insert(std::make_pair(
+                                  key, v->pf.buildProposition(g, bindings)))
+            .first;
+    };
+    const_cast< Proposition * >(c->second)->resetCtsFunctions();
+    return c->second;
+};
+
+CompiledProblem::~CompiledProblem() {
+    for (map< ActionKey, vector< CompiledAction * > >::iterator i =
+                actions.begin();
+            i != actions.end(); ++i)
+        for (vector< CompiledAction * >::iterator j = i->second.begin();
+                j != i->second.end(); ++j)
+            delete *j;
+};
+
+bool CompiledProblem::conjunction(const goal *g,
+                                  vector< const goal * > &parts) {
+    if (const conj_goal *cg = dynamic_cast< const conj_goal * >(g)) {
+        parts.assign(cg->getGoals()->begin(), cg->getGoals()->end());
+        return true;
+    };
+    parts.push_back(g);
+    return false;
+};
+
+bool CompiledProblem::isShareable(Validator *v, const goal *g) {
+    map< const goal *, bool >::iterator k = shareable.find(g);
+    if (k != shareable.end()) return k->second;
+
+    bool ans = false;
+    if (dynamic_cast< const comparison * >(g)) {
+        ans = true;
+    } else if (const simple_goal *sg = dynamic_cast< const simple_goal * >(g)) {
+        ans = !v->getDerivRules()->isDerivedPred(sg->getProp()->head->getName());
+    } else if (const conj_goal *cg = dynamic_cast< const conj_goal * >(g)) {
+        ans = true;
+        for (goal_list::const_iterator i = cg->getGoals()->begin();
+                ans && i != cg->getGoals()->end(); ++i)
+            ans = isShareable(v, *i);
+    } else if (const disj_goal *dg = dynamic_cast< const disj_goal * >(g)) {
+        ans = true;
+        for (goal_list::const_iterator i = dg->getGoals()->begin();
+                ans && i != dg->getGoals()->end(); ++i)
+            ans = isShareable(v, *i);
+    } else if (const neg_goal *ng = dynamic_cast< const neg_goal * >(g)) {
+        ans = isShareable(v, ng->getGoal());
+    } else if (const imply_goal *ig = dynamic_cast< const imply_goal * >(g)) {
+        ans = isShareable(v, ig->getAntecedent()) &&
+              isShareable(v, ig->getConsequent());
+    } else if (const named_goal *ng = dynamic_cast< const named_goal * >(g)) {
+        ans = isShareable(v, ng->gl);
+    };
+    shareable[g] = ans;
+    return ans;
+};
+
+CompiledAction *CompiledProblem::borrow(Validator *v, const goal *g,
+                                        const Environment &bs) {
+    if (!g) return 0;
+    ActionKey key(false, vector< const goal * >(), bs);
+    std::get< 0 >(key) = conjunction(g, std::get< 1 >(key));
+    for (vector< const goal * >::const_iterator i = std::get< 1 >(key).begin();
+            i != std::get< 1 >(key).end(); ++i)
+        if (!isShareable(v, *i)) return 0;
+
+    vector< CompiledAction * > &entries = actions[key];
+    for (vector< CompiledAction * >::iterator i = entries.begin();
+            i != entries.end(); ++i) {
+        if (!(*i)->lent) {
+            (*i)->lent = true;
+            if ((*i)->pre)
+                const_cast< Proposition * >((*i)->pre)->resetCtsFunctions();
+            return *i;
+        };
+    };
+
+    CompiledAction *a = new CompiledAction(bs);
+    a->pre = v->pf.buildProposition(g, a->bindings);
+    a->lent = true;
+    entries.push_back(a);
+    return a;
+};
+
+};  // namespace VAL
@@ -0,0 +1,158 @@
+// Copyright 2019 - University of Strathclyde, King's College London and Schlumberger Ltd
+// This source code is licensed under the BSD license found in the LICENSE file in the root directory of this source tree.
+
+#include "FuncExp.h"
+#include "Proposition.h"
+#include "State.h"
+#include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+
+#ifndef __COMPILEDPROBLEM
+#define __COMPILEDPROBLEM
+
+using std::map;
+using std::pair;
+using std::set;
+using std::vector;
+
+namespace VAL {
+
+class Validator;
+
+// A ground action as the Validators of the trial plans see it: the
+// Proposition for its precondition and for the conditions of its conditional
+// effects, and its numeric effects compiled, all against the entry's own copy
+// of the bindings. The trees keep state while an invariant is checked over an
+// interval, so an entry is lent to one Action at a time and a plan running
+// the same ground action twice at once is given two.
+class CompiledAction {
+private:
+    Environment bindings;
+    const Proposition *pre;
+    map< const expression *, const CompiledExpression * > programs;
+    map< pair< bool, vector< const goal * > >, const Proposition * > conditions;
+    bool lent;
+
+    CompiledAction(const CompiledAction &);
+    CompiledAction &operator=(const CompiledAction &);
+
+    friend class CompiledProblem;
+
+public:
+    CompiledAction(const Environment &bs)
+        : bindings(bs), pre(0), programs(), conditions(), lent(false) {};
+    ~CompiledAction();
+
+    const Proposition *getPrecondition() const {
+        return pre;
+    };
+    const CompiledExpression *getProgram(Validator *v, const expression *e);
+    // The condition of a conditional effect of the action, or 0 if it cannot
+    // be shared and must be built by the caller.
+    const Proposition *getCondition(Validator *v, const goal *g);
+
+    // The DURATION of the compiled effects is that of the borrower.
+    void setDuration(double d) {
+        bindings.duration = d;
+    };
+    void giveBack() {
+        lent = false;
+    };
+};
+
+// The parts of validation that depend only on the problem and not on the plan:
+// the interned literals and PNEs, the initial state, and the ground actions
+// the plans have used. The Validators that robustness testing and plan repair
+// build for each trial plan borrow one, so that a trial only builds the atoms
+// and actions its plan reaches that no earlier trial has, and copies the
+// initial state instead of rebuilding it.
+//
+// A ground action is known by the goals of its precondition and its bindings.
+// The split actions of a durative action are given a fresh conj_goal for each
+// step, but its goals are those of the domain, so an action is keyed by the
+// goals of a top level conjunction rather than the conjunction itself. Goals
+// whose Propositions hold state of their own Validator - quantified goals,
+// derived predicates, preferences and constraints - are not shared, and
+// Actions built from them build their own as before.
+//
+// Atoms are still interned on demand, so a CompiledProblem must only be
+// borrowed by Validators running on one thread, and must outlive them.
+class CompiledProblem {
+private:
+    LiteralTable literals;
+    FuncExpTable pnes;
+
+    bool initialKnown;
+    LogicalState initialLiterals;
+    NumericalState initialValues;
+    set< const FuncExp * > initialPNEs;
+
+    typedef std::tuple< bool, vector< const goal * >,
+            map< const var_symbol *, const const_symbol * > >
+            ActionKey;
+    map< ActionKey, vector< CompiledAction * > > actions;
+    map< const goal *, bool > shareable;
+
+    static bool conjunction(const goal *g, vector< const goal * > &parts);
+    bool isShareable(Validator *v, const goal *g);
+
+    friend class CompiledAction;
+
+    CompiledProblem(const CompiledProblem &);
+    CompiledProblem &operator=(const CompiledProblem &);
+
+public:
+    CompiledProblem()
+        : literals(true),
+          pnes(true),
+          initialKnown(false),
+          initialLiterals(),
+          initialValues(),
+          initialPNEs(),
+          actions(),
+          shareable() {};
+    ~CompiledProblem();
+
+    LiteralTable *getLiterals() {
+        return &literals;
+    };
+    FuncExpTable *getPNEs() {
+        return &pnes;
+    };
+
+    // Called as each borrowing Validator is built, so that no trial sees what
+    // an earlier one marked in the atoms.
+    void startTrial() {
+        pnes.resetPNEs();
+    };
+
+    bool knowsInitialState() const {
+        return initialKnown;
+    };
+    void recordInitialState(const LogicalState &ls, const NumericalState &ns,
+                            const set< const FuncExp * > &ps) {
+        initialLiterals = ls;
+        initialValues = ns;
+        initialPNEs = ps;
+        initialKnown = true;
+    };
+    const LogicalState &getInitialLiterals() const {
+        return initialLiterals;
+    };
+    const NumericalState &getInitialValues() const {
+        return initialValues;
+    };
+    const set< const FuncExp * > &getInitialPNEs() const {
+        return initialPNEs;
+    };
+
+    // Lends the compiled form of the ground action with precondition g under
+    // bs, or returns 0 if the precondition cannot be shared.
+    CompiledAction *borrow(Validator *v, const goal *g, const Environment &bs);
+};
+
+};  // namespace VAL
+
+#endif
@@ -5,6 +5,6 @@
 
 namespace VAL {
 
-map< Validator *, vector< Environment * > > Environment::copies =
+thread_local map< Validator *, vector< Environment * > > Environment::copies =
     map< Validator *, vector< Environment * > >();
 };
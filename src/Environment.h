@@ -31,7 +31,9 @@ bool operator!=(T &t1, T &t2) {
 };
 
 struct Environment : public map< const var_symbol *, const const_symbol * > {
-    static map< Validator *, vector< Environment * > > copies;
+    // Copies are owned by the Validator they were made for, and kept per
+    // thread as each Validator runs on a single thread.
+    static thread_local map< Validator *, vector< Environment * > > copies;
 
     double duration;
 
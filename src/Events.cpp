@@ -19,7 +19,12 @@ Events::Events(const operator_list *ops)
       eventsForMutexCheck(),
       oldTriggeredEvents(),
       lastHappeningTime(0),
-      ctsEventTriggered(false)  //, noevents(0)
+      ctsEventTriggered(false),  //, noevents(0)
+      grounded(false),
+      groundEvents(),
+      literalWatchers(),
+      pneWatchers(),
+      unwatched()
 {
     for (operator_list::const_iterator i = ops->begin(); i != ops->end(); ++i) {
         if (event *e = dynamic_cast< event * >(*i)) {
@@ -48,6 +53,12 @@ Events::~Events() {
     };
 
     activeProcesses.clear();
+
+    for (vector< GroundEvent >::iterator g = groundEvents.begin();
+            g != groundEvents.end(); ++g) {
+        g->precondition->destroy();
+        delete g->parameters;
+    };
 };
 
 string Events::getName(operator_ *op, const_symbol_list *csl) const {
@@ -335,45 +346,49 @@ bool Events::triggerDiscreteEvents(Validator *v, bool init) {
         eventTriggered = false;
         vector< const Action * > acts;
 
-        for (vector< event * >::iterator e = ungroundEvents.begin();
-                e != ungroundEvents.end(); ++e) {
-            // cout << "Checking event\n";
-            if (!init || (theCurrentTime != 0)) {
-                listOfParameters =
-                    getParametersDiscreteFinal((*e)->precondition, *e, v->getState());
-            } else {
-                listOfParameters =
-                    getParametersDiscreteInitialFinal((*e)->precondition, *e, v);
-
-                if (!listOfParameters.empty()) {
-                    *report
-                            << "Event preconditions are not permitted to be satisfied in "
-                       "the initial state!\n";
-                    if (!ContinueAnyway) return false;
-                    isOK = false;
+        if (indexedEvents && (!init || (theCurrentTime != 0))) {
+            isOK = triggerIndexedEvents(v, acts) && isOK;
+        } else {
+            for (vector< event * >::iterator e = ungroundEvents.begin();
+                    e != ungroundEvents.end(); ++e) {
+                // cout << "Checking event\n";
+                if (!init || (theCurrentTime != 0)) {
+                    listOfParameters =
+                        getParametersDiscreteFinal((*e)->precondition, *e, v->getState());
+                } else {
+                    listOfParameters =
+                        getParametersDiscreteInitialFinal((*e)->precondition, *e, v);
+
+                    if (!listOfParameters.empty()) {
+                        *report
+                                << "Event preconditions are not permitted to be satisfied in "
+                           "the initial state!\n";
+                        if (!ContinueAnyway) return false;
+                        isOK = false;
+                    };
                 };
-            };
 
-            // add events to a event happening and remove repetitions
-            for (vector< const_symbol_list * >::iterator p =
-                        listOfParameters.begin();
-                    p != listOfParameters.end(); ++p) {
-                if (isTriggered(*e, *p))
-                    isOK = false;
-                else {
-                    const Action *anAction = new Action(
-                        v, *e,
-                        *p);  // include precondition to check for mutex events? yes
-                    acts.push_back(anAction);
-                    triggeredEvents.insert(anAction->getName0());
-                    oldTriggeredEvents.push_back(anAction);
-                };
+                // add events to a event happening and remove repetitions
+                for (vector< const_symbol_list * >::iterator p =
+                            listOfParameters.begin();
+                        p != listOfParameters.end(); ++p) {
+                    if (isTriggered(*e, *p))
+                        isOK = false;
+                    else {
+                        const Action *anAction = new Action(
+                            v, *e,
+                            *p);  // include precondition to check for mutex events? yes
+                        acts.push_back(anAction);
+                        triggeredEvents.insert(anAction->getName0());
+                        oldTriggeredEvents.push_back(anAction);
+                    };
 
-            };  // end of looping thro' parameters
+                };  // end of looping thro' parameters
 
-            deleteParameters(listOfParameters);
+                deleteParameters(listOfParameters);
 
-        };  // end of looping thro' events
+            };  // end of looping thro' events
+        };
 
         // apply events as a happening to the state
         if (acts.size() != 0 && (isOK || ContinueAnyway)) {
@@ -441,6 +456,211 @@ const EndAction *newEndProcess(const StartAction *sa, const_symbol_list *csl,
     return endAct;
 };
 
+// Ground every event and process once, recording against each literal and PNE
+// its precondition reads the ground events and processes to check when it
+// changes.
+void Events::groundEventsAndProcesses(Validator *v) {
+    grounded = true;
+    for (vector< event * >::iterator e = ungroundEvents.begin();
+            e != ungroundEvents.end(); ++e)
+        groundOperator(v, *e);
+    for (vector< process * >::iterator p = ungroundProcesses.begin();
+            p != ungroundProcesses.end(); ++p)
+        groundOperator(v, *p);
+};
+
+void Events::groundOperator(Validator *v, operator_ *op) {
+    vector< vector< const_symbol * > > ranges;
+    for (var_symbol_list::const_iterator i = op->parameters->begin();
+            i != op->parameters->end(); ++i) {
+        ranges.push_back(v->range(*i));
+        if (ranges.back().empty()) return;
+    };
+
+    // step through every combination of objects for the parameters
+    vector< unsigned int > at(ranges.size(), 0);
+    while (true) {
+        const_symbol_list *csl = new const_symbol_list();
+        for (unsigned int k = 0; k < ranges.size(); ++k)
+            csl->push_back(ranges[k][at[k]]);
+        const Environment *env = buildBindings(op, *csl).copy(v);
+
+        GroundEvent ge;
+        ge.op = op;
+        ge.parameters = csl;
+        ge.precondition = v->pf.buildProposition(op->precondition, *env);
+        groundEvents.push_back(ge);
+
+        if (!watchGoal(op->precondition, *env, groundEvents.size() - 1, v))
+            unwatched.push_back(groundEvents.size() - 1);
+
+        unsigned int k = 0;
+        while (k < at.size() && ++at[k] == ranges[k].size()) at[k++] = 0;
+        if (k == at.size()) break;
+    };
+};
+
+// Index ground event n against the literals and PNEs g reads, returning false
+// if g reads anything that cannot be indexed.
+bool Events::watchGoal(const goal *g, const Environment &bs, unsigned int n,
+                       Validator *v) {
+    if (const simple_goal *sg = dynamic_cast< const simple_goal * >(g)) {
+        if (v->getDerivRules() &&
+                v->getDerivRules()->isDerivedPred(sg->getProp()->head->getName()))
+            return false;
+        const unsigned int id = v->pf.buildLiteral(sg->getProp(), bs)->getID();
+        if (id >= literalWatchers.size()) literalWatchers.resize(id + 1);
+        literalWatchers[id].push_back(n);
+        return true;
+    };
+
+    if (const neg_goal *ng = dynamic_cast< const neg_goal * >(g))
+        return watchGoal(ng->getGoal(), bs, n, v);
+
+    if (const imply_goal *ig = dynamic_cast< const imply_goal * >(g))
+        return watchGoal(ig->getAntecedent(), bs, n, v) &&
+               watchGoal(ig->getConsequent(), bs, n, v);
+
+    const goal_list *gs = 0;
+    if (const conj_goal *cg = dynamic_cast< const conj_goal * >(g))
+        gs = cg->getGoals();
+    else if (const disj_goal *dg = dynamic_cast< const disj_goal * >(g))
+        gs = dg->getGoals();
+    if (gs) {
+        for (goal_list::const_iterator i = gs->begin(); i != gs->end(); ++i) {
+            if (!watchGoal(*i, bs, n, v)) return false;
+        };
+        return true;
+    };
+
+    if (const comparison *c = dynamic_cast< const comparison * >(g))
+        return watchExpression(c->getLHS(), bs, n, v) &&
+               watchExpression(c->getRHS(), bs, n, v);
+
+    return false;
+};
+
+bool Events::watchExpression(const expression *e, const Environment &bs,
+                             unsigned int n, Validator *v) {
+    if (const binary_expression *be =
+                dynamic_cast< const binary_expression * >(e))
+        return watchExpression(be->getLHS(), bs, n, v) &&
+               watchExpression(be->getRHS(), bs, n, v);
+
+    if (const uminus_expression *ue =
+                dynamic_cast< const uminus_expression * >(e))
+        return watchExpression(ue->getExpr(), bs, n, v);
+
+    if (dynamic_cast< const num_expression * >(e)) return true;
+
+    if (const func_term *ft = dynamic_cast< const func_term * >(e)) {
+        const unsigned int id = v->fef.buildFuncExp(ft, bs)->getID();
+        if (id >= pneWatchers.size()) pneWatchers.resize(id + 1);
+        pneWatchers[id].push_back(n);
+        return true;
+    };
+
+    return false;
+};
+
+// The ground events and processes whose preconditions may have been changed
+// since the changes recorded in s were last reset, in order.
+vector< unsigned int > Events::touchedEvents(const State &s) const {
+    vector< unsigned int > touched(unwatched);
+
+    const set< const SimpleProposition * > lits = s.getChangedLiterals();
+    for (set< const SimpleProposition * >::const_iterator i = lits.begin();
+            i != lits.end(); ++i) {
+        const unsigned int id = (*i)->getID();
+        if (id < literalWatchers.size())
+            touched.insert(touched.end(), literalWatchers[id].begin(),
+                           literalWatchers[id].end());
+    };
+
+    const set< const FuncExp * > pnes = s.getChangedPNEs();
+    for (set< const FuncExp * >::const_iterator i = pnes.begin();
+            i != pnes.end(); ++i) {
+        const unsigned int id = (*i)->getID();
+        if (id < pneWatchers.size())
+            touched.insert(touched.end(), pneWatchers[id].begin(),
+                           pneWatchers[id].end());
+    };
+
+    sort(touched.begin(), touched.end());
+    touched.erase(unique(touched.begin(), touched.end()), touched.end());
+    return touched;
+};
+
+// As the search over changed literals and PNEs in triggerDiscreteEvents, but
+// checking the preconditions of the ground events the changes touched.
+bool Events::triggerIndexedEvents(Validator *v,
+                                  vector< const Action * > &acts) {
+    if (!grounded) groundEventsAndProcesses(v);
+    bool isOK = true;
+
+    const vector< unsigned int > touched = touchedEvents(v->getState());
+    for (vector< unsigned int >::const_iterator i = touched.begin();
+            i != touched.end(); ++i) {
+        const GroundEvent &ge = groundEvents[*i];
+        event *e = dynamic_cast< event * >(ge.op);
+        if (!e) continue;
+
+        bool satisfied;
+        try {
+            const_cast< Proposition * >(ge.precondition)->resetCtsFunctions();
+            satisfied = ge.precondition->evaluate(&v->getState());
+        } catch (const BadAccessError &bae) {
+            satisfied = false;  // if a PNE is not defined, then no problem,
+            // the event is simply not triggered
+        };
+        if (!satisfied) continue;
+
+        if (isTriggered(e, ge.parameters))
+            isOK = false;
+        else {
+            const Action *anAction = new Action(v, e, ge.parameters);
+            acts.push_back(anAction);
+            triggeredEvents.insert(anAction->getName0());
+            oldTriggeredEvents.push_back(anAction);
+        };
+    };
+
+    return isOK;
+};
+
+// As the search over changed literals and PNEs in triggerDiscreteProcesses,
+// but checking the preconditions of the ground processes the changes touched.
+void Events::triggerIndexedProcesses(Validator *v,
+                                     vector< const Action * > &processes) {
+    if (!grounded) groundEventsAndProcesses(v);
+
+    const vector< unsigned int > touched = touchedEvents(v->getState());
+    for (vector< unsigned int >::const_iterator i = touched.begin();
+            i != touched.end(); ++i) {
+        const GroundEvent &ge = groundEvents[*i];
+        process *p = dynamic_cast< process * >(ge.op);
+        if (!p || isProcessActive(p, ge.parameters)) continue;
+
+        bool satisfied;
+        try {
+            const_cast< Proposition * >(ge.precondition)->resetCtsFunctions();
+            satisfied = ge.precondition->evaluate(&v->getState());
+        } catch (const BadAccessError &e) {
+            satisfied = false;
+        };
+        if (!satisfied) continue;
+
+        const_symbol_list *csl = new const_symbol_list(*ge.parameters);
+        const StartAction *sa = newStartProcessAction(p, csl, v);
+        processes.push_back(sa);
+        const Proposition *prop = v->pf.buildProposition(
+                                      p->precondition, *(buildBindings(p, *csl).copy(v)));
+        activeProcesses[sa] = make_pair(prop, csl);
+        oldTriggeredEvents.push_back(sa);
+        triggeredProcesses.insert(sa);
+    };
+};
+
 // trigger processes given by discrete change
 bool Events::triggerDiscreteProcesses(Validator *v) {
     if (EventPNEJuddering) JudderPNEs = true;
@@ -476,56 +696,60 @@ bool Events::triggerDiscreteProcesses(Validator *v) {
             activeProcesses.erase(*ee);
     };
 
-    for (vector< process * >::const_iterator p = ungroundProcesses.begin();
-            p != ungroundProcesses.end(); ++p) {
-        // for every process check if it could be triggered in the initial state
-        // or later on get list of parameters  (may be empty)
-        vector< const_symbol_list * > listOfParameters;
-        if (time == 0.0) {
-            listOfParameters =
-                getParametersDiscreteInitialFinal((*p)->precondition, *p, v);
-        } else {
-            listOfParameters = getParametersDiscreteFinal(
-                                   (*p)->precondition, *p,
-                                   v->getState());  // need to check for all changes after the event
-            // cascade, this is the best way, only consider the
-            // process if something has changed
-        };
-        // cout << "Process " << (*p)->name->getName() << " with " <<
-        // listOfParameters.size() << "\n";
-
-        // add processes to an event happening and remove repetitions
-        for (vector< const_symbol_list * >::iterator pa =
-                    listOfParameters.begin();
-                pa != listOfParameters.end(); ++pa) {
-            if (!isProcessActive(
-                        *p,
-                        *pa) /*&& !isProcessUntriggered(*p,*pa)*/)  // no need to check
-                // if it has not
-                // been untriggered,
-                // because above we
-                // now check that
-                // the process is
-                // triggered by
-                // something that
-                // has changed
-            {
-                const StartAction *sa = newStartProcessAction(*p, *pa, v);
-                processes.push_back(sa);
-                // only add the precondition to the list of triggered processes, as we
-                // already know it to be satisfied when applied
-                const Proposition *prop = v->pf.buildProposition(
-                                              (*p)->precondition, *(buildBindings(*p, **pa).copy(v)));
-                activeProcesses[sa] = make_pair(prop, *pa);
-                oldTriggeredEvents.push_back(sa);
-                triggeredProcesses.insert(sa);
-                // cout << "Triggered " << *sa << "\n";
-            } else
-                delete *pa;
+    if (indexedEvents && time > 0) {
+        triggerIndexedProcesses(v, processes);
+    } else {
+        for (vector< process * >::const_iterator p = ungroundProcesses.begin();
+                p != ungroundProcesses.end(); ++p) {
+            // for every process check if it could be triggered in the initial state
+            // or later on get list of parameters  (may be empty)
+            vector< const_symbol_list * > listOfParameters;
+            if (time == 0.0) {
+                listOfParameters =
+                    getParametersDiscreteInitialFinal((*p)->precondition, *p, v);
+            } else {
+                listOfParameters = getParametersDiscreteFinal(
+                                       (*p)->precondition, *p,
+                                       v->getState());  // need to check for all changes after the event
+                // cascade, this is the best way, only consider the
+                // process if something has changed
+            };
+            // cout << "Process " << (*p)->name->getName() << " with " <<
+            // listOfParameters.size() << "\n";
 
-        };  // end of looping thro' parameters
+            // add processes to an event happening and remove repetitions
+            for (vector< const_symbol_list * >::iterator pa =
+                        listOfParameters.begin();
+                    pa != listOfParameters.end(); ++pa) {
+                if (!isProcessActive(
+                            *p,
+                            *pa) /*&& !isProcessUntriggered(*p,*pa)*/)  // no need to check
+                    // if it has not
+                    // been untriggered,
+                    // because above we
+                    // now check that
+                    // the process is
+                    // triggered by
+                    // something that
+                    // has changed
+                {
+                    const StartAction *sa = newStartProcessAction(*p, *pa, v);
+                    processes.push_back(sa);
+                    // only add the precondition to the list of triggered processes, as we
+                    // already know it to be satisfied when applied
+                    const Proposition *prop = v->pf.buildProposition(
+                                                  (*p)->precondition, *(buildBindings(*p, **pa).copy(v)));
+                    activeProcesses[sa] = make_pair(prop, *pa);
+                    oldTriggeredEvents.push_back(sa);
+                    triggeredProcesses.insert(sa);
+                    // cout << "Triggered " << *sa << "\n";
+                } else
+                    delete *pa;
 
-    };  // end of looping thro' processes
+            };  // end of looping thro' parameters
+
+        };  // end of looping thro' processes
+    };
 
     // apply processes as a happening to the state
     if (processes.size() != 0) {
@@ -1351,16 +1575,15 @@ const vector< const_symbol_list * > getParametersList(
         string literalName = sg->getProp()->head->getName();
         bool isDerivedPred = v->getDerivRules()->isDerivedPred(literalName);
 
-        LogicalState logState = v->getState().getLogicalState();
+        const State &st = v->getState();
         if (!neg && !isDerivedPred) {
-            for (LogicalState::const_iterator i = logState.begin();
-                    i != logState.end(); ++i) {
-                if (i->second && (i->first->getPropName() == literalName)) {
-                    if (i->first->checkParametersConstantsMatch(sg->getProp()->args)) {
+            for (State::const_iterator i = st.begin(); i != st.end(); ++i) {
+                if ((*i)->getPropName() == literalName) {
+                    if ((*i)->checkParametersConstantsMatch(sg->getProp()->args)) {
                         addToListOfParameters(
                             listOfparameters, lop,
-                            i->first->getConstants(op->parameters, sg->getProp()->args,
-                                                   v));
+                            (*i)->getConstants(op->parameters, sg->getProp()->args,
+                                               v));
                     }
                 };
             };
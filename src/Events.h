@@ -41,6 +41,36 @@ private:
     double lastHappeningTime;
     bool ctsEventTriggered;
 
+    // Events and processes ground over the objects that can bind their
+    // parameters, each with its precondition, together with an index from
+    // literal and PNE IDs to the ground events and processes whose
+    // preconditions read them. After a happening only the ground events and
+    // processes reading something it changed need their preconditions
+    // checked, along with those whose preconditions cannot be indexed
+    // (derived predicates, quantifiers and special values).
+    struct GroundEvent {
+        operator_ *op;
+        const_symbol_list *parameters;
+        const Proposition *precondition;
+    };
+
+    bool grounded;
+    vector< GroundEvent > groundEvents;
+    vector< vector< unsigned int > > literalWatchers;
+    vector< vector< unsigned int > > pneWatchers;
+    vector< unsigned int > unwatched;
+
+    void groundEventsAndProcesses(Validator *v);
+    void groundOperator(Validator *v, operator_ *op);
+    bool watchGoal(const goal *g, const Environment &bs, unsigned int n,
+                   Validator *v);
+    bool watchExpression(const expression *e, const Environment &bs,
+                         unsigned int n, Validator *v);
+    vector< unsigned int > touchedEvents(const State &s) const;
+    bool triggerIndexedEvents(Validator *v, vector< const Action * > &acts);
+    void triggerIndexedProcesses(Validator *v,
+                                 vector< const Action * > &processes);
+
 public:
     Events(const operator_list *ops);
     ~Events();
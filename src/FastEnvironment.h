@@ -8,9 +8,11 @@
 
 using std::vector;
 
+#include <algorithm>
 #include <iterator>
 #include <list>
 
+#include "ObjectPool.h"
 #include "ptree.h"
 
 namespace VAL {
@@ -92,16 +94,56 @@ public:
     };
 };
 
-class FastEnvironment {
+class FastEnvironment : public Pooled< FastEnvironment > {
 private:
-    vector< const_symbol * > syms;
+    // Up to this many bindings are held in place, which covers the
+    // parameters of most operators; more are held on the heap.
+    static const unsigned int inlineSize = 8;
+
+    const_symbol *inlineSyms[inlineSize];
+    const_symbol **syms;
+    unsigned int count;
+
+    void allocate(unsigned int x) {
+        count = x;
+        syms = (x <= inlineSize) ? inlineSyms : new const_symbol *[x];
+    };
+    void release() {
+        if (syms != inlineSyms) delete[] syms;
+    };
 
 public:
-    FastEnvironment(int x) : syms(x, static_cast< const_symbol * >(0)) {};
-    FastEnvironment(const FastEnvironment &other) : syms(other.syms) {};
+    FastEnvironment(int x) {
+        allocate(x);
+        std::fill(syms, syms + count, static_cast< const_symbol * >(0));
+    };
+    FastEnvironment(const FastEnvironment &other) {
+        allocate(other.count);
+        std::copy(other.syms, other.syms + count, syms);
+    };
+    FastEnvironment &operator=(const FastEnvironment &other) {
+        if (this != &other) {
+            release();
+            allocate(other.count);
+            std::copy(other.syms, other.syms + count, syms);
+        };
+        return *this;
+    };
+    ~FastEnvironment() {
+        release();
+    };
 
     void extend(int x) {
-        syms.resize(syms.size() + x, static_cast< const_symbol * >(0));
+        if (!x) return;
+        const_symbol **const old = syms;
+        const unsigned int oldCount = count;
+        allocate(count + x);
+        if (syms != old) {
+            std::copy(old, old + oldCount, syms);
+            if (old != inlineSyms) delete[] old;
+        };
+        std::fill(syms + oldCount, syms + count,
+                  static_cast< const_symbol * >(0));
     };
 
     FastEnvironment *copy() const {
@@ -116,7 +158,7 @@ public:
     };
 
     const_symbol *&operator[](const symbol *s) {
-        static const_symbol *c;
+        static thread_local const_symbol *c;
         if ((c = const_cast< const_symbol * >(
                      dynamic_cast< const const_symbol * >(s)))) {
             return c;
@@ -124,15 +166,15 @@ public:
         return syms[static_cast< const IDsymbol< var_symbol > * >(s)->getId()];
     };
 
-    typedef vector< const_symbol * >::const_iterator const_iterator;
+    typedef const_symbol *const *const_iterator;
     const_iterator begin() const {
-        return syms.begin();
+        return syms;
     };
     const_iterator end() const {
-        return syms.end();
+        return syms + count;
     };
-    const vector< const_symbol * > &getCore() const {
-        return syms;
+    vector< const_symbol * > getCore() const {
+        return vector< const_symbol * >(begin(), end());
     };
 };
 
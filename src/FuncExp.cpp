@@ -33,9 +33,11 @@ double FuncExp::getExternalValue(const State *s) const {
 }
 
 double FuncExp::evaluate(const State *s) const {
+    DerivedGoal::noteRead(this);
     double ans = s->evaluateFE(this);
 
     if (JudderPNEs && hasChangedCtsly) {
+        DerivedGoal::noteVolatileRead();
         ans +=
             RobustPNEJudder *
             (1 - 2 * getRandomNumberUniform());  // if not robustness testing this
@@ -97,12 +99,25 @@ void FuncExp::setChangedCtsly() {
     hasChangedCtsly = true;
 };
 
+void FuncExp::resetChangedCtsly() {
+    hasChangedCtsly = false;
+};
+
 Environment FuncExpFactory::nullEnv;
 
-FuncExpFactory::~FuncExpFactory() {
-    for (map< string, const FuncExp * >::const_iterator i = funcexps.begin();
-            i != funcexps.end(); ++i)
-        delete const_cast< FuncExp * >(i->second);
+void FuncExpTable::resetPNEs() {
+    for (vector< const FuncExp * >::const_iterator i = funcexpsByID.begin();
+            i != funcexpsByID.end(); ++i)
+        const_cast< FuncExp * >(*i)->resetChangedCtsly();
+};
+
+FuncExpTable::~FuncExpTable() {
+    for (vector< const FuncExp * >::const_iterator i = funcexpsByID.begin();
+            i != funcexpsByID.end(); ++i)
+        delete const_cast< FuncExp * >(*i);
+    for (vector< const Environment * >::const_iterator i = bindings.begin();
+            i != bindings.end(); ++i)
+        delete (*i);
 };
 
 };  // namespace VAL
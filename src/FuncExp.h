@@ -6,6 +6,7 @@
 #include <iostream>
 #include <stdlib.h>
 
+#include "AtomTable.h"
 #include "Environment.h"
 #include "Utils.h"
 #include "ptree.h"
@@ -40,9 +41,13 @@ private:
     bool hasChangedCtsly;  // for testing robustness w.r.t. numerical accuracy
     class_def *cd;
 
+    // dense index handed out by the FuncExpFactory, used to address the value
+    // in the fluent array of a State
+    const unsigned int id;
+
 public:
-    FuncExp(const func_term *f, const Environment &bs)
-        : bindings(bs), fe(f), hasChangedCtsly(false), cd(0) {
+    FuncExp(const func_term *f, const Environment &bs, unsigned int i)
+        : bindings(bs), fe(f), hasChangedCtsly(false), cd(0), id(i) {
         const class_func_term *cft = dynamic_cast< const class_func_term * >(fe);
         if (cft) {
             list< class_def * >::iterator cdi =
@@ -61,6 +66,9 @@ public:
     int getArity() const {
         return fe->getArgs()->size();
     }
+    unsigned int getID() const {
+        return id;
+    };
     double evaluate(const State *s) const;
     string getName() const {
         return fe->getFunction()->getName();
@@ -68,6 +76,7 @@ public:
     string getParameter(int paraNo) const;
     bool checkConstantsMatch(const parameter_symbol_list *psl) const;
     void setChangedCtsly();
+    void resetChangedCtsly();
     const Environment *getEnv() {
         return &bindings;
     };
@@ -95,51 +104,98 @@ public:
 
 ostream &operator<<(ostream &o, const FuncExp &fe);
 
+// The interned PNEs, addressed both by function and ground arguments and by
+// their dense IDs. Like a LiteralTable, a shared table keeps its own copies of
+// the bindings its PNEs were built with.
+class FuncExpTable {
+private:
+    AtomTable< func_symbol, parameter_symbol, const FuncExp * > funcexps;
+    vector< const FuncExp * > funcexpsByID;
+
+    const bool shared;
+    vector< const Environment * > bindings;
+
+    FuncExpTable(const FuncExpTable &);
+    FuncExpTable &operator=(const FuncExpTable &);
+
+public:
+    FuncExpTable(bool s = false)
+        : funcexps(), funcexpsByID(), shared(s), bindings() {};
+    ~FuncExpTable();
+
+    const FuncExp *intern(const func_term *f,
+                          const vector< const parameter_symbol * > &args,
+                          const Environment &bs) {
+        const FuncExp *&p = funcexps.insert(f->getFunction(), args.begin(),
+                                            args.end(), (const FuncExp *)0);
+        if (!p) {
+            const Environment *env = &bs;
+            if (shared) {
+                env = new Environment(bs);
+                bindings.push_back(env);
+            };
+            p = new FuncExp(f, *env, funcexpsByID.size());
+            funcexpsByID.push_back(p);
+        };
+        return p;
+    };
+
+    const FuncExp *getFuncExp(unsigned int id) const {
+        return funcexpsByID[id];
+    };
+    unsigned int numFuncExps() const {
+        return funcexpsByID.size();
+    };
+
+    // Forget what the last Validator to use the table recorded in its PNEs.
+    void resetPNEs();
+};
+
 class FuncExpFactory {
 private:
     static Environment nullEnv;
-    map< string, const FuncExp * > funcexps;
+    FuncExpTable ownTable;
+    FuncExpTable &table;
+
+    // ground arguments of the PNE being looked up, reused between lookups
+    vector< const parameter_symbol * > args;
 
 public:
-    const FuncExp *buildFuncExp(const func_term *f) {
-        string s(f->getFunction()->getName());
+    // Interns into t if one is given, otherwise into a table of its own.
+    FuncExpFactory(FuncExpTable *t = 0)
+        : ownTable(), table(t ? *t : ownTable), args() {};
 
-        for (parameter_symbol_list::const_iterator i = f->getArgs()->begin();
-                i != f->getArgs()->end(); ++i) {
-            s += " ";
-            s += (*i)->getName();
-        };
-        map< string, const FuncExp * >::const_iterator i1 = funcexps.find(s);
-        if (i1 != funcexps.end()) return i1->second;
-        const FuncExp *p = funcexps[s] = new FuncExp(f, nullEnv);
-        return p;
+    const FuncExp *buildFuncExp(const func_term *f) {
+        args.assign(f->getArgs()->begin(), f->getArgs()->end());
+        return table.intern(f, args, nullEnv);
     };
     const FuncExp *buildFuncExp(const func_term *f, const Environment &bs) {
-        string s(f->getFunction()->getName());
+        args.clear();
         for (parameter_symbol_list::const_iterator i = f->getArgs()->begin();
                 i != f->getArgs()->end(); ++i) {
-            s += " ";
-            if (dynamic_cast< const var_symbol * >(*i)) {
+            if (const var_symbol *v = dynamic_cast< const var_symbol * >(*i)) {
                 map< const var_symbol *, const const_symbol * >::const_iterator j =
-                    bs.find(dynamic_cast< const var_symbol * >(*i));
+                    bs.find(v);
                 if (j != bs.end()) {
-                    s += j->second->getName();
+                    args.push_back(j->second);
                 } else {
-                    cout << "Error: could not find parameter "
-                         << dynamic_cast< const var_symbol * >(*i)->getName() << "\n";
+                    cout << "Error: could not find parameter " << v->getName()
+                         << "\n";
                     exit(-1);
                 };
             } else {
-                s += (*i)->getName();
+                args.push_back(*i);
             };
         };
-        map< string, const FuncExp * >::const_iterator i1 = funcexps.find(s);
-        if (i1 != funcexps.end()) return i1->second;
-        const FuncExp *p = funcexps[s] = new FuncExp(f, bs);
-        return p;
+        return table.intern(f, args, bs);
     };
 
-    ~FuncExpFactory();
+    const FuncExp *getFuncExp(unsigned int id) const {
+        return table.getFuncExp(id);
+    };
+    unsigned int numFuncExps() const {
+        return table.numFuncExps();
+    };
 };
 
 };  // namespace VAL
@@ -0,0 +1,298 @@
+// Copyright 2019 - University of Strathclyde, King's College London and Schlumberger Ltd
+// This source code is licensed under the BSD license found in the LICENSE file in the root directory of this source tree.
+
+#include "GroundedTaskCache.h"
+#include "ptree.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using std::cerr;
+using std::ifstream;
+using std::map;
+using std::ofstream;
+
+namespace Inst {
+
+namespace {
+
+const char magic[8] = {'V', 'A', 'L', 'G', 'R', 'N', 'D', '\0'};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t operators;
+    uint32_t objects;
+    uint32_t groundOps;
+    uint32_t bindingWords;
+    uint32_t stringBytes;
+    uint64_t domainSize;
+    uint64_t problemSize;
+    uint64_t domainHash;
+    uint64_t problemHash;
+};
+
+// The size of a file and a 64-bit FNV-1a hash of its contents.
+bool fileDigest(const string &name, uint64_t &size, uint64_t &hash) {
+    ifstream in(name.c_str(), std::ios::binary);
+    if (!in) return false;
+    size = 0;
+    hash = 0xcbf29ce484222325ULL;
+    char buffer[65536];
+    while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0) {
+        const std::streamsize n = in.gcount();
+        for (std::streamsize i = 0; i < n; ++i) {
+            hash ^= static_cast< unsigned char >(buffer[i]);
+            hash *= 0x100000001b3ULL;
+        };
+        size += n;
+    };
+    return in.eof();
+};
+
+// The contents of a cache file, mapped into memory where the platform allows
+// it and read into a buffer where it does not.
+class CacheFile {
+private:
+    const char *data;
+    size_t length;
+#ifdef _WIN32
+    vector< char > buffer;
+#endif
+
+public:
+    CacheFile(const string &name) : data(0), length(0) {
+#ifdef _WIN32
+        ifstream in(name.c_str(), std::ios::binary);
+        if (!in) return;
+        buffer.assign(std::istreambuf_iterator< char >(in),
+                      std::istreambuf_iterator< char >());
+        if (!buffer.empty()) {
+            data = &buffer[0];
+            length = buffer.size();
+        };
+#else
+        int fd = open(name.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat s;
+        if (fstat(fd, &s) == 0 && s.st_size > 0) {
+            void *m = mmap(0, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m != MAP_FAILED) {
+                data = static_cast< const char * >(m);
+                length = s.st_size;
+            };
+        };
+        close(fd);
+#endif
+    };
+    ~CacheFile() {
+#ifndef _WIN32
+        if (data) munmap(const_cast< char * >(data), length);
+#endif
+    };
+
+    const char *begin() const {
+        return data;
+    };
+    size_t size() const {
+        return length;
+    };
+};
+
+};  // namespace
+
+vector< int > GroundedTaskCache::instantiateAll(
+    const string &cacheFile, const string &domainFile,
+    const string &problemFile, const VAL::operator_list *ops,
+    const VAL::problem *p, VAL::TypeChecker &tc, const unsigned int &jobs) {
+    vector< int > counts;
+    if (load(cacheFile, domainFile, problemFile, ops, counts)) return counts;
+
+    counts = instantiatedOp::instantiateAll(ops, p, tc, jobs);
+    if (!save(cacheFile, domainFile, problemFile, ops, counts)) {
+        cerr << "Could not write grounded task cache " << cacheFile << "\n";
+    };
+    return counts;
+}
+
+bool GroundedTaskCache::load(const string &cacheFile, const string &domainFile,
+                             const string &problemFile,
+                             const VAL::operator_list *ops,
+                             vector< int > &counts) {
+    CacheFile f(cacheFile);
+    if (f.size() < sizeof(Header)) return false;
+    const Header &h = *reinterpret_cast< const Header * >(f.begin());
+    if (memcmp(h.magic, magic, sizeof(magic)) || h.version != version ||
+            h.operators != ops->size()) {
+        return false;
+    };
+
+    // The file is only trusted for exactly the inputs it was written for:
+    // times are too coarse, and are easily reset, to tell.
+    uint64_t domainSize, domainHash, problemSize, problemHash;
+    if (!fileDigest(domainFile, domainSize, domainHash) ||
+            !fileDigest(problemFile, problemSize, problemHash) ||
+            h.domainSize != domainSize || h.domainHash != domainHash ||
+            h.problemSize != problemSize || h.problemHash != problemHash) {
+        return false;
+    };
+    const size_t words = 3 * size_t(h.operators) + h.objects + h.bindingWords;
+    if (f.size() != sizeof(Header) + words * sizeof(uint32_t) + h.stringBytes) {
+        return false;
+    };
+
+    const uint32_t *opNames =
+        reinterpret_cast< const uint32_t * >(f.begin() + sizeof(Header));
+    const uint32_t *opArities = opNames + h.operators;
+    const uint32_t *opCounts = opArities + h.operators;
+    const uint32_t *objNames = opCounts + h.operators;
+    const uint32_t *bindings = objNames + h.objects;
+    const uint32_t *bindingsEnd = bindings + h.bindingWords;
+    const char *strings = reinterpret_cast< const char * >(bindingsEnd);
+    if (h.stringBytes == 0 || strings[h.stringBytes - 1] != '\0') return false;
+
+    // Match the operators and objects named in the file to the ones parsed.
+    vector< const VAL::operator_ * > opv(ops->begin(), ops->end());
+    for (uint32_t i = 0; i < h.operators; ++i) {
+        if (opNames[i] >= h.stringBytes ||
+                opv[i]->name->getName() != strings + opNames[i] ||
+                opArities[i] != opv[i]->parameters->size()) {
+            return false;
+        };
+    };
+    vector< VAL::const_symbol * > objects(h.objects);
+    for (uint32_t i = 0; i < h.objects; ++i) {
+        if (objNames[i] >= h.stringBytes ||
+                !(objects[i] = VAL::current_analysis->const_tab.symbol_probe(
+                                   strings + objNames[i]))) {
+            return false;
+        };
+    };
+
+    // Check the bindings are well formed before creating any operators, so
+    // that a damaged file leaves the operator store empty.
+    uint32_t ground = 0;
+    for (const uint32_t *b = bindings; b != bindingsEnd; ++ground) {
+        if (*b >= h.operators || size_t(bindingsEnd - b) <= opArities[*b]) {
+            return false;
+        };
+        const uint32_t *const e = b + 1 + opArities[*b];
+        for (++b; b != e; ++b) {
+            if (*b >= h.objects) return false;
+        };
+    };
+    if (ground != h.groundOps) return false;
+
+    for (const uint32_t *b = bindings; b != bindingsEnd;) {
+        const VAL::operator_ *op = opv[*b++];
+        VAL::FastEnvironment e(static_cast< const VAL::id_var_symbol_table * >(
+                                   op->symtab)->numSyms());
+        for (VAL::var_symbol_list::const_iterator v = op->parameters->begin();
+                v != op->parameters->end(); ++v) {
+            e[*v] = objects[*b++];
+        };
+        instantiatedOp *o = new instantiatedOp(op, e.copy());
+        if (instantiatedOp::instOps.insert(o)) {
+            delete o;
+        };
+    };
+    counts.assign(opCounts, opCounts + h.operators);
+    return true;
+}
+
+bool GroundedTaskCache::save(const string &cacheFile, const string &domainFile,
+                             const string &problemFile,
+                             const VAL::operator_list *ops,
+                             const vector< int > &counts) {
+    uint64_t domainSize, domainHash, problemSize, problemHash;
+    if (!fileDigest(domainFile, domainSize, domainHash) ||
+            !fileDigest(problemFile, problemSize, problemHash)) {
+        return false;
+    };
+
+    string strings;
+    vector< uint32_t > opNames, opArities, opCounts, objNames, bindings;
+    map< const VAL::operator_ *, uint32_t > opIndex;
+    map< const VAL::const_symbol *, uint32_t > objIndex;
+
+    for (VAL::operator_list::const_iterator i = ops->begin(); i != ops->end();
+            ++i) {
+        opIndex[*i] = opNames.size();
+        opNames.push_back(strings.size());
+        strings += (*i)->name->getName();
+        strings += '\0';
+        opArities.push_back((*i)->parameters->size());
+    };
+    opCounts.assign(counts.begin(), counts.end());
+
+    for (OpStore::iterator i = instantiatedOp::opsBegin();
+            i != instantiatedOp::opsEnd(); ++i) {
+        bindings.push_back(opIndex[(*i)->forOp()]);
+        for (int a = 0; a < (*i)->arity(); ++a) {
+            const VAL::const_symbol *c = (*i)->getArg(a);
+            map< const VAL::const_symbol *, uint32_t >::const_iterator o =
+                objIndex.find(c);
+            if (o == objIndex.end()) {
+                o = objIndex.insert(std::make_pair(c, objNames.size())).first;
+                objNames.push_back(strings.size());
+                strings += c->getName();
+                strings += '\0';
+            };
+            bindings.push_back(o->second);
+        };
+    };
+
+    Header h;
+    memcpy(h.magic, magic, sizeof(magic));
+    h.version = version;
+    h.operators = opNames.size();
+    h.objects = objNames.size();
+    h.groundOps = instantiatedOp::howMany();
+    h.bindingWords = bindings.size();
+    h.stringBytes = strings.size();
+    h.domainSize = domainSize;
+    h.problemSize = problemSize;
+    h.domainHash = domainHash;
+    h.problemHash = problemHash;
+
+    // Write to a temporary name and rename it, so that a reader never maps a
+    // partly written file.
+    const string temporary = cacheFile + ".tmp";
+    {
+        ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast< const char * >(&h), sizeof(h));
+        const vector< uint32_t > *arrays[] = {&opNames, &opArities, &opCounts,
+                                               &objNames, &bindings
+                                              };
+        for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); ++i) {
+            if (!arrays[i]->empty()) {
+                out.write(reinterpret_cast< const char * >(&(*arrays[i])[0]),
+                          arrays[i]->size() * sizeof(uint32_t));
+            };
+        };
+        out.write(strings.data(), strings.size());
+        if (!out) {
+            remove(temporary.c_str());
+            return false;
+        };
+    };
+#ifdef _WIN32
+    remove(cacheFile.c_str());
+#endif
+    return rename(temporary.c_str(), cacheFile.c_str()) == 0;
+}
+
+};  // namespace Inst
@@ -0,0 +1,97 @@
+// Copyright 2019 - University of Strathclyde, King's College London and Schlumberger Ltd
+// This source code is licensed under the BSD license found in the LICENSE file in the root directory of this source tree.
+
+#include "instantiation.h"
+#include <string>
+#include <vector>
+
+#ifndef __GROUNDEDTASKCACHE
+#define __GROUNDEDTASKCACHE
+
+using std::string;
+using std::vector;
+
+namespace Inst {
+
+/** @brief  A file holding the operators ground for a domain and problem, so
+ * that later runs over the same files can load them instead of grounding.
+ *
+ * The file is a fixed header followed by arrays of 32-bit words, in the byte
+ * order of the machine that wrote it, laid out so that it can be mapped into
+ * memory and read in place:
+ *  - for each operator, its name, arity and the number of ground operators
+ * up to and including its own;
+ *  - for each object, its name;
+ *  - for each ground operator, the index of its operator followed by the
+ * indices of the objects bound to its parameters;
+ *  - the names, end to end, each ended by a zero byte.
+ *
+ * The header records the size and a hash of the contents of the domain and
+ * problem files it was written for. Operators and objects are recorded by
+ * name, so a file is only used if it is of the current version, the domain
+ * and problem files have the same sizes and contents as when it was written,
+ * and every operator it names is still declared with the same arity and every
+ * object it names still exists.
+ *
+ * Only the bindings of the ground operators are cached; this is not a cache
+ * of the whole grounded task. Every run still parses the PDDL and runs the
+ * TIM analysis, because the ground operators, literals and PNEs all refer to
+ * the parse tree and the literals and PNEs are keyed by the typed predicate
+ * and function symbols TIM makes. The literal and PNE stores, the effects and
+ * the static flags are not cached either: the literals and PNEs are collected
+ * from the loaded operators by <code>instantiatedOp::createAllLiterals</code>,
+ * as after grounding, and the static filtering and reachability pruning are
+ * applied afterwards too.
+ *
+ * Nor is loading zero-copy. The file is read in place, but each ground
+ * operator it holds is made afresh, with bindings of its own, and added to the
+ * operator store. What a warm run saves is the search for the bindings.
+ *
+ * The operators are the same however a file is written, so a file written by
+ * one tool can be loaded by another: instantiate and tofn both take
+ * <code>-C</code>.
+ */
+class GroundedTaskCache {
+public:
+    static const unsigned int version = 2;
+
+    /** @brief  Instantiate the operators, as
+     * <code>instantiatedOp::instantiateAll</code> does, loading them from
+     * <code>cacheFile</code> if it can be used for the domain and problem
+     * files, or else grounding them and writing the file.
+     *
+     * @return  For each operator, the number of instantiated operators once
+     * it has been added.
+     */
+    static vector< int > instantiateAll(const string &cacheFile,
+                                        const string &domainFile,
+                                        const string &problemFile,
+                                        const VAL::operator_list *ops,
+                                        const VAL::problem *p,
+                                        VAL::TypeChecker &tc,
+                                        const unsigned int &jobs);
+
+    /** @brief  Add the ground operators in <code>cacheFile</code> to the
+     * operator store, if it can be used.
+     *
+     * @return  <code>false</code>, with nothing added, if the file cannot be
+     * used.
+     */
+    static bool load(const string &cacheFile, const string &domainFile,
+                     const string &problemFile, const VAL::operator_list *ops,
+                     vector< int > &counts);
+
+    /** @brief  Write the operators in the operator store, which must have
+     * been instantiated from <code>ops</code> with the given counts, to
+     * <code>cacheFile</code>.
+     *
+     * @return  <code>false</code> if the file could not be written.
+     */
+    static bool save(const string &cacheFile, const string &domainFile,
+                     const string &problemFile, const VAL::operator_list *ops,
+                     const vector< int > &counts);
+};
+
+};  // namespace Inst
+
+#endif
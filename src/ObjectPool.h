@@ -0,0 +1,166 @@
+// Copyright 2019 - University of Strathclyde, King's College London and Schlumberger Ltd
+// This source code is licensed under the BSD license found in the LICENSE file in the root directory of this source tree.
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#ifndef __OBJECTPOOL
+#define __OBJECTPOOL
+
+namespace VAL {
+
+// Blocks of one size, carved out of large chunks, for the objects grounding
+// makes in their millions.  A freed block is kept for the next allocation
+// rather than handed back to the heap, so making and discarding duplicates
+// costs a couple of pointer moves and a block carries no allocator header.
+//
+// Each thread keeps its own list of free blocks and only takes the pool's lock
+// to move a batch of blocks between that list and the pool, so threads
+// grounding side by side do not contend on every allocation.  A thread's
+// blocks go back to the pool when it exits.  Once its list has been destroyed,
+// the thread takes and returns blocks one at a time under the lock, so an
+// object deleted from the destructor of a static, which runs after the main
+// thread's list is gone, still goes back to the pool.
+//
+// Pools are never destroyed, nor do they shrink: memory freed block by block
+// stays with the pool, so a process keeps the peak it reached.  There is no
+// call to release a pool at teardown, since classes of the same size share it
+// and pooled objects can outlive the stores that made them.
+template < size_t Size >
+class ObjectPool {
+private:
+    union Block {
+        Block *next;
+        alignas(std::max_align_t) char bytes[Size];
+    };
+
+    static const size_t blocksPerChunk =
+        sizeof(Block) >= 4096 ? 16 : 65536 / sizeof(Block);
+    static const size_t blocksPerBatch = 64;
+
+    struct Cache {
+        Block *freeBlocks;
+        size_t count;
+
+        Cache() : freeBlocks(0), count(0) {};
+        ~Cache() {
+            instance().giveBack(*this, count);
+            cacheGone() = true;
+        };
+    };
+
+    std::mutex lock;
+    std::vector< Block * > chunks;
+    Block *freeBlocks;
+    size_t unused;
+
+    ObjectPool() : lock(), chunks(), freeBlocks(0), unused(0) {};
+
+    // The calling thread's free list.
+    Cache &cache() {
+        static thread_local Cache c;
+        return c;
+    };
+
+    // Whether the calling thread's free list has been destroyed.  A bool has
+    // no destructor, so this can still be read once the list is gone.
+    static bool &cacheGone() {
+        static thread_local bool gone = false;
+        return gone;
+    };
+
+    // A block from the pool.  The lock must be held.
+    Block *take() {
+        Block *b = freeBlocks;
+        if (b) {
+            freeBlocks = b->next;
+        } else {
+            if (!unused) {
+                chunks.push_back(static_cast< Block * >(::operator new(
+                                     blocksPerChunk * sizeof(Block))));
+                unused = blocksPerChunk;
+            };
+            b = chunks.back() + (blocksPerChunk - unused--);
+        };
+        return b;
+    };
+
+    void refill(Cache &c) {
+        std::lock_guard< std::mutex > guard(lock);
+        for (size_t k = 0; k < blocksPerBatch; ++k) {
+            Block *b = take();
+            b->next = c.freeBlocks;
+            c.freeBlocks = b;
+        };
+        c.count += blocksPerBatch;
+    };
+
+    void giveBack(Cache &c, size_t n) {
+        if (!n) return;
+        Block *first = c.freeBlocks;
+        Block *last = first;
+        for (size_t k = 1; k < n; ++k) last = last->next;
+        c.freeBlocks = last->next;
+        c.count -= n;
+
+        std::lock_guard< std::mutex > guard(lock);
+        last->next = freeBlocks;
+        freeBlocks = first;
+    };
+
+public:
+    static ObjectPool &instance() {
+        static ObjectPool *const pool = new ObjectPool();
+        return *pool;
+    };
+
+    void *allocate() {
+        if (cacheGone()) {
+            std::lock_guard< std::mutex > guard(lock);
+            return take();
+        };
+        Cache &c = cache();
+        if (!c.freeBlocks) refill(c);
+        Block *b = c.freeBlocks;
+        c.freeBlocks = b->next;
+        --c.count;
+        return b;
+    };
+
+    void deallocate(void *p) {
+        Block *b = static_cast< Block * >(p);
+        if (cacheGone()) {
+            std::lock_guard< std::mutex > guard(lock);
+            b->next = freeBlocks;
+            freeBlocks = b;
+            return;
+        };
+        Cache &c = cache();
+        b->next = c.freeBlocks;
+        c.freeBlocks = b;
+        if (++c.count >= 2 * blocksPerBatch) giveBack(c, blocksPerBatch);
+    };
+};
+
+// Inherit from Pooled< T > to make new and delete of a T use the pool for its
+// size.  Classes derived from T of a different size use the heap as usual.
+template < class T >
+struct Pooled {
+    static void *operator new(size_t size) {
+        if (size == sizeof(T)) return ObjectPool< sizeof(T) >::instance().allocate();
+        return ::operator new(size);
+    };
+    static void operator delete(void *p, size_t size) {
+        if (size == sizeof(T)) {
+            ObjectPool< sizeof(T) >::instance().deallocate(p);
+        } else {
+            ::operator delete(p);
+        };
+    };
+};
+
+};  // namespace VAL
+
+#endif
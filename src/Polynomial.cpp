@@ -292,7 +292,7 @@ Polynomial::~Polynomial() {
     coeffs.clear();
 };
 
-CoScalar Polynomial::accuracy;
+thread_local CoScalar Polynomial::accuracy;
 const CoScalar Polynomial::tooSmall = 1e-12;
 
 CoScalar Polynomial::getCoeff(unsigned int pow) const {
@@ -82,7 +82,7 @@ public:
     static const CoScalar tooSmall;  // regarded as zero or of unknown sign if
     // abs
     // value less than this
-    static CoScalar accuracy;        // accuracy to calculate poly roots
+    static thread_local CoScalar accuracy;  // accuracy to calculate poly roots
 
     CoScalar getCoeff(unsigned int pow) const;
     void setCoeff(unsigned int pow, CoScalar value);
@@ -3,6 +3,7 @@
 
 #include "Proposition.h"
 #include "Action.h"
+#include "CompiledExpression.h"
 #include "Events.h"
 #include "Exceptions.h"
 #include "Plan.h"
@@ -11,6 +12,7 @@
 #include "State.h"
 #include "Utils.h"
 #include "Validator.h"
+#include <algorithm>
 #include <string>
 #include <utility>
 
@@ -30,20 +32,38 @@ Environment SimpleProposition::nullEnvironment;
 Environment DerivedGoal::nullEnvironment;
 // vector<string> DerivedGoal::calledDPs;
 
-map< string, bool > DerivedGoal::DPliterals;
-vector< string > calledDPsCreate;
-vector< string > DerivedGoal::calledDPsEval;
-map< string, pair< int, int > > DerivedGoal::ranks;
+AtomTable< pred_symbol, const_symbol, unsigned int > DerivedGoal::dpIDs;
+PredicateNames DerivedGoal::dpHeads;
+std::mutex DerivedGoal::dpIDsLock;
+thread_local vector< const const_symbol * > DerivedGoal::dpArgs;
+thread_local map< unsigned int, bool > DerivedGoal::DPliterals;
+thread_local vector< unsigned int > calledDPsCreate;
+thread_local vector< unsigned int > DerivedGoal::calledDPsEval;
+thread_local vector< bool > DerivedGoal::onEvalStack;
+thread_local map< unsigned int, pair< int, int > > DerivedGoal::ranks;
 const pair< int, int > DerivedGoal::noRank = make_pair(-1, -1);
-map< string, bool > DerivedGoal::evals;
+thread_local vector< int > DerivedGoal::evals;
 const int DerivedGoal::noEval = -1;
-map< string, Intervals > DerivedGoal::intervals;
+const int DerivedGoal::undefinedEval = -2;
+thread_local map< unsigned int, Intervals > DerivedGoal::intervals;
 const Intervals DerivedGoal::noIntervals = Intervals(true);
-map< string, string > DerivedGoal::propStrings;
+thread_local map< unsigned int, string > DerivedGoal::propStrings;
 const string DerivedGoal::noPropString = "";
-map< string, const Action * > DerivedGoal::preCons;
-const ActiveCtsEffects *DerivedGoal::ace;
-bool DerivedGoal::rhsOpen;
+thread_local map< unsigned int, const Action * > DerivedGoal::preCons;
+thread_local const ActiveCtsEffects *DerivedGoal::ace;
+thread_local bool DerivedGoal::rhsOpen;
+thread_local vector< set< unsigned int > > DerivedGoal::literalReaders;
+thread_local vector< set< unsigned int > > DerivedGoal::pneReaders;
+thread_local vector< set< unsigned int > > DerivedGoal::dpReaders;
+thread_local vector< unsigned int > DerivedGoal::volatileEvals;
+thread_local map< const pred_symbol *, set< unsigned int > >
+DerivedGoal::absentReaders;
+thread_local unsigned int DerivedGoal::literalsKnown = 0;
+thread_local vector< vector< const DerivedGoal * > > DerivedGoal::strata;
+thread_local vector< const DerivedGoal * > DerivedGoal::atomGoals;
+thread_local vector< unsigned int > DerivedGoal::atomStratum;
+thread_local const State *DerivedGoal::evalsState = 0;
+thread_local unsigned long DerivedGoal::evalsSerial = 0;
 
 ostream &operator<<(ostream &o, const Proposition &p) {
     p.write(o);
@@ -804,6 +824,7 @@ bool SimpleProposition::evaluate(const State *s,
         return evaluateEquality(prop, bindings);
     };
 
+    DerivedGoal::noteRead(this);
     bool ans = s->evaluate(this);
     // cout << *this << " is "<< ans << "\n";
     return ans;
@@ -816,24 +837,44 @@ bool SimpleProposition::markOwnedPreconditions(const Action *a, Ownership &o,
 
 bool DerivedGoal::markOwnedPreconditions(const Action *a, Ownership &o,
         ownership w) const {
-    string dpName = getDPName();
+    const unsigned int dp = getDPID();
 
     // cout << " marking precons "<<*this<<"\n";
-    map< string, const Action * >::iterator i = preCons.find(dpName);
+    map< unsigned int, const Action * >::iterator i = preCons.find(dp);
 
     if (i != preCons.end() && i->second == a) return true;
 
-    preCons[dpName] = a;
+    preCons[dp] = a;
 
     bool ans = deriveFormula->markOwnedPreconditions(a, o, w);
 
     return ans;
 };
 
+Comparison::~Comparison() { /*cout<<"deleting "<<*ctsFtn<<"\n";*/
+    delete ctsFtn;
+    delete lhsProgram;
+    delete rhsProgram;
+};
+
+const CompiledExpression *Comparison::getLHSProgram(const State *s) const {
+    if (!lhsProgram)
+        lhsProgram =
+            new CompiledExpression(s->getValidator(), comp->getLHS(), bindings);
+    return lhsProgram;
+};
+
+const CompiledExpression *Comparison::getRHSProgram(const State *s) const {
+    if (!rhsProgram)
+        rhsProgram =
+            new CompiledExpression(s->getValidator(), comp->getRHS(), bindings);
+    return rhsProgram;
+};
+
 // evaluate comparison at a single point
 bool Comparison::evaluateAtPoint(const State *s) const {
-    double lhs = s->evaluate(comp->getLHS(), bindings);
-    double rhs = s->evaluate(comp->getRHS(), bindings);
+    double lhs = getLHSProgram(s)->evaluate(s);
+    double rhs = getRHSProgram(s)->evaluate(s);
 
     switch (comp->getOp()) {
     case E_GREATER:
@@ -859,8 +900,8 @@ bool Comparison::evaluateAtPoint(const State *s) const {
 // evaluate comparison at a single point, but if it is within a certain error
 // then that is OK
 bool Comparison::evaluateAtPointError(const State *s) const {
-    double eval = s->evaluate(comp->getLHS(), bindings) -
-                  s->evaluate(comp->getRHS(), bindings);
+    double eval =
+        getLHSProgram(s)->evaluate(s) - getRHSProgram(s)->evaluate(s);
     double tooSmall = 0.0001;
 
     switch (comp->getOp()) {
@@ -897,6 +938,7 @@ bool Comparison::evaluateAtPointWithinError(
 bool Comparison::evaluate(const State *s,
                           vector< const DerivedGoal * > DPs) const {
     if (ctsFtn == 0) return evaluateAtPointError(s);
+    DerivedGoal::noteVolatileRead();
     // RH proposed Error version here, but seems
     // wrong to me!
     // cout << "CHECK WITH " << rhsIntervalOpen << " " << endOfInterval << "\n";
@@ -1037,22 +1079,22 @@ string SimpleProposition::getPropString(const State *s) const
 };
 
 string DerivedGoal::getPropString(const State *s) const {
-    string dpName = getDPName();
+    const unsigned int dp = getDPID();
 
-    map< string, string >::iterator i = propStrings.find(dpName);
+    map< unsigned int, string >::iterator i = propStrings.find(dp);
 
     if (i != propStrings.end()) {
         if (i->second == noPropString)
-            return "(" + dpName + ")";
+            return "(" + getDPName() + ")";
         else
             return i->second;
     };
 
-    propStrings[dpName] = noPropString;
+    propStrings[dp] = noPropString;
 
     string ans = deriveFormula->getPropString(s);
 
-    propStrings[dpName] = ans;
+    propStrings[dp] = ans;
 
     return ans;
 };
@@ -1188,13 +1230,13 @@ set< const SimpleProposition * > NegGoal::getLiterals() const {
 set< const SimpleProposition * > DerivedGoal::getLiterals() const {
     set< const SimpleProposition * > literalspnes;
 
-    string dpName = getDPName();
+    const unsigned int dp = getDPID();
 
-    map< string, bool >::iterator i = DPliterals.find(dpName);
+    map< unsigned int, bool >::iterator i = DPliterals.find(dp);
 
     if (i != DPliterals.end()) return literalspnes;
 
-    DPliterals[dpName] = true;
+    DPliterals[dp] = true;
 
     literalspnes = deriveFormula->getLiterals();
 
@@ -1294,9 +1336,9 @@ Intervals SimpleProposition::getIntervals(const State *s) const {
 };
 
 Intervals DerivedGoal::getIntervals(const State *s) const {
-    string dpName = getDPName();
+    const unsigned int dp = getDPID();
 
-    map< string, Intervals >::iterator i = intervals.find(dpName);
+    map< unsigned int, Intervals >::iterator i = intervals.find(dp);
 
     if (i != intervals.end()) {
         if (i->second == noIntervals) {
@@ -1306,7 +1348,7 @@ Intervals DerivedGoal::getIntervals(const State *s) const {
             return i->second;
     };
 
-    intervals[dpName] = noIntervals;
+    intervals[dp] = noIntervals;
 
     Intervals ans = deriveFormula->getIntervals(s);
 
@@ -1315,7 +1357,7 @@ Intervals DerivedGoal::getIntervals(const State *s) const {
         ans.intervals.begin();
     if ((j->first.first == 0) && (j->first.second == true) &&
             (j->second.first == endOfInterval) && (j->second.second == true))
-        intervals[dpName] = ans;
+        intervals[dp] = ans;
 
     return ans;
 };
@@ -1917,6 +1959,15 @@ pair< int, int > QfiedGoal::rank() const {
     return pp->rank();
 };
 
+LiteralTable::~LiteralTable() {
+    for (vector< const SimpleProposition * >::iterator i = literalsByID.begin();
+            i != literalsByID.end(); ++i)
+        delete (*i);
+    for (vector< const Environment * >::iterator i = bindings.begin();
+            i != bindings.end(); ++i)
+        delete (*i);
+};
+
 const Proposition *PropositionFactory::buildProposition(const goal *g,
         bool buildNewLiterals,
         const State *state) {
@@ -1939,27 +1990,6 @@ i->second->getName()<<"\\\\\n";
   cout << "\\\\\n";
 };
 */
-string getDPName(const simple_goal *sg, Environment *bs) {
-    string propName = sg->getProp()->head->getName();
-
-    for (parameter_symbol_list::const_iterator i = sg->getProp()->args->begin();
-            i != sg->getProp()->args->end(); ++i) {
-        propName += " ";
-        if (dynamic_cast< const var_symbol * >(*i))
-
-        {
-            propName +=
-                bs->find(dynamic_cast< const var_symbol * >(*i))->second->getName();
-        }
-
-        else {
-            propName += dynamic_cast< const const_symbol * >(*i)->getName();
-        };
-    };
-
-    return propName;
-};
-
 string DerivedGoal::getDPName() const {
     string propName = prop->head->getName();
 
@@ -1979,87 +2009,295 @@ string DerivedGoal::getDPName() const {
     return propName;
 };
 
+unsigned int DerivedGoal::getDPID(const proposition *p,
+                                  const Environment &bs) {
+    dpArgs.clear();
+    for (parameter_symbol_list::const_iterator i = p->args->begin();
+            i != p->args->end(); ++i) {
+        if (const var_symbol *v = dynamic_cast< const var_symbol * >(*i)) {
+            dpArgs.push_back(bs.find(v)->second);
+        } else {
+            dpArgs.push_back(dynamic_cast< const const_symbol * >(*i));
+        };
+    };
+
+    unsigned int id;
+    {
+        std::lock_guard< std::mutex > guard(dpIDsLock);
+        id = dpIDs.insert(dpHeads(p->head), dpArgs.begin(), dpArgs.end(),
+                          (unsigned int)dpIDs.size());
+    };
+    if (id >= evals.size()) addSlots(id);
+    return id;
+};
+
+void DerivedGoal::addSlots(unsigned int dp) {
+    evals.resize(dp + 1, noEval);
+    onEvalStack.resize(dp + 1, false);
+    dpReaders.resize(dp + 1);
+};
+
+void DerivedGoal::clearEvals() {
+    evals.assign(evals.size(), noEval);
+    literalReaders.clear();
+    pneReaders.clear();
+    dpReaders.assign(dpReaders.size(), set< unsigned int >());
+    volatileEvals.clear();
+    absentReaders.clear();
+};
+
+void DerivedGoal::recordRead(const SimpleProposition *sp) {
+    if (sp->getID() >= literalReaders.size())
+        literalReaders.resize(sp->getID() + 1);
+    literalReaders[sp->getID()].insert(calledDPsEval.back());
+};
+
+void DerivedGoal::recordRead(const FuncExp *fe) {
+    if (fe->getID() >= pneReaders.size()) pneReaders.resize(fe->getID() + 1);
+    pneReaders[fe->getID()].insert(calledDPsEval.back());
+};
+
+void DerivedGoal::recordVolatileRead() {
+    volatileEvals.push_back(calledDPsEval.back());
+};
+
+void DerivedGoal::recordAbsentRead(const pred_symbol *p) {
+    {
+        std::lock_guard< std::mutex > guard(dpIDsLock);
+        p = dpHeads(p);
+    };
+    absentReaders[p].insert(calledDPsEval.back());
+};
+
 void DerivedGoal::resetLists(const State *s) {
-    // too much calculating if a changed literal affects a DP
-    // get changed literals and PNEs
-    /* set<const FuncExp *> changedPNEs = s->getChangedPNEs();
-     if(changedPNEs.size() > 0) evals.clear();
-     else
-     {
-        set<const SimpleProposition *> changedLiterals =
-     s->getChangedLiterals(); string SPName;
-        //loop thro' changed literals
-        for(set<const SimpleProposition *>::const_iterator cl =
-     changedLiterals.begin(); cl != changedLiterals.end(); ++cl)
+    intervals.clear();
+    propStrings.clear();
+    preCons.clear();
+
+    updateEvals(s);
+};
+
+void DerivedGoal::updateEvals(const State *s) {
+    // The cached evaluations are only kept across happenings of the state they
+    // were made in: any other state, or this one after it has been replaced
+    // wholesale, starts afresh.
+    if (s != evalsState || s->getSerial() != evalsSerial) {
+        clearEvals();
+        evalsState = s;
+        evalsSerial = s->getSerial();
+        literalsKnown = s->getValidator()->pf.numLiterals();
+
+        vector< unsigned int > atoms;
+        for (vector< vector< const DerivedGoal * > >::const_iterator i =
+                    strata.begin();
+                i != strata.end(); ++i) {
+            for (vector< const DerivedGoal * >::const_iterator j = i->begin();
+                    j != i->end(); ++j) {
+                atoms.push_back((*j)->getDPID());
+            };
+        };
+        materialise(s, atoms);
+        return;
+    };
+
+    // Otherwise only forget the evaluations that read something the last
+    // happening changed, and those that depend on them in turn.
+    vector< unsigned int > toErase;
+    toErase.swap(volatileEvals);
+
+    // Literals that were read before they existed may since have been created
+    // and added: the literals built since are the ones with the next IDs, and
+    // each wakes the evaluations that read an absent literal of its predicate.
+    const PropositionFactory &pf = s->getValidator()->pf;
+    if (absentReaders.empty()) literalsKnown = pf.numLiterals();
+    for (; literalsKnown < pf.numLiterals(); ++literalsKnown) {
+        const pred_symbol *p = pf.getLiteral(literalsKnown)->getPred();
         {
+            std::lock_guard< std::mutex > guard(dpIDsLock);
+            p = dpHeads(p);
+        };
+        map< const pred_symbol *, set< unsigned int > >::iterator r =
+            absentReaders.find(p);
+        if (r == absentReaders.end()) continue;
+        toErase.insert(toErase.end(), r->second.begin(), r->second.end());
+        absentReaders.erase(r);
+    };
+
+    const set< const SimpleProposition * > changedLiterals =
+        s->getChangedLiterals();
+    for (set< const SimpleProposition * >::const_iterator i =
+                changedLiterals.begin();
+            i != changedLiterals.end(); ++i) {
+        if ((*i)->getID() >= literalReaders.size()) continue;
+        set< unsigned int > &readers = literalReaders[(*i)->getID()];
+        toErase.insert(toErase.end(), readers.begin(), readers.end());
+        readers.clear();
+    };
+
+    const set< const FuncExp * > changedPNEs = s->getChangedPNEs();
+    for (set< const FuncExp * >::const_iterator i = changedPNEs.begin();
+            i != changedPNEs.end(); ++i) {
+        if ((*i)->getID() >= pneReaders.size()) continue;
+        set< unsigned int > &readers = pneReaders[(*i)->getID()];
+        toErase.insert(toErase.end(), readers.begin(), readers.end());
+        readers.clear();
+    };
+
+    vector< unsigned int > affected;
+    while (!toErase.empty()) {
+        const unsigned int dp = toErase.back();
+        toErase.pop_back();
+        if (isMaterialised(dp) && evals[dp] != noEval) affected.push_back(dp);
+        evals[dp] = noEval;
+
+        set< unsigned int > &readers = dpReaders[dp];
+        toErase.insert(toErase.end(), readers.begin(), readers.end());
+        readers.clear();
+    };
+
+    if (!affected.empty()) materialise(s, affected);
+};
+
+void DerivedGoal::setStrata(const vector< vector< const DerivedGoal * > > &s) {
+    clearStrata();
+    strata = s;
+
+    for (vector< vector< const DerivedGoal * > >::const_iterator i =
+                strata.begin();
+            i != strata.end(); ++i) {
+        for (vector< const DerivedGoal * >::const_iterator j = i->begin();
+                j != i->end(); ++j) {
+            const unsigned int dp = (*j)->getDPID();
+            if (dp >= atomStratum.size()) {
+                atomStratum.resize(dp + 1, 0);
+                atomGoals.resize(dp + 1, 0);
+            };
+            atomStratum[dp] = i - strata.begin() + 1;
+            atomGoals[dp] = *j;
+        };
+    };
+};
 
-            vector<string> toErase;
-            //loop thro' each cached DP eval, find out if it has been affected
-            for(map<string,bool>::iterator e = evals.begin(); e != evals.end();
-     ++e)
-            {
-             map<string,set<const SimpleProposition *> >::iterator i =
-     dependsOnSPs.find(e->first);
-             //if the literal affects the DP then remove it from the cache since
-     its value may have changed set<const SimpleProposition *>::const_iterator j
-     = (i->second).find(*cl); if(j != (i->second).end())
-             {
-                toErase.push_back(e->first);
-             };
+void DerivedGoal::clearStrata() {
+    for (vector< vector< const DerivedGoal * > >::const_iterator i =
+                strata.begin();
+            i != strata.end(); ++i) {
+        for (vector< const DerivedGoal * >::const_iterator j = i->begin();
+                j != i->end(); ++j) {
+            delete *j;
+        };
+    };
+    strata.clear();
+    atomGoals.clear();
+    atomStratum.clear();
+
+    // Whatever is cached is forgotten the next time round.
+    evalsState = 0;
+};
+
+// Semi-naive evaluation of the given materialised atoms, stratum by stratum.
+// Each starts false and is derived from its rule; once one becomes true only
+// the atoms of its stratum that have read it are derived again. Rules within
+// a stratum only use each other positively, so this reaches the least
+// fixpoint. The atoms not given are left as they are: nothing they read has
+// changed. An atom whose rule reads an undefined PNE is marked undefined, so
+// that evaluating it fails just as it does top down; the atoms that read it
+// are derived again, and so fail in turn.
+void DerivedGoal::materialise(const State *s,
+                              const vector< unsigned int > &dps) {
+    vector< vector< unsigned int > > agenda(strata.size());
+    for (vector< unsigned int >::const_iterator i = dps.begin();
+            i != dps.end(); ++i) {
+        evals[*i] = false;
+        agenda[atomStratum[*i] - 1].push_back(*i);
+    };
+
+    const ActiveCtsEffects *a = ace;
+    ace = 0;
+
+    for (unsigned int k = 0; k < agenda.size(); ++k) {
+        vector< unsigned int > &work = agenda[k];
+        while (!work.empty()) {
+            const unsigned int dp = work.back();
+            work.pop_back();
+            if (evals[dp] == true) continue;
+
+            const DerivedGoal *dg = atomGoals[dp];
+            int ans;
+            dg->addCalledDP(dp);
+            try {
+                ans = dg->deriveFormula->evaluate(s);
+            } catch (BadAccessError &) {
+                // Tried again at the next happening, when the PNE may have
+                // been given a value.
+                recordVolatileRead();
+                ans = undefinedEval;
             };
+            dg->removeCalledDP(dp);
 
-            //erase DPs from cached evaluations of DPs
-            for(vector<string>::iterator te = toErase.begin(); te !=
-     toErase.end(); ++te)
-            {
-              evals.erase(*te);
+            if (ans == false || ans == evals[dp]) continue;
+            evals[dp] = ans;
+
+            const set< unsigned int > &readers = dpReaders[dp];
+            for (set< unsigned int >::const_iterator r = readers.begin();
+                    r != readers.end(); ++r) {
+                if (atomStratum[*r] == k + 1 && evals[*r] != true)
+                    work.push_back(*r);
             };
+        };
+    };
 
-         };
-     };
-    */
-    evals.clear();
-    intervals.clear();
-    propStrings.clear();
-    preCons.clear();
+    ace = a;
 };
 
 bool
 
 DerivedGoal::evaluate(const State *s,
                       vector< const DerivedGoal * > DPs) const {
-    string dpName = getDPName();
+    const unsigned int dp = getDPID();
 
     // setUp Comparisons
     if (ace != 0)
         const_cast< Proposition * >(deriveFormula)
         ->setUpComparisons(ace, rhsOpen);
 
-    // cout << "Looking for " << *this << "\n";
-    map< string, bool >::iterator i = evals.find(dpName);
+    if (!calledDPsEval.empty()) dpReaders[dp].insert(calledDPsEval.back());
 
-    if (i != evals.end()) {
-        // cout << "Found it and it is " << i->second << "\n";
-        return i->second;
+    // Materialised atoms are answered from the table, except when checking
+    // over an interval of continuous change.
+    const bool tabled = isMaterialised(dp);
+    if (tabled && ace == 0) {
+        if (s != evalsState || s->getSerial() != evalsSerial) updateEvals(s);
+        if (evals[dp] == undefinedEval) {
+            BadAccessError bae;
+            throw bae;
+        };
+        return evals[dp] == true;
+    };
+
+    // cout << "Looking for " << *this << "\n";
+    if (!tabled && evals[dp] != noEval) {
+        // cout << "Found it and it is " << evals[dp] << "\n";
+        return evals[dp];
     };
 
     revisit = false;
-    if (visited(dpName)) {
+    if (visited(dp)) {
         for (vector< const DerivedGoal * >::iterator i = DPs.begin();
                 i != DPs.end(); ++i)
             (*i)->setRevisit(true);
         return false;
     };
 
-    addCalledDP(dpName);
+    addCalledDP(dp);
 
     DPs.push_back(this);
     bool ans = deriveFormula->evaluate(s, DPs);
 
-    removeCalledDP(dpName);
+    removeCalledDP(dp);
 
-    if (ans || !revisit) {
-        evals[dpName] = ans;
+    if (!tabled && (ans || !revisit)) {
+        evals[dp] = ans;
     };
 
     return ans;
@@ -2077,62 +2315,35 @@ bool FalseProposition::evaluate(const State *s,
         return false;
 };
 
-void removeCalledDP(string dp) {
-    for (vector< string >::iterator k = calledDPsCreate.begin();
-            k != calledDPsCreate.end(); ++k) {
-        if (*k == dp) {
-            calledDPsCreate.erase(k);
-            break;
-        };
-    };
+void removeCalledDP(unsigned int dp) {
+    vector< unsigned int >::iterator k =
+        find(calledDPsCreate.begin(), calledDPsCreate.end(), dp);
+    if (k != calledDPsCreate.end()) calledDPsCreate.erase(k);
 };
 
-void addCalledDP(string dp) {
+void addCalledDP(unsigned int dp) {
     calledDPsCreate.push_back(dp);
 };
 
-void DerivedGoal::removeCalledDP(string dp) const
-
-{
-    for (vector< string >::iterator k = calledDPsEval.begin();
-            k != calledDPsEval.end(); ++k) {
-        if (*k == dp) {
-            calledDPsEval.erase(k);
-            break;
-        };
-    };
+// Derived predicates are only ever entered once on the evaluation stack, so
+// the one being left is always the last one entered.
+void DerivedGoal::removeCalledDP(unsigned int dp) const {
+    calledDPsEval.pop_back();
+    onEvalStack[dp] = false;
 };
 
-void DerivedGoal::addCalledDP(string dp) const {
+void DerivedGoal::addCalledDP(unsigned int dp) const {
     calledDPsEval.push_back(dp);
-};
-
-bool DerivedGoal::visited(string dp) const {
-    // if DP has already been visited
-    for (vector< string >::iterator j = calledDPsEval.begin();
-            j != calledDPsEval.end(); ++j) {
-        if (*j == dp) {
-            return true;
-        };
-    };
-
-    return false;
+    onEvalStack[dp] = true;
 };
 
 bool DerivedGoal::visited() const {
-    return visited(getDPName());
+    return visited(getDPID());
 };
 
-bool visited(string dp) {
-    // if DP has already been visited
-    for (vector< string >::iterator j = calledDPsCreate.begin();
-            j != calledDPsCreate.end(); ++j) {
-        if (*j == dp) {
-            return true;
-        };
-    };
-
-    return false;
+bool visited(unsigned int dp) {
+    return find(calledDPsCreate.begin(), calledDPsCreate.end(), dp) !=
+           calledDPsCreate.end();
 };
 
 void QfiedGoal::create() const {
@@ -2184,57 +2395,184 @@ bool QfiedGoal::evaluate(const State *s,
     return evaluateQfiedGoal(s, DPs);
 };
 
-// create the Conjuncts/Disjuncts one at a time and evaluate as we go along
+// evaluate the bindings one at a time, stopping as soon as the answer is known
 bool QfiedGoal::evaluateQfiedGoal(const State *s,
                                   vector< const DerivedGoal * > DPs) const {
-    bool disjConjEval;
-    // get list of instansiated parameters for the qfied prop, so for forall(?z
-    // ?y), we have a grounded list for every z? and ?y
-    set< var_symbol * > svs = getVariables(qg);
-    vector< const_symbol_list * > constantsList = defineUndefinedParameters(
-            newBlankConstSymbolList(const_cast< var_symbol_list * >(qg->getVars()),
-                                    vld),
-            const_cast< var_symbol_list * >(qg->getVars()), vld, svs);
-    if (constantsList.empty()) return qg->getQuantifier() == E_FORALL;
-    // now create a conjunction or disjunction with the qfied variables
-    // substituted map<parameter_symbol*,parameter_symbol*> newvars;
-    Environment &env = const_cast< Environment & >(bindings);
-
-    for (vector< const_symbol_list * >::iterator k = constantsList.begin();
-            k != constantsList.end(); ++k) {
-        // const goal * aGoal = copyGoal(qg->getGoal());
-
-        // define mapping of parameter symbol to constant
-        const_symbol_list::iterator consList = (*k)->begin();
-        for (var_symbol_list::const_iterator i = qg->getVars()->begin();
-                i != qg->getVars()->end(); ++i) {
-            // newvars
-            env[const_cast< var_symbol * >(*i)] = *consList;
-            consList++;
-        };
-        // evaluate conjunct/disjunct with qfied variables substituted
-        // changeVars(const_cast<goal *>(aGoal),newvars);
-        // cout << "Using " << *(qg->getGoal()) << "\n";
-        const Proposition *propToCheck =
-            vld->pf.buildProposition(qg->getGoal() /* aGoal */, bindings, false,
-                                     s);  // cout << *propToCheck <<" \n";
-        // cout << "Here it is: " << *propToCheck << "\n";
-        disjConjEval = propToCheck->evaluate(s, DPs);
-        delete propToCheck;
-        // delete aGoal;
-
-        if (qg->getQuantifier() == E_FORALL && !disjConjEval) {
-            deleteParameters(constantsList);
+    return vld->pf.getEvaluator(qg).evaluate(
+               vld, const_cast< Environment & >(bindings), s, DPs);
+};
+
+QfiedGoalEvaluator::QfiedGoalEvaluator(Validator *vld, const qfied_goal *qg)
+    : nodes(), vars() {
+    set< string > derived;
+    typedef map< string, pair< const goal *, const var_symbol_table * > >
+    DerivPreds;
+    const DerivPreds dps = vld->getDerivRules()->getDerivPreds();
+    for (DerivPreds::const_iterator i = dps.begin(); i != dps.end(); ++i)
+        derived.insert(i->first);
+
+    compileQuantifier(qg, derived);
+};
+
+void QfiedGoalEvaluator::compileQuantifier(const qfied_goal *qg,
+        const set< string > &derived) {
+    const unsigned int n = nodes.size();
+    const Node q = {qg->getQuantifier() == E_FORALL ? FORALL : EXISTS, true,
+                    qg, 0, static_cast< unsigned int >(vars.size()), 0
+                   };
+    nodes.push_back(q);
+    vars.insert(vars.end(), qg->getVars()->begin(), qg->getVars()->end());
+    nodes[n].endVar = vars.size();
+
+    // A body that cannot be compiled is built for each binding instead.
+    if (!compile(qg->getGoal(), derived)) {
+        nodes.resize(n + 1);
+        vars.resize(nodes[n].endVar);
+        const Node body = {GOAL, true, qg->getGoal(), n + 2, 0, 0};
+        nodes.push_back(body);
+    };
+    nodes[n].end = nodes.size();
+};
+
+bool QfiedGoalEvaluator::compile(const goal *g, const set< string > &derived) {
+    const unsigned int n = nodes.size();
+    const Node node = {GOAL, true, g, 0, 0, 0};
+
+    if (const simple_goal *sg = dynamic_cast< const simple_goal * >(g)) {
+        const string name = sg->getProp()->head->getName();
+        if (derived.find(name) != derived.end()) return false;
+        nodes.push_back(node);
+        nodes[n].kind = name == "=" ? EQUALITY : LITERAL;
+        nodes[n].positive = sg->getPolarity() == E_POS;
+        nodes[n].end = n + 1;
+        return true;
+    };
+
+    if (const qfied_goal *qg = dynamic_cast< const qfied_goal * >(g)) {
+        compileQuantifier(qg, derived);
+        // A nested quantifier whose body is left as a goal is no quicker
+        // here than built for each binding of the outer one.
+        return nodes[n + 1].kind != GOAL;
+    };
+
+    if (const named_goal *ng = dynamic_cast< const named_goal * >(g)) {
+        return compile(ng->gl, derived);
+    };
+
+    const goal_list *gs = 0;
+    nodes.push_back(node);
+    if (const conj_goal *cg = dynamic_cast< const conj_goal * >(g)) {
+        nodes[n].kind = AND;
+        gs = cg->getGoals();
+    } else if (const disj_goal *dg = dynamic_cast< const disj_goal * >(g)) {
+        nodes[n].kind = OR;
+        gs = dg->getGoals();
+    } else if (const neg_goal *ng = dynamic_cast< const neg_goal * >(g)) {
+        nodes[n].kind = NOT;
+        if (!compile(ng->getGoal(), derived)) return false;
+    } else if (const imply_goal *ig = dynamic_cast< const imply_goal * >(g)) {
+        nodes[n].kind = IMPLY;
+        if (!compile(ig->getAntecedent(), derived) ||
+                !compile(ig->getConsequent(), derived))
             return false;
-        } else if (qg->getQuantifier() != E_FORALL && disjConjEval) {
-            deleteParameters(constantsList);
+    } else {
+        return false;
+    };
+
+    if (gs) {
+        for (goal_list::const_iterator i = gs->begin(); i != gs->end(); ++i) {
+            if (!compile(*i, derived)) return false;
+        };
+    };
+    nodes[n].end = nodes.size();
+    return true;
+};
+
+bool QfiedGoalEvaluator::evaluate(unsigned int n, Validator *vld,
+                                  Environment &env, const State *s,
+                                  const vector< const DerivedGoal * > &DPs) const {
+    const Node &node = nodes[n];
+    switch (node.kind) {
+        case LITERAL:
+        case EQUALITY: {
+            if (s == 0) {
+                BadAccessError bae;
+                throw bae;
+            };
+            for (vector< const DerivedGoal * >::const_iterator i = DPs.begin();
+                    i != DPs.end(); ++i)
+                (*i)->setRevisit(true);
+
+            const proposition *prop =
+                static_cast< const simple_goal * >(node.g)->getProp();
+            bool ans = false;  // closed world assumption
+            if (node.kind == EQUALITY) {
+                // Constants are interned by name, so equal names are the same
+                // symbol.
+                const parameter_symbol *args[2];
+                parameter_symbol_list::const_iterator i = prop->args->begin();
+                for (int k = 0; k < 2; ++k, ++i) {
+                    const var_symbol *v = dynamic_cast< const var_symbol * >(*i);
+                    args[k] = v ? env.find(v)->second : *i;
+                };
+                ans = args[0] == args[1];
+            } else if (const SimpleProposition *sp =
+                           vld->pf.findLiteral(prop, env)) {
+                ans = sp->evaluate(s);
+            } else {
+                DerivedGoal::noteAbsentRead(prop->head);
+            };
+            return ans == node.positive;
+        };
+        case AND:
+            for (unsigned int i = n + 1; i != node.end; i = nodes[i].end) {
+                if (!evaluate(i, vld, env, s, DPs)) return false;
+            };
             return true;
+        case OR:
+            for (unsigned int i = n + 1; i != node.end; i = nodes[i].end) {
+                if (evaluate(i, vld, env, s, DPs)) return true;
+            };
+            return false;
+        case NOT:
+            return !evaluate(n + 1, vld, env, s, DPs);
+        case IMPLY:
+            return !evaluate(n + 1, vld, env, s, DPs) ||
+                   evaluate(nodes[n + 1].end, vld, env, s, DPs);
+        case FORALL:
+        case EXISTS:
+            return quantify(n, node.firstVar, vld, env, s, DPs);
+        case GOAL: {
+            const Proposition *p =
+                vld->pf.buildProposition(node.g, env, false, s);
+            const bool ans = p->evaluate(s, DPs);
+            delete p;
+            return ans;
         };
     };
+    return false;
+};
+
+// Bind each variable from the given one on to every value in its range in
+// turn, the first variable outermost, and evaluate the body for each binding.
+bool QfiedGoalEvaluator::quantify(unsigned int n, unsigned int var,
+                                  Validator *vld, Environment &env,
+                                  const State *s,
+                                  const vector< const DerivedGoal * > &DPs) const {
+    const Node &node = nodes[n];
+    if (var == node.endVar) return evaluate(n + 1, vld, env, s, DPs);
 
-    deleteParameters(constantsList);
+    const bool all = node.kind == FORALL;
+    const vector< const_symbol * > &vals = vld->range(vars[var]);
+    if (vals.empty()) return all;
 
-    return (qg->getQuantifier() == E_FORALL);
+    const const_symbol *&value = env[vars[var]];
+    for (vector< const_symbol * >::const_iterator i = vals.begin();
+            i != vals.end(); ++i) {
+        value = *i;
+        if (quantify(n, var + 1, vld, env, s, DPs) != all) return !all;
+    };
+    return all;
 };
 
 bool QfiedGoal::markOwnedPreconditions(const Action *a, Ownership &o,
@@ -2343,9 +2681,9 @@ const Proposition *PropositionFactory::buildProposition(const goal *g,
         if (dg != 0) {
             // check to see if derived predicate depends on itself
 
-            string dpName = getDPName(sg, (const_cast< Environment * >(&bs)));
+            const unsigned int dp = DerivedGoal::getDPID(sg->getProp(), bs);
 
-            if (visited(dpName)) {
+            if (visited(dp)) {
                 // map<string,const DerivedGoal*>::const_iterator dp =
                 // derivedPredicates.find(dpName); cout << dp->second <<" = "<< dpName
                 // <<" dp for false prop\n";
@@ -2359,7 +2697,7 @@ const Proposition *PropositionFactory::buildProposition(const goal *g,
                 };
             };
 
-            addCalledDP(dpName);
+            addCalledDP(dp);
 
             const Proposition *newProp;
             const DerivedGoal *newDP = new DerivedGoal(
@@ -2379,7 +2717,7 @@ const Proposition *PropositionFactory::buildProposition(const goal *g,
                     newDP, bs);
             };
 
-            removeCalledDP(dpName);
+            removeCalledDP(dp);
 
             return newProp;
         };
@@ -2403,20 +2741,11 @@ const Proposition *PropositionFactory::buildProposition(const goal *g,
             if (sg->getProp()->head->getName() == "=") {
                 literalisTrue = evaluateEquality(sg->getProp(), bs);
             } else {
-                string s(sg->getProp()->head->getName());
-                for (parameter_symbol_list::const_iterator i =
-                            sg->getProp()->args->begin();
-                        i != sg->getProp()->args->end(); ++i) {
-                    s += " ";
-                    if (dynamic_cast< const var_symbol * >(*i))
-                        s += bs.find(dynamic_cast< const var_symbol * >(*i))
-                             ->second->getName();
-                    else
-                        s += (*i)->getName();
-                };
-                map< string, const SimpleProposition * >::const_iterator i1 =
-                    literals.find(s);
-                if (i1 != literals.end()) literalisTrue = i1->second->evaluate(state);
+                const SimpleProposition *sp = findLiteral(sg->getProp(), bs);
+                if (sp)
+                    literalisTrue = sp->evaluate(state);
+                else
+                    DerivedGoal::noteAbsentRead(sg->getProp()->head);
             };
             if (sg->getPolarity() != E_POS) literalisTrue = !literalisTrue;
 
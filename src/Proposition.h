@@ -1,11 +1,13 @@
 // Copyright 2019 - University of Strathclyde, King's College London and Schlumberger Ltd
 // This source code is licensed under the BSD license found in the LICENSE file in the root directory of this source tree.
 
+#include "AtomTable.h"
 #include "Environment.h"
 #include "Ownership.h"
 #include "Polynomial.h"
 #include "ptree.h"
 #include <iostream>
+#include <mutex>
 #include <set>
 
 #ifndef __PROPOSITION
@@ -22,8 +24,10 @@ namespace VAL {
 
 class State;
 class Action;
+class FuncExp;
 
 struct ActiveCtsEffects;
+class CompiledExpression;
 class DerivedGoal;
 class AdviceProposition;
 
@@ -42,6 +46,29 @@ Intervals setIntersect(const Intervals &ints1, const Intervals &ints2);
 Intervals setUnion(const Intervals &ints1, const Intervals &ints2);
 Intervals setComplement(const Intervals &ints, double endPoint);
 
+// Once TIM has run, the propositions of the domain name their predicate
+// through copies typed by their arguments, so one predicate can appear under
+// several symbols.  Ground atoms are keyed by the symbol the analysis holds
+// for that name instead, looked up once per symbol met.
+class PredicateNames {
+private:
+    map< const pred_symbol *, const pred_symbol * > heads;
+
+public:
+    PredicateNames() : heads() {};
+
+    const pred_symbol *operator()(const pred_symbol *p) {
+        map< const pred_symbol *, const pred_symbol * >::const_iterator h =
+            heads.find(p);
+        if (h != heads.end()) return h->second;
+        const pred_symbol *named =
+            current_analysis
+            ? current_analysis->pred_tab.symbol_probe(p->getName())
+            : 0;
+        return heads[p] = named ? named : p;
+    };
+};
+
 class Proposition {
 protected:
     const Environment &bindings;
@@ -91,12 +118,18 @@ private:
 
     const proposition *prop;
 
+    // dense index handed out by the PropositionFactory, used to address the
+    // literal in the packed truth values of a State
+    const unsigned int id;
+
 public:
-    SimpleProposition(const parse_category *p, const Environment &bs)
-        : Proposition(bs), prop(dynamic_cast< const proposition * >(p)) {};
-    SimpleProposition(const parse_category *p)
+    SimpleProposition(const parse_category *p, const Environment &bs,
+                      unsigned int i)
+        : Proposition(bs), prop(dynamic_cast< const proposition * >(p)), id(i) {};
+    SimpleProposition(const parse_category *p, unsigned int i)
         : Proposition(nullEnvironment),
-          prop(dynamic_cast< const proposition * >(p)) {};
+          prop(dynamic_cast< const proposition * >(p)),
+          id(i) {};
 
     bool evaluate(const State *s, vector< const DerivedGoal * > =
                       vector< const DerivedGoal * >()) const;
@@ -132,6 +165,9 @@ public:
     const Environment *getEnv() const {
         return &bindings;
     };
+    unsigned int getID() const {
+        return id;
+    };
     void write(ostream &o) const;
     string toString() const;
     void destroy() const {};
@@ -145,20 +181,71 @@ private:
 
     const Proposition *deriveFormula;
     mutable bool revisit;
-
-    static map< string, bool > DPliterals;
-    static vector< string > calledDPsEval;
-    static map< string, pair< int, int > > ranks;
+    const unsigned int dpID;
+
+    // Ground derived atoms are interned to dense IDs, once for all threads,
+    // which key the caches below and the stack of derived predicates being
+    // evaluated. The caches are held per thread, so that plans can be
+    // validated concurrently, and grow to take the IDs as they are used.
+    // Atoms are interned under the predicate of their name, so that the typed
+    // copies TIM makes of it name the same atom; dpHeads is guarded by
+    // dpIDsLock as well.
+    static AtomTable< pred_symbol, const_symbol, unsigned int > dpIDs;
+    static PredicateNames dpHeads;
+    static std::mutex dpIDsLock;
+    static thread_local vector< const const_symbol * > dpArgs;
+
+    static thread_local map< unsigned int, bool > DPliterals;
+    static thread_local vector< unsigned int > calledDPsEval;
+    static thread_local vector< bool > onEvalStack;
+    static thread_local map< unsigned int, pair< int, int > > ranks;
     static const pair< int, int > noRank;
-    static map< string, bool > evals;
+    static thread_local vector< int > evals;
     static const int noEval;
-    static map< string, Intervals > intervals;
+    static const int undefinedEval;  // a materialised atom that read an undefined PNE
+    static thread_local map< unsigned int, Intervals > intervals;
     static const Intervals noIntervals;
-    static map< string, string > propStrings;
+    static thread_local map< unsigned int, string > propStrings;
     static const string noPropString;
-    static map< string, const Action * > preCons;
-    static const ActiveCtsEffects *ace;
-    static bool rhsOpen;
+    static thread_local map< unsigned int, const Action * > preCons;
+    static thread_local const ActiveCtsEffects *ace;
+    static thread_local bool rhsOpen;
+
+    // Dependency index for the cached evaluations, recorded as they are
+    // computed: the derived predicates whose evaluation read each literal, PNE
+    // and derived predicate (by ID), those that read something that is not
+    // held in the state (time, violations, continuous change) and so never
+    // stay valid, and those that read a literal before it was built, by the
+    // predicate of its name, which stay valid only until a literal of that
+    // predicate is built (literalsKnown counts those that had been).
+    static thread_local vector< set< unsigned int > > literalReaders;
+    static thread_local vector< set< unsigned int > > pneReaders;
+    static thread_local vector< set< unsigned int > > dpReaders;
+    static thread_local vector< unsigned int > volatileEvals;
+    static thread_local map< const pred_symbol *, set< unsigned int > >
+        absentReaders;
+    static thread_local unsigned int literalsKnown;
+    static thread_local const State *evalsState;
+    static thread_local unsigned long evalsSerial;
+
+    // Bottom-up evaluation: the ground atoms of the stratified rules, lowest
+    // stratum first, whose values are materialised in evals for each state.
+    static thread_local vector< vector< const DerivedGoal * > > strata;
+    static thread_local vector< const DerivedGoal * > atomGoals;
+    static thread_local vector< unsigned int > atomStratum;  // 0 if not materialised
+
+    static bool isMaterialised(unsigned int dp) {
+        return dp < atomStratum.size() && atomStratum[dp];
+    };
+    static void materialise(const State *s, const vector< unsigned int > &dps);
+    static void updateEvals(const State *s);
+
+    static void clearEvals();
+    static void addSlots(unsigned int dp);
+    static void recordRead(const SimpleProposition *sp);
+    static void recordRead(const FuncExp *fe);
+    static void recordVolatileRead();
+    static void recordAbsentRead(const pred_symbol *p);
 
 public:
     DerivedGoal(const parse_category *p, const Proposition *f,
@@ -166,12 +253,14 @@ public:
         : Proposition(bs),
           prop(dynamic_cast< const proposition * >(p)),
           deriveFormula(f),
-          revisit(false) {};
+          revisit(false),
+          dpID(getDPID(prop, bs)) {};
     DerivedGoal(const parse_category *p, const Proposition *f)
         : Proposition(nullEnvironment),
           prop(dynamic_cast< const proposition * >(p)),
           deriveFormula(f),
-          revisit(false) {};
+          revisit(false),
+          dpID(getDPID(prop, nullEnvironment)) {};
 
     bool evaluate(const State *s, vector< const DerivedGoal * > =
                       vector< const DerivedGoal * >()) const;
@@ -186,15 +275,42 @@ public:
     void setUpComparisons(const ActiveCtsEffects *ace, bool rhsOpen = false);
     void resetCtsFunctions();
 
-    void removeCalledDP(string dp) const;
-    void addCalledDP(string dp) const;
+    void removeCalledDP(unsigned int dp) const;
+    void addCalledDP(unsigned int dp) const;
     string getDPName() const;
+    static unsigned int getDPID(const proposition *p, const Environment &bs);
+    unsigned int getDPID() const {
+        if (dpID >= evals.size()) addSlots(dpID);
+        return dpID;
+    };
     bool visited() const;
-    bool visited(string dp) const;
+    bool visited(unsigned int dp) const {
+        return onEvalStack[dp];
+    };
     void setRevisit(bool b) const {
         revisit = b;
     };
     static void resetLists(const State *s);
+    // Switch to materialising the given ground atoms bottom up, or back to
+    // top-down evaluation of every derived predicate.
+    static void setStrata(const vector< vector< const DerivedGoal * > > &s);
+    static void clearStrata();
+    // Called for every read made while a derived predicate is being
+    // evaluated, to build the dependency index.
+    static void noteRead(const SimpleProposition *sp) {
+        if (!calledDPsEval.empty()) recordRead(sp);
+    };
+    static void noteRead(const FuncExp *fe) {
+        if (!calledDPsEval.empty()) recordRead(fe);
+    };
+    static void noteVolatileRead() {
+        if (!calledDPsEval.empty()) recordVolatileRead();
+    };
+    // A read of a literal that has not been created, and so is false until it
+    // is.
+    static void noteAbsentRead(const pred_symbol *p) {
+        if (!calledDPsEval.empty()) recordAbsentRead(p);
+    };
     static void resetPreConsList() {
         preCons.clear();
     };
@@ -260,13 +376,23 @@ private:
     const CtsFunction *ctsFtn;
     bool rhsIntervalOpen;  // only open for last interval that invariant is
     // checked on
+
+    // the two sides compiled against the bindings on first evaluation
+    mutable const CompiledExpression *lhsProgram;
+    mutable const CompiledExpression *rhsProgram;
+
+    const CompiledExpression *getLHSProgram(const State *s) const;
+    const CompiledExpression *getRHSProgram(const State *s) const;
+
 public:
     Comparison(const comparison *c, const Environment &bs)
         :
 
         Proposition(bs),
         comp(c),
-        ctsFtn(0) {};
+        ctsFtn(0),
+        lhsProgram(0),
+        rhsProgram(0) {};
     bool evaluate(const State *s, vector< const DerivedGoal * > =
                       vector< const DerivedGoal * >()) const;
     bool evaluateAtPoint(const State *s) const;
@@ -299,9 +425,7 @@ public:
     void write(ostream &o) const;
 
     // void destroy() {/*delete this;*/};
-    ~Comparison() { /*cout<<"deleting "<<*ctsFtn<<"\n";*/
-        delete ctsFtn;
-    };
+    ~Comparison();
 };
 
 class ConjGoal : public Proposition {
@@ -515,6 +639,48 @@ private:
 
 */
 
+// A quantified goal compiled once into a tree that is evaluated by binding the
+// quantified variables in place. Literals, equalities, the connectives over
+// them and further quantifiers are evaluated directly, so no proposition is
+// built for a binding. A body holding anything else (comparisons, derived
+// predicates, preferences) is left as a goal, which is built and evaluated
+// for each binding as before. Every quantifier stops at its first
+// counterexample or witness.
+class QfiedGoalEvaluator {
+private:
+    enum Kind { LITERAL, EQUALITY, AND, OR, NOT, IMPLY, FORALL, EXISTS, GOAL };
+
+    // Nodes are kept in prefix order: the operands of a node follow it, up to
+    // the node's end. A quantifier binds vars[firstVar] to vars[endVar - 1].
+    struct Node {
+        Kind kind;
+        bool positive;
+        const goal *g;
+        unsigned int end;
+        unsigned int firstVar;
+        unsigned int endVar;
+    };
+
+    vector< Node > nodes;
+    vector< const var_symbol * > vars;
+
+    bool compile(const goal *g, const set< string > &derived);
+    void compileQuantifier(const qfied_goal *qg, const set< string > &derived);
+    bool evaluate(unsigned int n, Validator *vld, Environment &env,
+                  const State *s, const vector< const DerivedGoal * > &DPs) const;
+    bool quantify(unsigned int n, unsigned int var, Validator *vld,
+                  Environment &env, const State *s,
+                  const vector< const DerivedGoal * > &DPs) const;
+
+public:
+    QfiedGoalEvaluator(Validator *vld, const qfied_goal *qg);
+
+    bool evaluate(Validator *vld, Environment &env, const State *s,
+                  const vector< const DerivedGoal * > &DPs) const {
+        return evaluate(0, vld, env, s, DPs);
+    };
+};
+
 class QfiedGoal : public Proposition {
 private:
     const qfied_goal *qg;
@@ -570,12 +736,77 @@ public:
 
 class Validator;
 
+// The interned literals, addressed both by predicate and ground arguments and
+// by their dense IDs. Each PropositionFactory normally has a table of its own,
+// but the trial Validators of robustness testing and plan repair borrow one
+// table for the problem (see CompiledProblem). A shared table keeps its own
+// copies of the bindings its literals were built with, as those belong to the
+// Validator that happened to build the literal first.
+class LiteralTable {
+private:
+    AtomTable< pred_symbol, parameter_symbol, const SimpleProposition * >
+        literals;
+    vector< const SimpleProposition * > literalsByID;
+
+    const bool shared;
+    vector< const Environment * > bindings;
+
+    LiteralTable(const LiteralTable &);
+    LiteralTable &operator=(const LiteralTable &);
+
+public:
+    LiteralTable(bool s = false)
+        : literals(), literalsByID(), shared(s), bindings() {};
+    ~LiteralTable();
+
+    const SimpleProposition *intern(const proposition *p, const pred_symbol *head,
+                                    const vector< const parameter_symbol * > &args,
+                                    const Environment *bs) {
+        const SimpleProposition *&prp =
+            literals.insert(head, args.begin(), args.end(),
+                            (const SimpleProposition *)0);
+        if (!prp) {
+            if (bs && shared) {
+                bs = new Environment(*bs);
+                bindings.push_back(bs);
+            };
+            prp = bs ? new SimpleProposition(p, *bs, literalsByID.size())
+                     : new SimpleProposition(p, literalsByID.size());
+            literalsByID.push_back(prp);
+        };
+        return prp;
+    };
+
+    const SimpleProposition *find(const pred_symbol *head,
+                                  const vector< const parameter_symbol * > &args) {
+        const SimpleProposition **prp =
+            literals.find(head, args.begin(), args.end());
+        return prp ? *prp : 0;
+    };
+
+    const SimpleProposition *getLiteral(unsigned int id) const {
+        return literalsByID[id];
+    };
+    unsigned int numLiterals() const {
+        return literalsByID.size();
+    };
+};
+
 class PropositionFactory {
 private:
-    map< string, const SimpleProposition * > literals;
+    LiteralTable ownTable;
+    LiteralTable &table;
+
+    // ground arguments of the literal being looked up, reused between lookups
+    vector< const parameter_symbol * > args;
 
     Validator *vld;
 
+    // the predicate each literal is interned under
+    PredicateNames heads;
+
+    map< const qfied_goal *, QfiedGoalEvaluator > evaluators;
+
     struct buildProp {
         PropositionFactory *myPF;
         const Environment &myEnv;
@@ -590,28 +821,35 @@ private:
         };
     };
 
-public:
-    PropositionFactory(Validator *v) : literals(), vld(v) {};
-
-    ~PropositionFactory() {
-        for (map< string, const SimpleProposition * >::iterator i =
-                    literals.begin();
-                i != literals.end(); ++i)
-            delete (i->second);
+    const pred_symbol *headOf(const proposition *p) {
+        return heads(p->head);
     };
 
-    const SimpleProposition *buildLiteral(const proposition *p) {
-        string s(p->head->getName());
+    void bindArgs(const proposition *p, const Environment &bs) {
+        args.clear();
         for (parameter_symbol_list::const_iterator i = p->args->begin();
                 i != p->args->end(); ++i) {
-            s += " ";
-            s += (*i)->getName();  //(unsigned int)(*i);
+            if (const var_symbol *v = dynamic_cast< const var_symbol * >(*i)) {
+                args.push_back(bs.find(v)->second);
+            } else {
+                args.push_back(*i);
+            };
         };
-        map< string, const SimpleProposition * >::const_iterator i1 =
-            literals.find(s);
-        if (i1 != literals.end()) return i1->second;
-        const SimpleProposition *prp = literals[s] = new SimpleProposition(p);
-        return prp;
+    };
+
+public:
+    // Interns into t if one is given, otherwise into a table of its own.
+    PropositionFactory(Validator *v, LiteralTable *t = 0)
+        : ownTable(),
+          table(t ? *t : ownTable),
+          args(),
+          vld(v),
+          heads(),
+          evaluators() {};
+
+    const SimpleProposition *buildLiteral(const proposition *p) {
+        args.assign(p->args->begin(), p->args->end());
+        return table.intern(p, headOf(p), args, 0);
     };
 
     const SimpleProposition *buildLiteral(const simple_effect *eff) {
@@ -620,33 +858,15 @@ public:
 
     const SimpleProposition *buildLiteral(const proposition *p,
                                           const Environment &bs) {
-        string s(p->head->getName());
-        for (parameter_symbol_list::const_iterator i = p->args->begin();
-                i != p->args->end(); ++i) {
-            s += " ";
-            if (dynamic_cast< const var_symbol * >(*i)) {
-                /*			cout << "DEBUG: " << (**i) << "\n";
-                                        for(Environment::const_iterator x =
-                   bs.begin(); x != bs.end(); ++x)
-                                                {
-                                                cout << *(x->first) << " -> " <<
-                   *(x->second) << "\n";
-                                                }
-                */
-                s += bs.find(dynamic_cast< const var_symbol * >(*i))
-                     ->second->getName();
-            } else {
-                s += (*i)->getName();
-            };
-        };
+        bindArgs(p, bs);
+        return table.intern(p, headOf(p), args, &bs);
+    };
 
-        map< string, const SimpleProposition * >::const_iterator i1 =
-            literals.find(s);
-        if (i1 != literals.end()) {
-            return i1->second;
-        }
-        const SimpleProposition *prp = literals[s] = new SimpleProposition(p, bs);
-        return prp;
+    // The literal for p under bs if it has already been built, otherwise 0.
+    const SimpleProposition *findLiteral(const proposition *p,
+                                         const Environment &bs) {
+        bindArgs(p, bs);
+        return table.find(headOf(p), args);
     };
 
     const SimpleProposition *buildLiteral(const simple_effect *eff,
@@ -654,6 +874,24 @@ public:
         return buildLiteral(eff->prop, bs);
     };
 
+    const SimpleProposition *getLiteral(unsigned int id) const {
+        return table.getLiteral(id);
+    };
+    unsigned int numLiterals() const {
+        return table.numLiterals();
+    };
+
+    // The evaluator for qg, compiled the first time it is asked for.
+    const QfiedGoalEvaluator &getEvaluator(const qfied_goal *qg) {
+        map< const qfied_goal *, QfiedGoalEvaluator >::const_iterator i =
+            evaluators.find(qg);
+        if (i == evaluators.end()) {
+            i = evaluators.insert(std::make_pair(qg, QfiedGoalEvaluator(vld, qg)))
+                .first;
+        };
+        return i->second;
+    };
+
     // bool evaluate(const proposition * p,const Environment & bs,const State *
     // state) const;
     const Proposition *buildProposition(const goal *g, const Environment &bs,
@@ -7,15 +7,28 @@
 #include "Validator.h"
 #include "random.h"
 #include "tDistribution.h"
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+using std::atomic;
+using std::current_exception;
+using std::exception_ptr;
+using std::lock_guard;
+using std::mutex;
+using std::rethrow_exception;
+using std::thread;
 
 namespace VAL {
 
 bool Robust;
 double RobustPNEJudder;
 bool EventPNEJuddering;
-bool JudderPNEs;
+thread_local bool JudderPNEs;
 bool TestingPNERobustness;
 bool LaTeXRecord = false;
+unsigned long RobustSeed = 0;
 
 RobustPlanAnalyser::~RobustPlanAnalyser() {
 
@@ -389,6 +402,184 @@ void RobustPlanAnalyser::analyseRobustness() {
                         pneRobustnessOfPlan, pneRobustnessBound);
 };
 
+// Validate one perturbed copy of the plan. This runs on a worker thread when
+// the tests are run concurrently, so the Validator is built and destroyed here,
+// on the thread whose caches it uses, and borrows that thread's cp.
+void RobustPlanAnalyser::runTest(TestOutcome &t, double variation, int testNo,
+                                 bool recordFailures, bool latexAdvice,
+                                 CompiledProblem &cp) {
+    int noBoundaryTests = 0;  // 299;
+    seedRandomNumbers(seed, (runs << 32) + testNo);
+
+    map< const plan_step *, const plan_step * > planStepMap;  // we need to
+    // keep track of
+    // which actions
+    // fail
+    plan *testPlan = newTestPlan(p);
+    plan *testPlan2 =
+        new plan(*testPlan);  // we can delete the test plan now without
+    // deleting the timed initial literal actions
+
+    if (testNo <= noBoundaryTests)
+        planStepMap = varyPlanTimestampsBoundary(testPlan, p, variation, testNo);
+    else
+        planStepMap = varyPlanTimestamps(testPlan, p, variation);
+
+    // add timed initial literals to the plan from the problem spec, these
+    // time are fixed
+    for (vector< plan_step * >::iterator ps =
+                timedIntitialLiteralActions.begin();
+            ps != timedIntitialLiteralActions.end(); ++ps) {
+        testPlan->push_back(*ps);
+    };
+
+    Validator *testPlanValidator =
+        new Validator(derivRules, tolerance, typeC, operators, initialState,
+                      testPlan, metric, stepLength, durative,
+                      current_analysis->the_domain->constraints,
+                      current_analysis->the_problem->constraints, &cp);
+
+    try {
+        t.planExecuted = testPlanValidator->execute();
+    } catch (const exception &e) {
+        t.errorMessage = e.what();
+        t.executionError = true;
+    };
+
+    if (t.planExecuted)
+        t.goalSatisfied = testPlanValidator->checkGoal(theGoal);
+
+    if ((!t.planExecuted || !t.goalSatisfied) && recordFailures) {
+        bool unsatGoal = false;
+        // ErrorLog errorLog = testPlanValidator->getErrorLog();
+        vector< const UnsatCondition * > unSatConds =
+            testPlanValidator->getErrorLog().getConditions();
+        if (!unSatConds.empty()) {
+            const UnsatCondition *firstError = *(unSatConds.begin());
+            const Action *theAction = 0;
+            if (const UnsatPrecondition *unsatpre =
+                        dynamic_cast< const UnsatPrecondition * >(firstError)) {
+                theAction = unsatpre->action;
+            } else if (const UnsatInvariant *unsatinv =
+                           dynamic_cast< const UnsatInvariant * >(firstError)) {
+                theAction = unsatinv->action;
+            } else if (const UnsatDurationCondition *unsatdur =
+                           dynamic_cast< const UnsatDurationCondition * >(
+                               firstError)) {
+                theAction = unsatdur->action;
+            } else if (const MutexViolation *muvi =
+                           dynamic_cast< const MutexViolation * >(firstError)) {
+                theAction = muvi->action1;  // just recond one action for now to
+                // get numbers
+            } else if (dynamic_cast< const UnsatGoal * >(firstError)) {
+                unsatGoal = true;
+            } else
+                t.unknown = true;
+
+            if (theAction != 0 || unsatGoal) {
+                const plan_step *aPlanStep = 0;
+                if (!unsatGoal) aPlanStep = theAction->getPlanStep();
+
+                if (aPlanStep != 0 || unsatGoal) {
+                    t.recorded = true;
+                    t.failedStep = unsatGoal ? 0 : planStepMap[aPlanStep];
+                    // only switched when the tests run one at a time
+                    const bool lx = LaTeX;
+                    if (lx != latexAdvice) LaTeX = latexAdvice;
+                    t.reason = firstError->getDisplayString();
+                    t.advice = firstError->getAdviceString();
+                    if (lx != latexAdvice) LaTeX = lx;
+                } else
+                    t.unknown = true;
+            };
+        } else
+            t.unknown = true;
+    };
+
+    if (LaTeX) {
+        if (t.planExecuted) {
+            *report << "Plan executed successfully - checking goal\\\\\n";
+            if (t.goalSatisfied) {
+                *report << "Goal satisfied\\\\\n"
+                        << "Final value: ";
+                vector< double > vs(testPlanValidator->finalValue());
+                copy(vs.begin(), vs.end(),
+                     ostream_iterator< double >(*report, " "));
+                *report << "\n";
+            } else
+                *report << "Goal not satisfied\n";
+        } else
+            *report << "\nPlan failed to execute\n";
+        maxTime = testPlanValidator->getMaxTime();
+        if (testPlanValidator->graphsToShow())
+            latex.LaTeXGraphs(testPlanValidator);
+        latex.LaTeXGantt(testPlanValidator);
+    };
+
+    deleteTestPlan(testPlan2);
+    testPlan->clear();
+    delete testPlan;
+    delete testPlanValidator;
+};
+
+// Run the tests of one analysis, on jobs threads if that is safe. Reports and
+// advice written in LaTeX switch the global LaTeX flag while a test runs, so
+// those tests are run one at a time. If allValid is set the tests stop at the
+// first invalid plan, and tests after it are not run.
+void RobustPlanAnalyser::runTests(vector< TestOutcome > &outcomes,
+                                  double variation, bool recordFailures,
+                                  bool latexAdvice, bool allValid) {
+    ++runs;
+    const int numberTestPlans = outcomes.size();
+
+    if (jobs < 2 || LaTeX || (recordFailures && latexAdvice != LaTeX)) {
+        CompiledProblem cp;
+        for (int i = 0; i < numberTestPlans; ++i) {
+            TestOutcome &t = outcomes[i];
+            runTest(t, variation, i + 1, recordFailures, latexAdvice, cp);
+            if (allValid && (!t.planExecuted || !t.goalSatisfied)) {
+                outcomes.resize(i + 1);
+                return;
+            };
+        };
+        return;
+    };
+
+    atomic< int > next(0);
+    atomic< int > firstInvalid(numberTestPlans);
+    exception_ptr failure;
+    mutex failureLock;
+
+    vector< thread > threads;
+    for (unsigned int j = 0; j < jobs; ++j) {
+        threads.push_back(thread([&]() {
+            CompiledProblem cp;
+            for (int i = next++; i < firstInvalid; i = next++) {
+                TestOutcome &t = outcomes[i];
+                try {
+                    runTest(t, variation, i + 1, recordFailures, latexAdvice,
+                            cp);
+                } catch (...) {
+                    lock_guard< mutex > lock(failureLock);
+                    if (!failure) failure = current_exception();
+                    firstInvalid = 0;
+                };
+                if (allValid && (!t.planExecuted || !t.goalSatisfied)) {
+                    int f = firstInvalid;
+                    while (i < f && !firstInvalid.compare_exchange_weak(f, i)) {
+                    };
+                };
+            };
+        }));
+    };
+
+    for (vector< thread >::iterator t = threads.begin(); t != threads.end(); ++t)
+        t->join();
+
+    if (failure) rethrow_exception(failure);
+    if (firstInvalid < numberTestPlans) outcomes.resize(firstInvalid + 1);
+};
+
 void RobustPlanAnalyser::runAnalysis(double &variation, int &numberTestPlans,
                                      bool recordFailures,
                                      int &numberOfInvalidPlans,
@@ -396,159 +587,48 @@ void RobustPlanAnalyser::runAnalysis(double &variation, int &numberTestPlans,
                                      bool latexAdvice) {
     ErrorReport = recordFailures;
     ContinueAnyway = false;
-    int noBoundaryTests = 0;  // 299;
-    Validator *testPlanValidator = 0;
 
     bool lxr = LaTeXRecord;
     LaTeXRecord = latexAdvice;
 
-    for (int testNo = 1; testNo <= numberTestPlans; ++testNo) {
-        map< const plan_step *, const plan_step * > planStepMap;  // we need to
-        // keep track of
-        // which actions
-        // fail
-        plan *testPlan = newTestPlan(p);
-        plan *testPlan2 =
-            new plan(*testPlan);  // we can delete the test plan now without
-        // deleting the timed initial literal actions
-        bool planExecuted = false;
-        bool goalSatisfied = false;
-        bool executionError = false;
-
-        if (testNo <= noBoundaryTests)
-            planStepMap =
-                varyPlanTimestampsBoundary(testPlan, p, variation, testNo);
-        else
-            planStepMap = varyPlanTimestamps(testPlan, p, variation);
-
-        // add timed initial literals to the plan from the problem spec, these
-        // time are fixed
-        for (vector< plan_step * >::iterator ps =
-                    timedIntitialLiteralActions.begin();
-                ps != timedIntitialLiteralActions.end(); ++ps) {
-            testPlan->push_back(*ps);
-        };
+    // the outcomes are gathered in the order of the tests
+    vector< TestOutcome > outcomes(numberTestPlans);
+    runTests(outcomes, variation, recordFailures, latexAdvice, allValid);
 
-        testPlanValidator =
-            new Validator(derivRules, tolerance, typeC, operators, initialState,
-                          testPlan, metric, stepLength, durative,
-                          current_analysis->the_domain->constraints,
-                          current_analysis->the_problem->constraints);
-
-        try {
-            planExecuted = testPlanValidator->execute();
-        } catch (const exception &e) {
-            cout << e.what() << "\n";
-            executionError = true;
-        };
+    for (vector< TestOutcome >::const_iterator t = outcomes.begin();
+            t != outcomes.end(); ++t) {
+        if (t->executionError) cout << t->errorMessage << "\n";
 
-        if (planExecuted) {
-            goalSatisfied = testPlanValidator->checkGoal(theGoal);
-            if (!goalSatisfied) unsatisfiedGoal++;
-        };
+        if (t->planExecuted && !t->goalSatisfied) unsatisfiedGoal++;
 
-        if (!planExecuted || !goalSatisfied) {
+        if (!t->planExecuted || !t->goalSatisfied) {
             numberOfInvalidPlans++;
-            if (allValid) return;
+            if (allValid) break;
             if (recordFailures) {
-                bool unsatGoal = false;
-                // ErrorLog errorLog = testPlanValidator->getErrorLog();
-                vector< const UnsatCondition * > unSatConds =
-                    testPlanValidator->getErrorLog().getConditions();
-                if (!unSatConds.empty()) {
-                    const UnsatCondition *firstError = *(unSatConds.begin());
-                    const Action *theAction = 0;
-                    if (const UnsatPrecondition *unsatpre =
-                                dynamic_cast< const UnsatPrecondition * >(firstError)) {
-                        theAction = unsatpre->action;
-                    } else if (const UnsatInvariant *unsatinv =
-                                   dynamic_cast< const UnsatInvariant * >(firstError)) {
-                        theAction = unsatinv->action;
-                    } else if (const UnsatDurationCondition *unsatdur =
-                                   dynamic_cast< const UnsatDurationCondition * >(
-                                       firstError)) {
-                        theAction = unsatdur->action;
-                    } else if (const MutexViolation *muvi =
-                                   dynamic_cast< const MutexViolation * >(firstError)) {
-                        theAction = muvi->action1;  // just recond one action for now to
-                        // get numbers
-                    } else if (dynamic_cast< const UnsatGoal * >(firstError)) {
-                        unsatGoal = true;
-                    } else
-                        unknownErrors++;
-
-                    if (theAction != 0 || unsatGoal) {
-                        const plan_step *aPlanStep = 0;
-                        if (!unsatGoal) aPlanStep = theAction->getPlanStep();
-
-                        if (aPlanStep != 0 || unsatGoal) {
-                            map< const plan_step *, InvalidActionReport >::iterator ps;
-                            if (!unsatGoal)
-                                ps = record.find(planStepMap[aPlanStep]);
-                            else
-                                ps = record.find(0);
-
-                            if (ps != record.end()) {
-                                (ps->second.number)++;
-                                bool lx = LaTeX;
-                                LaTeX = latexAdvice;
-                                string reason = firstError->getDisplayString();
-                                LaTeX = lx;
-                                map< string, pair< int, string > >::iterator r =
-                                    ps->second.failReasons.find(reason);
-                                if (r != ps->second.failReasons.end())
-                                    (r->second.first)++;
-                                else {
-                                    bool lx = LaTeX;
-                                    LaTeX = latexAdvice;
-                                    ps->second.failReasons[reason] =
-                                        make_pair(1, firstError->getAdviceString());
-                                    LaTeX = lx;
-                                };
-
-                            } else {
-                                bool lx = LaTeX;
-                                LaTeX = latexAdvice;
-                                record[planStepMap[aPlanStep]] =
-                                    InvalidActionReport(1, firstError->getDisplayString(),
-                                                        firstError->getAdviceString());
-                                LaTeX = lx;
-                            };
-                        } else
-                            unknownErrors++;
-                    };
-                } else
-                    unknownErrors++;
-
-            } else if (executionError) {
+                if (t->unknown) unknownErrors++;
+                if (!t->recorded) continue;
+
+                map< const plan_step *, InvalidActionReport >::iterator ps =
+                    record.find(t->failedStep);
+
+                if (ps != record.end()) {
+                    (ps->second.number)++;
+                    map< string, pair< int, string > >::iterator r =
+                        ps->second.failReasons.find(t->reason);
+                    if (r != ps->second.failReasons.end())
+                        (r->second.first)++;
+                    else
+                        ps->second.failReasons[t->reason] = make_pair(1, t->advice);
+
+                } else {
+                    record[t->failedStep] =
+                        InvalidActionReport(1, t->reason, t->advice);
+                };
+
+            } else if (t->executionError) {
                 numberOfErrorPlans++;
             };
         };
-
-        if (LaTeX) {
-            if (planExecuted) {
-                *report << "Plan executed successfully - checking goal\\\\\n";
-                if (goalSatisfied) {
-                    *report << "Goal satisfied\\\\\n"
-                            << "Final value: ";
-                    vector< double > vs(testPlanValidator->finalValue());
-                    copy(vs.begin(), vs.end(),
-                         ostream_iterator< double >(*report, " "));
-                    *report << "\n";
-                } else
-                    *report << "Goal not satisfied\n";
-            } else
-                *report << "\nPlan failed to execute\n";
-            maxTime = testPlanValidator->getMaxTime();
-            if (testPlanValidator->graphsToShow())
-                latex.LaTeXGraphs(testPlanValidator);
-            latex.LaTeXGantt(testPlanValidator);
-        };
-
-        deleteTestPlan(testPlan2);
-        testPlan->clear();
-        delete testPlan;
-        delete testPlanValidator;
     };
 
     LaTeXRecord = lxr;
@@ -1,6 +1,8 @@
 // Copyright 2019 - University of Strathclyde, King's College London and Schlumberger Ltd
 // This source code is licensed under the BSD license found in the LICENSE file in the root directory of this source tree.
 
+#include <cstdint>
+#include <ctime>
 #include <map>
 #include <vector>
 //#include "Validator.h"
@@ -19,10 +21,11 @@ namespace VAL {
 
 extern bool Robust;
 extern double RobustPNEJudder;
-extern bool JudderPNEs;
+extern thread_local bool JudderPNEs;
 extern bool EventPNEJuddering;
 extern bool TestingPNERobustness;
 extern bool LaTeXRecord;
+extern unsigned long RobustSeed;
 
 enum RobustMetric { DELAY, ACCUM, MAX };
 enum RobustDist { UNIFORM, NORMAL, PNORM };
@@ -52,9 +55,36 @@ struct InvalidActionReport {
 
 class DerivationRules;
 class TypeChecker;
+class CompiledProblem;
 
 class RobustPlanAnalyser {
 private:
+    // The result of validating one perturbed copy of the plan, and the first
+    // reason it failed, if it did.
+    struct TestOutcome {
+        bool planExecuted;
+        bool goalSatisfied;
+        bool executionError;
+        string errorMessage;
+
+        bool recorded;  // the failure is reported against failedStep
+        bool unknown;
+        const plan_step *failedStep;  // 0 for an unsatisfied goal
+        string reason;
+        string advice;
+
+        TestOutcome()
+            : planExecuted(false),
+              goalSatisfied(false),
+              executionError(false),
+              errorMessage(),
+              recorded(false),
+              unknown(false),
+              failedStep(0),
+              reason(),
+              advice() {};
+    };
+
     const plan *p;
     vector< plan_step * > timedIntitialLiteralActions;
 
@@ -83,6 +113,18 @@ private:
     analysis *current_analysis;
     const goal *theGoal;
 
+    // Tests are run on jobs threads. Test n of the runs-th analysis draws its
+    // random numbers from the stream (runs, n) of the seed, so an analysis is
+    // reproducible for a given seed however many threads run it.
+    unsigned int jobs;
+    unsigned long seed;
+    uint64_t runs;
+
+    void runTest(TestOutcome &t, double variation, int testNo,
+                 bool recordFailures, bool latexAdvice, CompiledProblem &cp);
+    void runTests(vector< TestOutcome > &outcomes, double variation,
+                  bool recordFailures, bool latexAdvice, bool allValid);
+
 public:
     RobustPlanAnalyser(double rm, int ntp, const DerivationRules *dr,
                        double tol, TypeChecker &tc, const operator_list *ops,
@@ -90,7 +132,8 @@ public:
                        const metric_spec *m, bool lengthDefault, bool isDur,
                        const goal *g, analysis *ca,
                        vector< plan_step * > initLits, bool car, bool cpr,
-                       RobustMetric robm, RobustDist robd)
+                       RobustMetric robm, RobustDist robd,
+                       unsigned int j = 1)
         : p(p1),
           timedIntitialLiteralActions(initLits),
           robustMeasure(rm),
@@ -112,7 +155,10 @@ public:
           operators(ops),
           initialState(is),
           current_analysis(ca),
-          theGoal(g) {};
+          theGoal(g),
+          jobs(j),
+          seed(RobustSeed ? RobustSeed : time(0)),
+          runs(0) {};
 
     ~RobustPlanAnalyser();
 
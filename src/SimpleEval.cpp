@@ -14,10 +14,12 @@ bool SimpleEvaluator::verbose = false;
 
 IState InitialStateEvaluator::initState;
 IState0Arity InitialStateEvaluator::init0State;
+IStateFacts InitialStateEvaluator::initFacts;
 
 void InitialStateEvaluator::setInitialState() {
     initState.clear();
     init0State.clear();
+    initFacts.clear();
 
     for (pc_list< simple_effect * >::const_iterator i =
                 current_analysis->the_problem->initial_state->add_effects.begin();
@@ -29,6 +31,15 @@ void InitialStateEvaluator::setInitialState() {
 
         } else {
             initState[(*i)->prop->head].push_back((*i)->prop->args);
+
+            vector< const_symbol * > args;
+            for (parameter_symbol_list::const_iterator a =
+                        (*i)->prop->args->begin();
+                    a != (*i)->prop->args->end(); ++a) {
+                args.push_back(dynamic_cast< const_symbol * >(*a));
+            };
+            initFacts.insert(EPS((*i)->prop->head)->getParent(), args.begin(),
+                             args.end(), (*i)->prop->args);
         };
     };
 };
@@ -147,20 +158,25 @@ void SimpleEvaluator::visit_qfied_goal(qfied_goal *p) {
     vector< VAL::var_symbol * > vars(p->getVars()->size());
     FastEnvironment fe(*f);
     fe.extend(vars.size());
+    // Grounding threads may get here together, so the shared values are only
+    // read.  A type not recorded in them takes its range from the type
+    // checker, which keeps every range it hands out.
+    const map< VAL::pddl_type *, vector< VAL::const_symbol * > > &values =
+        instantiatedOp::getValues();
     int i = 0;
     int c = 1;
     for (var_symbol_list::const_iterator pi = p->getVars()->begin();
             pi != p->getVars()->end(); ++pi, ++i) {
-        if (instantiatedOp::getValues().find((*pi)->type) ==
-                instantiatedOp::getValues().end()) {
-            instantiatedOp::getValues()[(*pi)->type] = tc->range(*pi);
-        };
-        vals[i] = starts[i] = instantiatedOp::getValues()[(*pi)->type].begin();
-        ends[i] = instantiatedOp::getValues()[(*pi)->type].end();
+        map< VAL::pddl_type *, vector< VAL::const_symbol * > >::const_iterator
+        v = values.find((*pi)->type);
+        const vector< VAL::const_symbol * > &range =
+            v != values.end() ? v->second : tc->range(*pi);
+        vals[i] = starts[i] = range.begin();
+        ends[i] = range.end();
         if (ends[i] == starts[i]) return;
         fe[(*pi)] = *(vals[i]);
         vars[i] = *pi;
-        c *= instantiatedOp::getValues()[(*pi)->type].size();
+        c *= range.size();
     };
 
     valueTrue = (p->getQuantifier() == VAL::E_FORALL);
@@ -3,6 +3,7 @@
 
 #ifndef __SIMPLE_EVALUATOR
 #define __SIMPLE_EVALUATOR
+#include "AtomTable.h"
 #include "FastEnvironment.h"
 #include "VisitController.h"
 #include "ptree.h"
@@ -20,6 +21,11 @@ namespace Inst {
 typedef std::set< VAL::pred_symbol * > IState0Arity;
 typedef std::map< VAL::pred_symbol *, vector< VAL::parameter_symbol_list * > >
 IState;
+// The arguments of the initial facts, keyed by the predicate their heads are
+// typed forms of, for finding a fact by hashing instead of a search.
+typedef AtomTable< VAL::pred_symbol, VAL::const_symbol,
+        VAL::parameter_symbol_list * >
+        IStateFacts;
 
 class PrimitiveEvaluator {
 protected:
@@ -51,8 +57,10 @@ class InitialStateEvaluator : public PrimitiveEvaluator {
 protected:
     friend class ParameterDomainConstraints;
     friend class LitStoreEvaluator;
+    friend class StaticPreconditionCheck;
     static IState initState;
     static IState0Arity init0State;
+    static IStateFacts initFacts;
 
 public:
     InitialStateEvaluator(bool &v, bool &u, bool &w, bool &x)
@@ -21,16 +21,18 @@ using std::nan;
 
 namespace VAL {
 
-vector< StateObserver * > State::sos;
+thread_local vector< StateObserver * > State::sos;
+thread_local unsigned long State::serials = 0;
 
 void State::setNew(const effect_lists *is) {
     logState.clear();
     feValue.clear();
     changedPNEs.clear();
+    serial = ++serials;
 
     for (list< simple_effect * >::const_iterator i = is->add_effects.begin();
             i != is->add_effects.end(); ++i) {
-        logState[vld->pf.buildLiteral(*i)] = true;
+        logState.set(vld->pf.buildLiteral(*i)->getID(), true);
     };
 
     for (pc_list< assignment * >::const_iterator i1 =
@@ -44,7 +46,7 @@ void State::setNew(const effect_lists *is) {
             dynamic_cast< const num_expression * >((*i1)->getExpr())
             ->double_value();
 
-        feValue[fe] = feNewValue;
+        feValue[fe->getID()] = feNewValue;
 
         // setup initial value for LaTeX graph
         if (LaTeX) {
@@ -60,23 +62,49 @@ void State::setNew(const effect_lists *is) {
 };
 
 State::State(Validator *const v, const effect_lists *is)
-    : tolerance(v->getTolerance()), vld(v), time(0.0) {
+    : tolerance(v->getTolerance()),
+      vld(v),
+      props(&v->pf),
+      fexps(&v->fef),
+      time(0.0),
+      serial(0) {
+    // The graphs drawn for LaTeX are set up as the initial state is built.
+    CompiledProblem *cp = v->getCompiledProblem();
+    if (cp && cp->knowsInitialState() && !LaTeX) {
+        logState = cp->getInitialLiterals();
+        feValue = cp->getInitialValues();
+        changedPNEs = cp->getInitialPNEs();
+        serial = ++serials;
+        return;
+    };
+
     setNew(is);
+    if (cp && !cp->knowsInitialState())
+        cp->recordInitialState(logState, feValue, changedPNEs);
 };
 
+State::State(const State &s)
+    : tolerance(s.tolerance),
+      vld(s.vld),
+      props(s.props),
+      fexps(s.fexps),
+      logState(s.logState),
+      feValue(s.feValue),
+      time(s.time),
+      serial(++serials),
+      changedLiterals(s.changedLiterals),
+      changedPNEs(s.changedPNEs),
+      responsibleForProps(s.responsibleForProps),
+      responsibleForPNEs(s.responsibleForPNEs),
+      oldValues(s.oldValues) {};
+
 bool State::evaluate(const SimpleProposition *p) const {
-    LogicalState::const_iterator i = logState.find(p);
-    if (i != logState.end()) {
-        return i->second;
-    } else {
-        return false;
-    };
+    return logState.get(p->getID());
 };
 
 FEScalar State::evaluate(const FuncExp *fe) const {
-    NumericalState::const_iterator i = feValue.find(fe);
-    if (i != feValue.end()) {
-        return i->second;
+    if (feValue.isDefined(fe->getID())) {
+        return feValue.get(fe->getID());
     } else {
         return nan("");
     }
@@ -85,11 +113,11 @@ FEScalar State::evaluate(const FuncExp *fe) const {
 }
 
 FEScalar State::evaluateFE(const FuncExp *fe) const {
-    NumericalState::const_iterator i = feValue.find(fe);
-    if (i != feValue.end()) {
-        return i->second;
+    if (feValue.isDefined(fe->getID())) {
+        return feValue.get(fe->getID());
     } else {
         if (fe->isExternal()) {
+            DerivedGoal::noteVolatileRead();
             return fe->getExternalValue(this);
         }
         cerr << "Attempt to access undefined expression: " << *fe << "\n";
@@ -164,6 +192,7 @@ FEScalar State::evaluate(const expression *e, const Environment &bs) const {
     if (const special_val_expr *sp =
                 dynamic_cast< const special_val_expr * >(e)) {
         if (sp->getKind() == E_TOTAL_TIME) {
+            DerivedGoal::noteVolatileRead();
             if (vld->durativePlan()) return time;
             return vld->simpleLength();
         };
@@ -183,6 +212,7 @@ FEScalar State::evaluate(const expression *e, const Environment &bs) const {
     };
 
     if (const violation_term *vt = dynamic_cast< const violation_term * >(e)) {
+        DerivedGoal::noteVolatileRead();
         return vld->violationsFor(vt->getName());
     };
 
@@ -229,7 +259,8 @@ void State::add(const SimpleProposition *a) {
     else if (Verbose)
         cout << "Adding " << *a << "\n";
 
-    logState[a] = true;
+    if (!logState.get(a->getID())) changedLiterals.insert(a);
+    logState.set(a->getID(), true);
 };
 
 void State::del(const SimpleProposition *a) {
@@ -237,45 +268,50 @@ void State::del(const SimpleProposition *a) {
         *report << " \\> \\deleting{" << *a << "}\\\\\n";
     else if (Verbose)
         cout << "Deleting " << *a << "\n";
-    logState[a] = false;
+
+    if (logState.get(a->getID())) changedLiterals.insert(a);
+    logState.set(a->getID(), false);
 };
 
 void State::addChange(const SimpleProposition *a) {
-    if (LaTeX)
-        *report << " \\> \\adding{" << *a << "}\\\\\n";
-    else if (Verbose)
-        cout << "Adding " << *a << "\n";
-
-    if (!(logState[a])) changedLiterals.insert(a);
-    logState[a] = true;
+    add(a);
 };
 
 void State::delChange(const SimpleProposition *a) {
-    if (LaTeX)
-        *report << " \\> \\deleting{" << *a << "}\\\\\n";
-    else if (Verbose)
-        cout << "Deleting " << *a << "\n";
-
-    if (logState[a]) changedLiterals.insert(a);
-    logState[a] = false;
+    del(a);
 };
 
 void State::updateChange(const FuncExp *fe, assign_op aop, FEScalar value) {
-    FEScalar initialValue = feValue[fe];
+    FEScalar initialValue = feValue[fe->getID()];
+    const bool firstChange = changedPNEs.find(fe) == changedPNEs.end();
 
     update(fe, aop, value);
 
-    if (feValue[fe] != initialValue) {
-        if (changedPNEs.find(fe) == changedPNEs.end())
-            oldValues[fe] = initialValue;
+    if (firstChange && feValue.get(fe->getID()) != initialValue)
+        oldValues[fe] = initialValue;
+};
+
+void State::recordUpdate(const FuncExp *fe, bool wasDefined,
+                         FEScalar oldValue) {
+    if (!wasDefined || feValue.get(fe->getID()) != oldValue)
         changedPNEs.insert(fe);
-    }
+};
+
+void State::write(ostream &o) const {
+    for (const_iterator i = begin(); i != end(); ++i) {
+        o << **i << "\n";
+    };
+    for (unsigned int i = feValue.next(0); i < feValue.capacity();
+            i = feValue.next(i + 1)) {
+        o << "(= " << *(fexps->getFuncExp(i)) << " " << feValue.get(i) << ")\n";
+    };
 };
 
 State &State::operator=(const State &s) {
     logState = s.logState;
     feValue = s.feValue;
     time = s.time;
+    serial = ++serials;
     changedLiterals = s.changedLiterals;
     changedPNEs = s.changedPNEs;
 
@@ -283,6 +319,7 @@ State &State::operator=(const State &s) {
 };
 
 void State::update(const FuncExp *fe, assign_op aop, FEScalar value) {
+    const unsigned int id = fe->getID();
     bool setInitialValue = false;
     FEGraph *feg = 0;
 
@@ -291,9 +328,7 @@ void State::update(const FuncExp *fe, assign_op aop, FEScalar value) {
 
         // setup initial value if nec
         if (feg->initialTime == -1) {
-            map< const FuncExp *, FEScalar >::const_iterator i = feValue.find(fe);
-
-            if (i != feValue.end()) {
+            if (feValue.isDefined(id)) {
                 feg->initialTime = 0;
                 feg->initialValue = fe->evaluate(this);
             } else {
@@ -303,73 +338,78 @@ void State::update(const FuncExp *fe, assign_op aop, FEScalar value) {
         };
     };
 
+    const bool wasDefined = feValue.isDefined(id);
+
     if (Verbose && !LaTeX)
-        *report << "Updating " << *fe << " (" << feValue[fe] << ") by " << value
+        *report << "Updating " << *fe << " (" << feValue[id] << ") by " << value
                 << " ";
 
-    FEScalar feValueInt = feValue[fe];
+    FEScalar feValueInt = feValue[id];
 
     switch (aop) {
     case E_ASSIGN:
         if (LaTeX) {
-            *report << " \\> \\assignment{" << *fe << "}{" << feValue[fe] << "}{"
+            *report << " \\> \\assignment{" << *fe << "}{" << feValue[id] << "}{"
                     << value << "}\\\\\n";
         } else if (Verbose)
             cout << "assignment\n";
-        feValue[fe] = value;
+        feValue[id] = value;
         break;
     case E_ASSIGN_CTS:
         if (LaTeX) {
-            *report << " \\> \\assignmentcts{" << *fe << "}{" << feValue[fe]
+            *report << " \\> \\assignmentcts{" << *fe << "}{" << feValue[id]
                     << "}{" << value << "}\\\\\n";
         } else if (Verbose)
             cout << "assignment\n";
-        feValue[fe] = value;
+        feValue[id] = value;
+        recordUpdate(fe, wasDefined, feValueInt);
         return;
     case E_INCREASE:
         if (LaTeX) {
-            *report << " \\> \\increase{" << *fe << "}{" << feValue[fe] << "}{"
+            *report << " \\> \\increase{" << *fe << "}{" << feValue[id] << "}{"
                     << value << "}\\\\\n";
         } else if (Verbose)
             cout << "increase\n";
-        feValue[fe] += value;
+        feValue[id] += value;
         break;
     case E_DECREASE:
         if (LaTeX) {
-            *report << " \\> \\decrease{" << *fe << "}{" << feValue[fe] << "}{"
+            *report << " \\> \\decrease{" << *fe << "}{" << feValue[id] << "}{"
                     << value << "}\\\\\n";
         } else if (Verbose)
             cout << "decrease\n";
-        feValue[fe] -= value;
+        feValue[id] -= value;
         break;
     case E_SCALE_UP:
         if (LaTeX) {
-            *report << " \\> \\scaleup{" << *fe << "}{" << feValue[fe] << "}{"
+            *report << " \\> \\scaleup{" << *fe << "}{" << feValue[id] << "}{"
                     << value << "}\\\\\n";
         } else if (Verbose)
             cout << "scale up\n";
-        feValue[fe] *= value;
+        feValue[id] *= value;
         break;
     case E_SCALE_DOWN:
         if (LaTeX) {
-            *report << " \\> \\scaledown{" << *fe << "}{" << feValue[fe] << "}{"
+            *report << " \\> \\scaledown{" << *fe << "}{" << feValue[id] << "}{"
                     << value << "}\\\\\n";
         } else if (Verbose)
             cout << "scale down\n";
-        feValue[fe] /= value;
+        feValue[id] /= value;
         break;
     default:
         return;
     };
 
+    recordUpdate(fe, wasDefined, feValueInt);
+
     // handle discontinuities in graphs
     if (LaTeX) {
         if (setInitialValue) {
-            feValueInt = feValue[fe];
+            feValueInt = feValue[id];
             feg->initialValue = feValueInt;
         };
 
-        if ((feValueInt != feValue[fe]) || setInitialValue) {
+        if ((feValueInt != feValue[id]) || setInitialValue) {
             // check value is already defined, may be communitive updates at the
             // same
             // time
@@ -377,10 +417,10 @@ void State::update(const FuncExp *fe, assign_op aop, FEScalar value) {
                 feg->discons.find(time);
 
             if (j == feg->discons.end()) {
-                feg->discons[time] = make_pair(feValueInt, feValue[fe]);
+                feg->discons[time] = make_pair(feValueInt, feValue[id]);
                 feg->happenings.insert(time);
             } else {
-                j->second.second = feValue[fe];
+                j->second.second = feValue[id];
             };
         };
     };
@@ -6,6 +6,9 @@
 #include "StateObserver.h"
 #include <set>
 #include <cmath>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 using std::set;
 using std::nan;
@@ -22,20 +25,130 @@ namespace VAL {
 
 typedef long double FEScalar;
 
-typedef map< const SimpleProposition *, bool > LogicalState;
-typedef map< const FuncExp *, FEScalar > NumericalState;
+// Truth values of the ground literals held as a packed bitset, indexed by the
+// dense ID that the PropositionFactory assigns to each SimpleProposition.
+// Literals that have never been set read as false.
+class LogicalState {
+private:
+    typedef unsigned long Word;
+    static const unsigned int wordBits = sizeof(Word) * 8;
+
+    vector< Word > words;
+
+    // The index of the lowest set bit of a nonzero word.
+    static unsigned int lowestBit(Word bits) {
+#if defined(__GNUC__)
+        return __builtin_ctzl(bits);
+#elif defined(_MSC_VER)
+        // unsigned long is 32 bits wide under MSVC.
+        unsigned long i;
+        _BitScanForward(&i, bits);
+        return i;
+#else
+        unsigned int i = 0;
+        for (; !(bits & 1); bits >>= 1) ++i;
+        return i;
+#endif
+    };
+
+public:
+    LogicalState() : words() {};
+
+    bool get(unsigned int id) const {
+        const unsigned int w = id / wordBits;
+        return w < words.size() && ((words[w] >> (id % wordBits)) & 1);
+    };
+    void set(unsigned int id, bool b) {
+        const unsigned int w = id / wordBits;
+        if (w >= words.size()) {
+            if (!b) return;
+            words.resize(w + 1, 0);
+        };
+        if (b)
+            words[w] |= (Word(1) << (id % wordBits));
+        else
+            words[w] &= ~(Word(1) << (id % wordBits));
+    };
+    void clear() {
+        words.clear();
+    };
+
+    // Upper bound on the IDs that can be true.
+    unsigned int capacity() const {
+        return words.size() * wordBits;
+    };
+
+    // The first true ID not less than id, or capacity() if there is none.
+    unsigned int next(unsigned int id) const {
+        unsigned int w = id / wordBits;
+        if (w >= words.size()) return capacity();
+        Word bits = words[w] & (~Word(0) << (id % wordBits));
+        while (!bits) {
+            if (++w == words.size()) return capacity();
+            bits = words[w];
+        };
+        return w * wordBits + lowestBit(bits);
+    };
+};
+
+// Values of the ground PNEs held in a contiguous array, indexed by the dense
+// ID that the FuncExpFactory assigns to each FuncExp. A PNE is undefined until
+// it is first given a value.
+class NumericalState {
+private:
+    vector< FEScalar > values;
+    LogicalState defined;
+
+public:
+    NumericalState() : values(), defined() {};
+
+    bool isDefined(unsigned int id) const {
+        return defined.get(id);
+    };
+    FEScalar get(unsigned int id) const {
+        return values[id];
+    };
+    // Access to the value for update, defining it as 0 if it is not yet
+    // defined.
+    FEScalar &operator[](unsigned int id) {
+        if (id >= values.size()) values.resize(id + 1, 0);
+        if (!defined.get(id)) {
+            values[id] = 0;
+            defined.set(id, true);
+        };
+        return values[id];
+    };
+    void clear() {
+        values.clear();
+        defined.clear();
+    };
+
+    unsigned int capacity() const {
+        return defined.capacity();
+    };
+    unsigned int next(unsigned int id) const {
+        return defined.next(id);
+    };
+};
 
 class State {
 private:
     const double tolerance;
 
     Validator *const vld;
+    const PropositionFactory *const props;
+    const FuncExpFactory *const fexps;
 
     LogicalState logState;
     NumericalState feValue;
 
     double time;
 
+    // Identifies the contents of this state for as long as they are only
+    // changed by add, del and update, which record what they change.
+    unsigned long serial;
+    static thread_local unsigned long serials;
+
     // record which literals and PNEs have changed by appliaction of an
     // happening
     // (for triggering events)
@@ -48,11 +161,13 @@ private:
     map< const FuncExp *, FEScalar > oldValues;
 
     FEScalar evaluateFE(const FuncExp *fe) const;
+    void recordUpdate(const FuncExp *fe, bool wasDefined, FEScalar oldValue);
 
-    static vector< StateObserver * > sos;
+    static thread_local vector< StateObserver * > sos;
 
 public:
     State(Validator *const v, const effect_lists *is);
+    State(const State &s);
     State &operator=(const State &s);
 
     friend class FuncExp;
@@ -65,6 +180,9 @@ public:
     double getTime() const {
         return time;
     };
+    unsigned long getSerial() const {
+        return serial;
+    };
 
     bool progress(const Happening *h);
     bool progressCtsEvent(const Happening *h);
@@ -79,7 +197,7 @@ public:
     const LogicalState &getLogicalState() const {
         return logState;
     };
-    // to also record what has changed
+    // as above, but also remembering the prior values of changed PNEs
     void addChange(const SimpleProposition *);
     void delChange(const SimpleProposition *);
     void updateChange(const FuncExp *fe, assign_op aop, FEScalar value);
@@ -111,28 +229,17 @@ public:
 
     void setNew(const effect_lists *effs);
 
-    void write(ostream &o) const {
-        for (LogicalState::const_iterator i = logState.begin();
-                i != logState.end(); ++i) {
-            if (i->second) o << *(i->first) << "\n";
-        };
-        for (NumericalState::const_iterator i = feValue.begin();
-                i != feValue.end(); ++i) {
-            o << "(= " << *(i->first) << " " << i->second << ")\n";
-        };
-    };
+    void write(ostream &o) const;
 
     //	friend class const_iterator;
 
     class const_iterator {
     private:
         const State &st;
-        LogicalState::const_iterator it;
+        unsigned int it;
 
     public:
-        const_iterator(const State &s) : st(s), it(st.logState.begin()) {
-            while (it != st.logState.end() && !it->second) ++it;
-        };
+        const_iterator(const State &s) : st(s), it(st.logState.next(0)) {};
 
         bool operator==(const const_iterator &itr) const {
             return it == itr.it;
@@ -143,17 +250,16 @@ public:
         };
 
         const_iterator &operator++() {
-            ++it;
-            while (it != st.logState.end() && !it->second) ++it;
+            it = st.logState.next(it + 1);
             return *this;
         };
 
         const SimpleProposition *operator*() const {
-            return it->first;
+            return st.props->getLiteral(it);
         };
 
         void toEnd() {
-            it = st.logState.end();
+            it = st.logState.capacity();
         };
     };
 
@@ -23,7 +23,7 @@ using std::ostream;
 namespace VAL {
 
 extern bool Verbose;
-extern ostream *report;
+extern thread_local ostream *report;
 extern parse_category *top_thing;
 
 extern analysis *current_analysis;
@@ -3,6 +3,7 @@
 
 #include "ToFunction.h"
 #include "FastEnvironment.h"
+#include "GroundedTaskCache.h"
 #include "SASActions.h"
 #include "SimpleEval.h"
 #include "instantiation.h"
@@ -608,16 +609,47 @@ void FunctionStructure::processActions() {
     };
 };
 
-void FunctionStructure::buildLayers() {
+void FunctionStructure::buildLayers(const string &cacheFile,
+                                    const string &domainFile,
+                                    const string &problemFile,
+                                    bool pruneUnreachable) {
     SimpleEvaluator::setInitialState();
-    for (operator_list::const_iterator os =
-                current_analysis->the_domain->ops->begin();
-            os != current_analysis->the_domain->ops->end(); ++os) {
+    const operator_list *ops = current_analysis->the_domain->ops;
+    const vector< int > counts =
+        cacheFile.empty()
+        ? instantiatedOp::instantiateAll(ops, current_analysis->the_problem,
+                                         *theTC, 1)
+        : GroundedTaskCache::instantiateAll(
+            cacheFile, domainFile, problemFile, ops,
+            current_analysis->the_problem, *theTC, 1);
+    int s = 0;
+    vector< int >::const_iterator count = counts.begin();
+    for (operator_list::const_iterator os = ops->begin(); os != ops->end();
+            ++os, ++count) {
         cout << (*os)->name->getName() << "\n";
-        int s = instantiatedOp::howMany();
-        instantiatedOp::instantiate(*os, current_analysis->the_problem, *theTC);
-        cout << instantiatedOp::howMany() << " so far\n";
-        startOp[*os] = make_pair(s, instantiatedOp::howMany());
+        cout << *count << " so far\n";
+        startOp[*os] = make_pair(s, *count);
+        s = *count;
+    };
+    if (pruneUnreachable) {
+        instantiatedOp::createAllLiterals(current_analysis->the_problem, theTC);
+        instantiatedOp::filterOps(theTC);
+        instantiatedOp::filterUnreachableOps(current_analysis->the_problem,
+                                             theTC);
+        cout << instantiatedOp::howMany() << " reachable\n";
+
+        // The operators kept stay in order, so each operator's ground
+        // operators are still together.
+        int k = 0;
+        for (operator_list::const_iterator os = ops->begin();
+                os != ops->end(); ++os) {
+            s = k;
+            while (k < instantiatedOp::howMany() &&
+                    instantiatedOp::getInstOp(k)->forOp() == *os) {
+                ++k;
+            };
+            startOp[*os] = make_pair(s, k);
+        };
     };
     for (OpStore::iterator i = instantiatedOp::opsBegin();
             i != instantiatedOp::opsEnd(); ++i) {
@@ -617,7 +617,20 @@ public:
     };
     bool tryMatchedPre(int k, instantiatedOp *iop, const var_symbol *var,
                        SASActionTemplate *sasact, ValueRep *vrep);
-    void buildLayers();
+    /** @brief  Instantiate every operator and prepare the layers.
+     *
+     * If <code>cacheFile</code> is given, the ground operators are loaded
+     * from it when it was written for the domain and problem files, and
+     * otherwise ground and written to it (see
+     * <code>Inst::GroundedTaskCache</code>).  If
+     * <code>pruneUnreachable</code>, the operators that are trivially
+     * unreachable, or unreachable even when delete effects are ignored, are
+     * erased before the layers are built over those that remain.
+     */
+    void buildLayers(const string &cacheFile = string(),
+                     const string &domainFile = string(),
+                     const string &problemFile = string(),
+                     bool pruneUnreachable = false);
     typedef SASActionTemplates::const_iterator iterator;
     iterator begin() const {
         return sasActionTemplates.begin();
@@ -8,8 +8,8 @@
 
 namespace VAL {
 
-int PreferenceMonitor::id = 0;
-std::set< int > PreferenceMonitor::done;
+thread_local int PreferenceMonitor::id = 0;
+thread_local std::set< int > PreferenceMonitor::done;
 
 #define MESSAGE(x)            \
   if (LaTeX) {                \
@@ -31,8 +31,8 @@ public:
 
 class PreferenceMonitor : public Monitor {
 private:
-    static int id;
-    static std::set< int > done;
+    static thread_local int id;
+    static thread_local std::set< int > done;
 
     int myId;
     mutable Validator *vld;
@@ -24,6 +24,8 @@ namespace VAL {
 
 bool stepLengthDefault;
 bool makespanDefault;
+bool bottomUpDPs = false;
+bool indexedEvents = false;
 
 string getName(plan_step *ps) {
     string actionName = ps->op_sym->getName();
@@ -233,9 +235,10 @@ void changeVars(expression *e,
     };
 };
 
-bool DerivationRules::stratification() const {
-    map< pair< derivation_rule *, derivation_rule * >, unsigned int >
-    analyseDPs;
+// Fills in which rules occur in which, closed transitively: 0 = does not
+// occur, 1 = occurs positively, 2 = occurs negatively. The rules can be
+// stratified if none occurs negatively in itself.
+bool DerivationRules::analyseOccurrences(Occurrences &analyseDPs) const {
     // order DPs
     for (pc_list< derivation_rule * >::const_iterator i = drvs->begin();
             i != drvs->end(); ++i) {
@@ -287,13 +290,13 @@ bool DerivationRules::stratification() const {
         if (analyseDPs[make_pair(*i, *i)] == 2) return false;
     };
 
-    if (!Verbose || drvs->size() == 0) return true;
-
-    // extract stratification
+    return true;
+};
 
-    vector< pair< unsigned int, vector< string > > > stratification;
+vector< vector< derivation_rule * > > DerivationRules::extractStrata(
+    Occurrences &analyseDPs) const {
+    vector< vector< derivation_rule * > > stratification;
 
-    unsigned int level = 1;
     map< derivation_rule *, unsigned int > remaining;
 
     for (pc_list< derivation_rule * >::const_iterator i = drvs->begin();
@@ -302,9 +305,8 @@ bool DerivationRules::stratification() const {
     };
 
     while (true) {
-        vector< string > stratum;
+        vector< derivation_rule * > stratum;
         bool stratfin = true;
-        vector< derivation_rule * > toRemove;
 
         for (map< derivation_rule *, unsigned int >::const_iterator i =
                     remaining.begin();
@@ -335,34 +337,56 @@ bool DerivationRules::stratification() const {
                 if (ijr2)
 
                 {
-                    stratum.push_back(j->first->get_head()->head->getName());
-                    toRemove.push_back(j->first);
+                    stratum.push_back(j->first);
                 };
             };
         };
 
-        for (vector< derivation_rule * >::const_iterator k = toRemove.begin();
-                k != toRemove.end(); ++k)
+        for (vector< derivation_rule * >::const_iterator k = stratum.begin();
+                k != stratum.end(); ++k)
             remaining[*k] = 0;
 
-        stratification.push_back(make_pair(level, stratum));
-
-        ++level;
+        stratification.push_back(stratum);
     };
 
+    return stratification;
+};
+
+vector< vector< derivation_rule * > > DerivationRules::strata() const {
+    Occurrences analyseDPs;
+
+    if (!analyseOccurrences(analyseDPs))
+        return vector< vector< derivation_rule * > >();
+
+    return extractStrata(analyseDPs);
+};
+
+bool DerivationRules::stratification() const {
+    Occurrences analyseDPs;
+
+    if (!analyseOccurrences(analyseDPs)) return false;
+
+    if (!Verbose || drvs->size() == 0) return true;
+
+    // extract stratification
+
+    const vector< vector< derivation_rule * > > stratification =
+        extractStrata(analyseDPs);
+
     if (LaTeX) {
         *report << "\\subsection{Stratification}\n";
-        for (vector< pair< unsigned int, vector< string > > >::const_iterator i =
+        for (vector< vector< derivation_rule * > >::const_iterator i =
                     stratification.begin();
                 i != stratification.end();)
 
         {
-            *report << "{\\bf Strata " << i->first << ":}\\\\\n ";
+            *report << "{\\bf Strata " << i - stratification.begin() + 1
+                    << ":}\\\\\n ";
 
-            for (vector< string >::const_iterator s = i->second.begin();
-                    s != i->second.end(); ++s) {
-                *report << *s;
-                if (s + 1 != i->second.end()) *report << ", ";
+            for (vector< derivation_rule * >::const_iterator s = i->begin();
+                    s != i->end(); ++s) {
+                *report << (*s)->get_head()->head->getName();
+                if (s + 1 != i->end()) *report << ", ";
             };
 
             if (++i != stratification.end()) *report << "\\\\";
@@ -372,17 +396,17 @@ bool DerivationRules::stratification() const {
 
     {
         cout << "Stratification\n";
-        for (vector< pair< unsigned int, vector< string > > >::const_iterator i =
+        for (vector< vector< derivation_rule * > >::const_iterator i =
                     stratification.begin();
                 i != stratification.end(); ++i)
 
         {
-            cout << "Strata " << i->first << ": ";
+            cout << "Strata " << i - stratification.begin() + 1 << ": ";
 
-            for (vector< string >::const_iterator s = i->second.begin();
-                    s != i->second.end(); ++s) {
-                cout << *s;
-                if (s + 1 != i->second.end()) cout << ", ";
+            for (vector< derivation_rule * >::const_iterator s = i->begin();
+                    s != i->end(); ++s) {
+                cout << (*s)->get_head()->head->getName();
+                if (s + 1 != i->end()) cout << ", ";
             };
 
             cout << "\n\n";
@@ -779,6 +803,7 @@ Validator::~Validator() {
 
     graphs.clear();
 
+    if (bottomUpDPs) DerivedGoal::clearStrata();
     Environment::collect(this);
     delete finalInterestingState;
 };
@@ -880,6 +905,7 @@ bool Validator::extendPlan(Happening *h) {
 }
 
 bool Validator::prepareToExecute() {
+    if (bottomUpDPs && derivRules) setUpDerivedPredicateStrata();
     if (theplan.length() == 0) return true;
     //	cout << "STATE CURRENTLY: " << state << "\n";
     if (LaTeX) {
@@ -894,6 +920,57 @@ bool Validator::prepareToExecute() {
     return events.triggerInitialEvents(this, thisStep.getTime());
 }
 
+// Ground the stratified derivation rules over the objects that can bind their
+// parameters, so that derived predicates are materialised bottom up in each
+// state rather than evaluated on demand.
+void Validator::setUpDerivedPredicateStrata() {
+    const vector< vector< derivation_rule * > > rules = derivRules->strata();
+    vector< vector< const DerivedGoal * > > strata;
+
+    for (vector< vector< derivation_rule * > >::const_iterator i =
+                rules.begin();
+            i != rules.end(); ++i) {
+        strata.push_back(vector< const DerivedGoal * >());
+
+        for (vector< derivation_rule * >::const_iterator j = i->begin();
+                j != i->end(); ++j) {
+            vector< const var_symbol * > vars;
+            vector< vector< const_symbol * > > ranges;
+            bool empty = false;
+            for (parameter_symbol_list::const_iterator k =
+                        (*j)->get_head()->args->begin();
+                    k != (*j)->get_head()->args->end(); ++k) {
+                const var_symbol *v = dynamic_cast< const var_symbol * >(*k);
+                if (!v || find(vars.begin(), vars.end(), v) != vars.end())
+                    continue;
+                vars.push_back(v);
+                ranges.push_back(range(v));
+                empty = empty || ranges.back().empty();
+            };
+            if (empty) continue;
+
+            // step through every combination of objects for the parameters
+            vector< unsigned int > at(vars.size(), 0);
+            while (true) {
+                Environment bs;
+                for (unsigned int k = 0; k < vars.size(); ++k)
+                    bs[vars[k]] = ranges[k][at[k]];
+                const Environment *env = bs.copy(this);
+
+                strata.back().push_back(new DerivedGoal(
+                    (*j)->get_head(), pf.buildProposition((*j)->get_body(), *env),
+                    *env));
+
+                unsigned int k = 0;
+                while (k < at.size() && ++at[k] == ranges[k].size()) at[k++] = 0;
+                if (k == at.size()) break;
+            };
+        };
+    };
+
+    DerivedGoal::setStrata(strata);
+};
+
 void Validator::cleanUpAfterExecution() {
     if (LaTeX) *report << "\\end{tabbing}\n";
     thisStep.deleteActiveFEs();
@@ -1180,7 +1257,7 @@ vector< double > Validator::finalValue() const {
     return value;
 };
 
-vector< const_symbol * > Validator::range(const var_symbol *v) {
+const vector< const_symbol * > &Validator::range(const var_symbol *v) {
     return typeC.range(v);
 };
 
@@ -2592,7 +2669,8 @@ bool PlanRepair::slideEndOfPlan(const plan *repairingPlan,
             new Validator(v.getDerivRules(), v.getTolerance(), typeC, operators,
                           initialState, testPlan, metric, stepLength, durative,
                           current_analysis->the_domain->constraints,
-                          current_analysis->the_problem->constraints);
+                          current_analysis->the_problem->constraints,
+                          &compiled);
 
         anError = false;
         try {
@@ -2695,7 +2773,8 @@ bool PlanRepair::shakePlan(const plan *repairingPlan,
             new Validator(v.getDerivRules(), v.getTolerance(), typeC, operators,
                           initialState, testPlan, metric, stepLength, durative,
                           current_analysis->the_domain->constraints,
-                          current_analysis->the_problem->constraints);
+                          current_analysis->the_problem->constraints,
+                          &compiled);
 
         anError = false;
         try {
@@ -2857,7 +2936,8 @@ pair< const plan_step *, pair< bool, bool > > PlanRepair::repairPlanOneAction(
             new Validator(v.getDerivRules(), v.getTolerance(), typeC, operators,
                           initialState, testPlan, metric, stepLength, durative,
                           current_analysis->the_domain->constraints,
-                          current_analysis->the_problem->constraints);
+                          current_analysis->the_problem->constraints,
+                          &compiled);
 
         try {
             planRepairValidator->execute();
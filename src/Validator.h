@@ -48,6 +48,7 @@
 #ifndef __VALIDATOR
 #define __VALIDATOR
 #include "Action.h"
+#include "CompiledProblem.h"
 #include "Events.h"
 #include "Plan.h"
 #include "Polynomial.h"
@@ -179,12 +180,22 @@ private:
     vector< const disj_goal * > repeatedDPDisjs;  // used to keep list of disj
     // to be
     // deleted
+
+    typedef map< pair< derivation_rule *, derivation_rule * >, unsigned int >
+    Occurrences;
+    bool analyseOccurrences(Occurrences &analyseDPs) const;
+    vector< vector< derivation_rule * > > extractStrata(
+        Occurrences &analyseDPs) const;
+
 public:
     DerivationRules(const derivations_list *d, const operator_list *o);
     ~DerivationRules();
 
     bool checkDerivedPredicates() const;
     bool stratification() const;
+    // The rules grouped into strata, lowest first, or none if they cannot be
+    // stratified.
+    vector< vector< derivation_rule * > > strata() const;
     unsigned int occurNNF(derivation_rule *drv1, derivation_rule *drv2) const;
     unsigned int occur(string s, const goal *g) const;
     const goal *NNF(const goal *gl) const;
@@ -218,6 +229,7 @@ public:
 
 private:
     ErrorLog errorLog;
+    CompiledProblem *const compiled;
     const DerivationRules *derivRules;
     Events events;
 
@@ -250,6 +262,7 @@ private:
 
     TrajectoryConstraintsMonitor tjm;
 
+    void setUpDerivedPredicateStrata();
     bool step();
 
 public:
@@ -260,13 +273,16 @@ public:
         return 0;
     }
 
+    // A Validator given a CompiledProblem interns its atoms in it and takes
+    // its initial state from it, rather than building its own.
     Validator(const DerivationRules *dr, double tol, TypeChecker &tc,
               const operator_list *ops, const effect_lists *is, const plan *p,
               const metric_spec *m, bool lengthDefault, bool isDur,
-              con_goal *cg1, con_goal *cg2)
-        : fef(),
-          pf(this),
+              con_goal *cg1, con_goal *cg2, CompiledProblem *cp = 0)
+        : fef(cp ? cp->getPNEs() : 0),
+          pf(this, cp ? cp->getLiterals() : 0),
           errorLog(),
+          compiled(cp),
           derivRules(dr),
           events(ops),
           tolerance(tol),
@@ -285,6 +301,7 @@ public:
           followUp(theplan.end()),
           thisStep(theplan.begin()),
           tjm(this, cg1, cg2) {
+        if (compiled) compiled->startTrial();
         Polynomial::setAccuracy(tol);
     };
     Validator(const DerivationRules *dr, double tol, TypeChecker &tc,
@@ -294,6 +311,7 @@ public:
         : fef(),
           pf(this),
           errorLog(),
+          compiled(0),
           derivRules(dr),
           events(ops),
           tolerance(tol),
@@ -325,6 +343,9 @@ public:
     vector< double > finalValue() const;
     int simpleLength() const;
     bool durativePlan() const;
+    CompiledProblem *getCompiledProblem() const {
+        return compiled;
+    };
     double getTolerance() const {
         return tolerance;
     };
@@ -390,7 +411,7 @@ public:
         return derivRules;
     };
 
-    vector< const_symbol * > range(const var_symbol *v);
+    const vector< const_symbol * > &range(const var_symbol *v);
 
     Plan::const_iterator begin() const {
         return theplan.begin();
@@ -452,6 +473,8 @@ private:
     analysis *current_analysis;
     // for checking the goal
     const goal *theGoal;
+    // shared by the Validators built for each attempted repair
+    CompiledProblem compiled;
 
 public:
     PlanRepair(vector< plan_step * > initLits, double dl,
@@ -470,7 +493,8 @@ public:
           durative(isDur),
           operators(ops),
           initialState(is),
-          theGoal(g) {};
+          theGoal(g),
+          compiled() {};
 
     ~PlanRepair() {};
     void setDeadline(double d) {
@@ -8,6 +8,7 @@
 #include "State.h"
 #include "Validator.h"
 #include "ptree.h"
+#include <algorithm>
 #include <fstream>
 
 using namespace VAL;
@@ -16,8 +17,7 @@ namespace Inst {
 
 class PlanGraph::BVEvaluator : public VAL::VisitController {
 private:
-    // The BVEvaluator is going to own this bval.
-    BoundedValue *bval;
+    Bounds bval;
     PlanGraph &pg;
     VAL::FastEnvironment *fenv;
 
@@ -25,75 +25,46 @@ private:
 
 public:
     BVEvaluator(PlanGraph &p, VAL::FastEnvironment *fe)
-        : bval(0), pg(p), fenv(fe), continuous(false) {};
-    ~BVEvaluator() {
-        delete bval;
-    };
+        : bval(Bounds::undefined()), pg(p), fenv(fe), continuous(false) {};
     bool isContinuous() const {
         return continuous;
     };
-    BoundedValue *getBV() {
-        BoundedValue *bv = bval;
-        bval = 0;
-        return bv;
+    const Bounds &getBounds() const {
+        return bval;
     };
     virtual void visit_plus_expression(plus_expression *pe) {
         pe->getRHS()->visit(this);
-        BoundedValue *br = bval;
-        bval = 0;
+        const Bounds br = bval;
         pe->getLHS()->visit(this);
-        br = (*bval += br);
-        if (br != bval) {
-            delete bval;
-            bval = br;
-        };
+        bval = bval + br;
     };
     virtual void visit_minus_expression(minus_expression *me) {
         me->getRHS()->visit(this);
-        BoundedValue *br = bval;
-        bval = 0;
+        const Bounds br = bval;
         me->getLHS()->visit(this);
-        br = (*bval -= br);
-        if (br != bval) {
-            delete bval;
-            bval = br;
-        };
+        bval = bval - br;
     };
     virtual void visit_mul_expression(mul_expression *pe) {
         pe->getRHS()->visit(this);
-        BoundedValue *br = bval;
-        bval = 0;
+        const Bounds br = bval;
         pe->getLHS()->visit(this);
-        if (continuous) {
-            bval = br;
-        } else {
-            br = (*bval *= br);
-            if (br != bval) {
-                delete bval;
-                bval = br;
-            };
-        };
+        bval = continuous ? br : bval * br;
     };
     virtual void visit_div_expression(div_expression *pe) {
         pe->getRHS()->visit(this);
-        BoundedValue *br = bval;
-        bval = 0;
+        const Bounds br = bval;
         pe->getLHS()->visit(this);
-        br = (*bval /= br);
-        if (br != bval) {
-            delete bval;
-            bval = br;
-        };
+        bval = bval / br;
     };
     virtual void visit_uminus_expression(uminus_expression *um) {
         um->getExpr()->visit(this);
-        bval->negate();
+        bval = -bval;
     };
     virtual void visit_int_expression(int_expression *ie) {
-        bval = new PointValue(ie->double_value());
+        bval = Bounds::point(ie->double_value());
     };
     virtual void visit_float_expression(float_expression *fe) {
-        bval = new PointValue(fe->double_value());
+        bval = Bounds::point(fe->double_value());
     };
     virtual void visit_special_val_expr(special_val_expr *) {
         continuous = true;
@@ -101,7 +72,7 @@ public:
     virtual void visit_func_term(func_term *ft) {
         PNE pne(ft, fenv);
         FluentEntry *fe = pg.fluents.find(instantiatedOp::getPNE(&pne));
-        bval = fe ? fe->getBV()->copy() : new Undefined();
+        bval = fe ? fe->getBounds() : Bounds::undefined();
     };
 };
 
@@ -136,8 +107,8 @@ public:
             return;
         } else {
             Literal e(s->getProp(), f);
-            Literal *lptr = instantiatedOp::getLiteral(&e);
-            PropEntry *eid = spes.find(lptr);
+            Literal *lptr = instantiatedOp::findLiteral(&e);
+            PropEntry *eid = lptr ? spes.find(lptr) : 0;
             if (eid) {
                 if (s->getPolarity() == E_NEG) {
                     evaluation = eid->gotDeleters();
@@ -191,26 +162,24 @@ public:
         // bounds check.
         PlanGraph::BVEvaluator bve(pg, f);
         c->getLHS()->visit(&bve);
-        BoundedValue *bvl = bve.getBV();
+        const Bounds bvl = bve.getBounds();
         c->getRHS()->visit(&bve);
-        BoundedValue *bvr = bve.getBV();
-        BoundedValue *bvres = (*bvl -= bvr);
+        const Bounds bvres = bvl - bve.getBounds();
         switch (c->getOp()) {
         case E_GREATER:
-            evaluation = !bvres->gotUB() || bvres->getUB() > 0;
+            evaluation = bvres.hi > 0;
             break;
         case E_GREATEQ:
-            evaluation = !bvres->gotUB() || bvres->getUB() >= 0;
+            evaluation = bvres.hi >= 0;
             break;
         case E_LESS:
-            evaluation = !bvres->gotLB() || bvres->getLB() < 0;
+            evaluation = bvres.lo < 0;
             break;
         case E_LESSEQ:
-            evaluation = !bvres->gotLB() || bvres->getLB() <= 0;
+            evaluation = bvres.lo <= 0;
             break;
         case E_EQUALS:
-            evaluation = (!bvres->gotLB() || bvres->getLB() <= 0) &&
-                         (!bvres->gotUB() || bvres->getUB() >= 0);
+            evaluation = bvres.lo <= 0 && bvres.hi >= 0;
             break;
         default:
             break;
@@ -258,7 +227,10 @@ public:
     virtual void visit_simple_goal(simple_goal *s) {
         if (EPS(s->getProp()->head)->getParent() != this->equality) {
             Literal e(s->getProp(), f);
-            Literal *lptr = instantiatedOp::getLiteral(&e);
+            Literal *lptr = instantiatedOp::findLiteral(&e);
+            // A literal that was never made is never true, so there is
+            // nothing to support it.
+            if (!lptr) return;
             PropEntry *eid = spes.findInAll(lptr);
             if (eid) {
                 if ((context && s->getPolarity() == E_NEG) ||
@@ -308,6 +280,135 @@ public:
     };
 };
 
+// Sorts the precondition of an action for event-driven construction: the
+// positive literals of its top-level conjunction are counted and equalities
+// are settled once; whatever is left is reported as the residue. The
+// negative literals of the conjunction are part of the residue, but are
+// also collected for those that can test them directly.
+class PreconditionIndexer : public VisitController {
+private:
+    FastEnvironment *f;
+    vector< Literal * > lits;
+    vector< Literal * > negLits;
+    bool numeric;
+    bool other;
+    bool never;
+    bool durative;
+
+    pred_symbol *equality;
+
+public:
+    PreconditionIndexer(FastEnvironment *fe)
+        : f(fe),
+          lits(),
+          negLits(),
+          numeric(false),
+          other(false),
+          never(false),
+          durative(false),
+          equality(current_analysis->pred_tab.symbol_probe("=")) {}
+
+    const vector< Literal * > &getLiterals() const {
+        return lits;
+    };
+    const vector< Literal * > &getNegativeLiterals() const {
+        return negLits;
+    };
+    // Whether the literals are the start conditions of a durative action.
+    bool isDurative() const {
+        return durative;
+    };
+    PlanGraph::Residue getResidue() const {
+        if (never) return PlanGraph::NEVER;
+        if (other || !negLits.empty()) return PlanGraph::OTHER;
+        return numeric ? PlanGraph::NUMERIC : PlanGraph::COUNTED;
+    };
+    // Whether the precondition is no more than its literals and equalities.
+    bool literalsOnly() const {
+        return !numeric && !other;
+    };
+
+    // Index a proposition that must hold, or must not. A literal that was
+    // never made cannot be true: needed, it can never be met, and negated it
+    // always is, so it is left out.
+    void index(const proposition *p, bool positive) {
+        if (EPS(p->head)->getParent() == this->equality) {
+            if (((*f)[p->args->front()] == (*f)[p->args->back()]) !=
+                    positive) {
+                never = true;
+            };
+            return;
+        };
+        Literal e(p, f);
+        Literal *lptr = instantiatedOp::findLiteral(&e);
+        if (!lptr) {
+            if (positive) never = true;
+            return;
+        };
+        vector< Literal * > &ls = positive ? lits : negLits;
+        if (find(ls.begin(), ls.end(), lptr) == ls.end()) {
+            ls.push_back(lptr);
+        };
+    };
+
+    virtual void visit_simple_goal(simple_goal *s) {
+        index(s->getProp(), s->getPolarity() == E_POS);
+    };
+
+    virtual void visit_conj_goal(conj_goal *c) {
+        for (goal_list::const_iterator i = c->getGoals()->begin();
+                i != c->getGoals()->end(); ++i) {
+            (*i)->visit(this);
+        }
+    };
+
+    virtual void visit_comparison(comparison *) {
+        numeric = true;
+    };
+
+    virtual void visit_qfied_goal(qfied_goal *) {
+        other = true;
+    };
+    virtual void visit_disj_goal(disj_goal *) {
+        other = true;
+    };
+    // What must hold when a durative action starts is indexed; conditions
+    // at its end are left over.
+    virtual void visit_timed_goal(timed_goal *t) {
+        if (t->getTime() == E_AT_START || t->getTime() == E_OVER_ALL) {
+            t->getGoal()->visit(this);
+        } else {
+            other = true;
+        };
+    };
+    virtual void visit_imply_goal(imply_goal *) {
+        other = true;
+    };
+    // The parser makes (not (p ?x)) a negation of a positive simple goal.
+    virtual void visit_neg_goal(neg_goal *n) {
+        const simple_goal *s = dynamic_cast< const simple_goal * >(n->getGoal());
+        if (s) {
+            index(s->getProp(), s->getPolarity() != E_POS);
+        } else {
+            other = true;
+        };
+    };
+
+    virtual void visit_action(action *op) {
+        if (op->precondition) op->precondition->visit(this);
+    };
+    virtual void visit_event(event *e) {
+        if (e->precondition) e->precondition->visit(this);
+    };
+    virtual void visit_process(process *p) {
+        if (p->precondition) p->precondition->visit(this);
+    };
+    virtual void visit_durative_action(durative_action *da) {
+        durative = true;
+        if (da->precondition) da->precondition->visit(this);
+    };
+};
+
 void FluentEntry::write(ostream &o) const {
     thefluent->write(o);
     o << "[";
@@ -316,7 +417,13 @@ void FluentEntry::write(ostream &o) const {
         (*i)->write(o);
         o << " ";
     };
-    o << "]\nBounded Range: " << *bval << "\n";
+    for (vector< Update >::const_iterator i = updates.begin();
+            i != updates.end(); ++i) {
+        UpdateValue(i->updater, i->exp, i->op, i->value.toBoundedValue())
+        .write(o);
+        o << " ";
+    };
+    o << "]\nBounded Range: " << getBounds() << "\n";
 };
 
 BoundedValue *BoundedInterval::operator+=(const BoundedValue *bv) {
@@ -410,54 +517,6 @@ BoundedValue *PointValue::operator/=(const BoundedValue *bv) {
     return bi;
 };
 
-BoundedValue *PlanGraph::update(BoundedValue *bv, const VAL::expression *exp,
-                                const VAL::assign_op op,
-                                VAL::FastEnvironment *fe) {
-    BVEvaluator bve(*this, fe);
-    exp->visit(&bve);
-    BoundedValue *b = bve.getBV();
-    cout << "Evaluated to " << *b << "\n";
-    switch (op) {
-    case E_ASSIGN:
-        bv = b->copy();
-        break;
-    case E_INCREASE:
-        if (bve.isContinuous()) {
-            if (!b->gotLB() || b->getLB() < 0) {
-                bv = bv->infLower();
-            };
-            if (!b->gotUB() || b->getUB() > 0) {
-                bv = bv->infUpper();
-            };
-        } else {
-            bv = (*bv += b);
-        };
-        break;
-    case E_DECREASE:
-        if (bve.isContinuous()) {
-            if (!b->gotLB() || b->getLB() < 0) {
-                bv = bv->infUpper();
-            };
-            if (!b->gotUB() || b->getUB() > 0) {
-                bv = bv->infLower();
-            };
-        } else {
-            bv = (*bv -= b);
-        };
-        break;
-    case E_SCALE_UP:
-        bv = (*bv *= b);
-        break;
-    case E_SCALE_DOWN:
-        bv = (*bv /= b);
-        break;
-    default:
-        break;
-    };
-    delete b;
-    return bv;
-};
-
 void Constraint::write(ostream &o) const {
     o << *bval;
 };
@@ -473,28 +532,6 @@ void UpdateValue::write(ostream &o) const {
       << " to " << *bval;
 };
 
-void FluentEntry::addUpdatedBy(ActEntry *ae, const VAL::expression *expr,
-                               const VAL::assign_op op, PlanGraph *pg) {
-    cout << "Performing BV calc on " << *bval << "\n";
-    BoundedValue *vv = bval->copy();
-    BoundedValue *v = pg->update(vv, expr, op, ae->getIO()->getEnv());
-    cout << "Got " << *v << "\n";
-    if (vv != v) {
-        delete vv;
-    };
-    Constraint *c = new UpdateValue(ae, expr, op, v);
-    constrs.push_back(c);
-    if (!tmpaccum) {
-        tmpaccum = bval->copy();
-    };
-    cout << "tmpaccum is " << *tmpaccum << "\n";
-    BoundedValue *nv = tmpaccum->accum(v);
-    if (nv != tmpaccum) {
-        delete tmpaccum;
-    };
-    tmpaccum = nv;
-};
-
 BoundedValue *PointValue::accum(const BoundedValue *bv) {
     if (bv->contains(val)) {
         return bv->copy();
@@ -505,9 +542,188 @@ BoundedValue *PointValue::accum(const BoundedValue *bv) {
     };
 };
 
-PlanGraph::PlanGraph(GraphFactory *f)
+namespace {
+
+const double infinity = std::numeric_limits< double >::infinity();
+
+};  // namespace
+
+// A point combined with anything becomes an interval, and an undefined value
+// stays undefined, as with the BoundedValue classes.
+Bounds Bounds::operator+(const Bounds &b) const {
+    if (kind == UNDEFINED) return *this;
+    const Bounds r = {INTERVAL, gotLB() && b.gotLB() ? lo + b.lo : -infinity,
+                      gotUB() && b.gotUB() ? hi + b.hi : infinity
+                     };
+    return r;
+};
+
+Bounds Bounds::operator-(const Bounds &b) const {
+    if (kind == UNDEFINED) return *this;
+    const Bounds r = {INTERVAL, gotLB() && b.gotUB() ? lo - b.hi : -infinity,
+                      gotUB() && b.gotLB() ? hi - b.lo : infinity
+                     };
+    return r;
+};
+
+Bounds Bounds::operator*(const Bounds &b) const {
+    if (kind == UNDEFINED) return *this;
+    const Bounds r = {INTERVAL, gotLB() && b.gotLB() ? lo * b.lo : -infinity,
+                      gotUB() && b.gotUB() ? hi * b.hi : infinity
+                     };
+    return r;
+};
+
+Bounds Bounds::operator/(const Bounds &) const {
+    if (kind == UNDEFINED) return *this;
+    // This case must be handled properly...
+    cout << "WARNING: Division not managed properly, yet!\n";
+    const Bounds r = {INTERVAL, -infinity, infinity};
+    return r;
+};
+
+Bounds Bounds::operator-() const {
+    const Bounds r = {kind, kind == UNDEFINED ? lo : -hi,
+                      kind == UNDEFINED ? hi : -lo
+                     };
+    return r;
+};
+
+Bounds Bounds::infUpper() const {
+    if (kind == UNDEFINED) return *this;
+    const Bounds r = {INTERVAL, lo, infinity};
+    return r;
+};
+
+Bounds Bounds::infLower() const {
+    if (kind == UNDEFINED) return *this;
+    const Bounds r = {INTERVAL, -infinity, hi};
+    return r;
+};
+
+bool Bounds::contains(double d) const {
+    switch (kind) {
+    case POINT:
+        return lo == d;
+    case INTERVAL:
+        return lo <= d && hi >= d;
+    default:
+        return false;
+    };
+};
+
+Bounds Bounds::accum(const Bounds &b) const {
+    if (kind == UNDEFINED || (kind == POINT && b.contains(lo))) return b;
+    const Bounds r = {INTERVAL, min(lo, b.lo), max(hi, b.hi)};
+    return r;
+};
+
+BoundedValue *Bounds::toBoundedValue() const {
+    switch (kind) {
+    case POINT:
+        return new PointValue(lo);
+    case INTERVAL: {
+        BoundedInterval *bi = new BoundedInterval(lo, hi);
+        if (!gotLB()) bi->infLower();
+        if (!gotUB()) bi->infUpper();
+        return bi;
+    };
+    default:
+        return new Undefined();
+    };
+};
+
+ostream &operator<<(ostream &o, const Bounds &b) {
+    BoundedValue *bv = b.toBoundedValue();
+    o << *bv;
+    delete bv;
+    return o;
+};
+
+Bounds FluentStore::update(const Bounds &bv, const Bounds &b, bool continuous,
+                           VAL::assign_op op) {
+    Bounds r = bv;
+    switch (op) {
+    case E_ASSIGN:
+        return b;
+    case E_INCREASE:
+        if (!continuous) return bv + b;
+        if (b.lo < 0) r = r.infLower();
+        if (b.hi > 0) r = r.infUpper();
+        return r;
+    case E_DECREASE:
+        if (!continuous) return bv - b;
+        if (b.lo < 0) r = r.infUpper();
+        if (b.hi > 0) r = r.infLower();
+        return r;
+    case E_SCALE_UP:
+        return bv * b;
+    case E_SCALE_DOWN:
+        return bv / b;
+    default:
+        return bv;
+    };
+};
+
+void FluentStore::queue(FluentEntry *fe, ActEntry *ae,
+                        const VAL::expression *exp, VAL::assign_op op,
+                        const Bounds &rhs, bool continuous) {
+    const Update u = {fe->getSlot(), op, continuous, rhs, fe, ae, exp};
+    batch.push_back(u);
+};
+
+// The updates only read the bounds of the level they are made at, so they
+// are applied in one pass over the batch, each hull being gathered in the
+// next arrays, and the touched slots are then copied back together.
+bool FluentStore::finishLevel() {
+    for (vector< Update >::const_iterator u = batch.begin(); u != batch.end();
+            ++u) {
+        const unsigned int i = u->slot;
+        const Bounds v = update(get(i), u->rhs, u->continuous, u->op);
+        u->fluent->addUpdate(u->updater, u->exp, u->op, v);
+        Bounds acc = get(i);
+        if (touched[i]) {
+            const Bounds b = {static_cast< Bounds::Kind >(nextKind[i]),
+                              nextLo[i], nextHi[i]
+                             };
+            acc = b;
+        } else {
+            touched[i] = true;
+            touchedSlots.push_back(i);
+        };
+        acc = acc.accum(v);
+        nextKind[i] = acc.kind;
+        nextLo[i] = acc.lo;
+        nextHi[i] = acc.hi;
+    };
+    batch.clear();
+
+    bool changed = false;
+    for (vector< unsigned int >::const_iterator t = touchedSlots.begin();
+            t != touchedSlots.end(); ++t) {
+        const unsigned int i = *t;
+        changed |= kind[i] != nextKind[i] || lo[i] != nextLo[i] ||
+                   hi[i] != nextHi[i];
+        kind[i] = nextKind[i];
+        lo[i] = nextLo[i];
+        hi[i] = nextHi[i];
+        touched[i] = false;
+    };
+    touchedSlots.clear();
+    return changed;
+};
+
+PlanGraph::PlanGraph(GraphFactory *f, bool c)
     : myFac(f),
-      inactive(instantiatedOp::opsBegin(), instantiatedOp::opsEnd()) {
+      inactive(),
+      counted(c),
+      visibleProps(0),
+      fluentsChanged(false),
+      current(-1) {
+    if (!counted) {
+        inactive.assign(instantiatedOp::opsBegin(), instantiatedOp::opsEnd());
+    };
+
     // Set up the initial state in the proposition spike...
     for (pc_list< simple_effect * >::const_iterator i =
                 current_analysis->the_problem->initial_state->add_effects.begin();
@@ -528,25 +744,22 @@ PlanGraph::PlanGraph(GraphFactory *f)
             ++i) {
         PNE pne((*i)->getFTerm(), 0);
         PNE *pne1 = instantiatedOp::getPNE(&pne);
-        FluentEntry *fl = myFac->makeFluentEntry(pne1);
-        fluents.addEntry(fl);
+        FluentEntry *fl = addFluent(pne1);
         fl->addInitial(
             (EFT(pne1->getHead())->getInitial(pne1->begin(), pne1->end()))
             .second);
     };
     fluents.finishedLevel();
     // copy(instantiatedOp::opsBegin(),instantiatedOp::opsEnd(),front_inserter(inactive));
-};
 
-Constraint::~Constraint() {
-    delete bval;
+    if (counted) {
+        indexCandidates();
+        propsVisible();
+    };
 };
 
-void FluentEntry::transferValue() {
-    if (!tmpaccum) return;
+Constraint::~Constraint() {
     delete bval;
-    bval = tmpaccum;
-    tmpaccum = 0;
 };
 
 struct IteratingActionChecker : public VisitController {
@@ -641,19 +854,19 @@ ActEntry::ActEntry(instantiatedOp *io)
     if (s.length() < 6) return;
     string tl = s.substr(s.length() - 4, 4);
     if (tl == "-inv") {
-        cout << "Found an invariant action " << *io << "\n";
+        if (Verbose) cout << "Found an invariant action " << *io << "\n";
         atype = INV;
         tl = s.substr(0, s.length() - 4);
         dur = dursFor.lookUp(tl, io);
         dur->setInv(this);
     } else if (tl == "-end") {
-        cout << "Found an end action " << *io << "\n";
+        if (Verbose) cout << "Found an end action " << *io << "\n";
         atype = END;
         tl = s.substr(0, s.length() - 4);
         dur = dursFor.lookUp(tl, io);
         dur->setEnd(this);
     } else if (s.length() > 6 && s.substr(s.length() - 6, 6) == "-start") {
-        cout << "Found a start action " << *io << "\n";
+        if (Verbose) cout << "Found a start action " << *io << "\n";
         atype = START;
         tl = s.substr(0, s.length() - 6);
         dur = dursFor.lookUp(tl, io);
@@ -668,37 +881,149 @@ bool PlanGraph::extendPlanGraph() {
     };
 
     bool levelOut = true;
-    for (InstOps::iterator i = inactive.begin(); i != inactive.end();) {
-        cout << "Considering: " << **i << "\n";
-        if (activated((*i))) {
-            ActEntry *io = acts.addEntry(myFac->makeActEntry((*i)));
-            cout << "Activated: " << (*(*i)) << "\n";
-            activateEntry(io);
-            InstOps::iterator j = i;
-
-            ++i;
-            inactive.erase(j);
-
-            levelOut = false;
-        } else
-            ++i;
-    }
+    if (counted) {
+        levelOut = extendCounted();
+    } else {
+        for (InstOps::iterator i = inactive.begin(); i != inactive.end();) {
+            if (Verbose) cout << "Considering: " << **i << "\n";
+            if (activated((*i))) {
+                ActEntry *io = acts.addEntry(myFac->makeActEntry((*i)));
+                if (Verbose) cout << "Activated: " << (*(*i)) << "\n";
+                activateEntry(io);
+                InstOps::iterator j = i;
+
+                ++i;
+                inactive.erase(j);
+
+                levelOut = false;
+            } else
+                ++i;
+        }
+    };
 
     // Determine which actions are now activated and add them to spike.
     //
     // Then add their postconditions to the proposition spike, ensuring we only
     // add new ones.
 
+    const int oldFluents = fluents.lastLevelHead();
     acts.finishedLevel();
     props.finishedLevel();
     fluents.finishedLevel();
-    for (Spike< FluentEntry >::SpikeIterator i = fluents.begin();
-            i != fluents.end(); ++i) {
-        (*i)->transferValue();
+    fluentsChanged = fluents.lastLevelHead() != oldFluents;
+    if (store.finishLevel()) fluentsChanged = true;
+    if (counted) propsVisible();
+    return levelOut;
+};
+
+// Activate the candidates that are ready at this level, in the order of the
+// operator store as a scan would. Achieving a literal already in the graph
+// makes it true at once, so candidates later in the order that it completes
+// are taken at this level and earlier ones at the next.
+bool PlanGraph::extendCounted() {
+    for (vector< int >::iterator i = ready.begin(); i != ready.end(); ++i) {
+        thisLevel.push(*i);
+    };
+    ready.clear();
+    vector< int > waiting;
+    for (vector< int >::iterator i = rechecks.begin(); i != rechecks.end();
+            ++i) {
+        if (residue[*i] == OTHER || fluentsChanged) {
+            thisLevel.push(*i);
+        } else {
+            waiting.push_back(*i);
+        };
     };
+    rechecks.swap(waiting);
+
+    bool levelOut = true;
+    while (!thisLevel.empty()) {
+        current = thisLevel.top();
+        thisLevel.pop();
+        instantiatedOp *op = candidates[current];
+        if (residue[current] != COUNTED && !activated(op)) {
+            rechecks.push_back(current);
+            continue;
+        };
+        ActEntry *io = acts.addEntry(myFac->makeActEntry(op));
+        activateEntry(io);
+        propsVisible();
+        for (instantiatedOp::PropEffectsIterator e = op->addEffectsBegin();
+                e != op->addEffectsEnd(); ++e) {
+            const unsigned int id = (*e)->getGlobalID();
+            if (id < unachieved.size() && unachieved[id] &&
+                    unachieved[id]->gotAchievers()) {
+                unachieved[id] = 0;
+                satisfy(*e);
+            };
+        };
+        levelOut = false;
+    };
+    current = -1;
     return levelOut;
 };
 
+void PlanGraph::indexCandidates() {
+    for (OpStore::iterator i = instantiatedOp::opsBegin();
+            i != instantiatedOp::opsEnd(); ++i) {
+        const int c = candidates.size();
+        PreconditionIndexer pi((*i)->getEnv());
+        (*i)->forOp()->visit(&pi);
+
+        candidates.push_back(*i);
+        // The scanning graph does not look into the conditions of durative
+        // actions, so they are left to activated() at every level here too.
+        if (pi.isDurative()) {
+            residue.push_back(OTHER);
+            unsatisfied.push_back(0);
+            ready.push_back(c);
+            continue;
+        };
+        residue.push_back(pi.getResidue());
+        unsatisfied.push_back(pi.getLiterals().size());
+        for (vector< Literal * >::const_iterator l = pi.getLiterals().begin();
+                l != pi.getLiterals().end(); ++l) {
+            const unsigned int id = (*l)->getGlobalID();
+            if (id >= consumers.size()) consumers.resize(id + 1);
+            consumers[id].push_back(c);
+        };
+        if (!unsatisfied[c] && residue[c] != NEVER) ready.push_back(c);
+    };
+};
+
+// Take note of the propositions that have become visible to the evaluation
+// of preconditions: those of a finished level and the absentees inserted
+// into one.
+void PlanGraph::propsVisible() {
+    for (; visibleProps < props.lastLevelHead(); ++visibleProps) {
+        PropEntry *pe = *(props.begin() + visibleProps);
+        if (pe->gotAchievers()) {
+            satisfy(pe->getLiteral());
+        } else {
+            const unsigned int id = pe->getLiteral()->getGlobalID();
+            if (id >= unachieved.size()) unachieved.resize(id + 1, 0);
+            unachieved[id] = pe;
+        };
+    };
+};
+
+void PlanGraph::satisfy(const Literal *lit) {
+    const unsigned int id = lit->getGlobalID();
+    if (id >= satisfied.size()) satisfied.resize(id + 1, false);
+    if (satisfied[id]) return;
+    satisfied[id] = true;
+    if (id >= consumers.size()) return;
+    for (vector< int >::const_iterator c = consumers[id].begin();
+            c != consumers[id].end(); ++c) {
+        if (--unsatisfied[*c] || residue[*c] == NEVER) continue;
+        if (current >= 0 && *c > current) {
+            thisLevel.push(*c);
+        } else {
+            ready.push_back(*c);
+        };
+    };
+};
+
 void PlanGraph::extendToGoals() {
     VAL::FastEnvironment bs(0);
     while (true) {
@@ -713,23 +1038,32 @@ void PlanGraph::iterateEntry(ActEntry *io) {
     for (instantiatedOp::PNEEffectsIterator e = io->getIO()->PNEEffectsBegin();
             e != io->getIO()->PNEEffectsEnd(); ++e) {
         FluentEntry *eid = fluents.find((*e));
-        cout << "Fluent effect updated: " << (*(*e)) << "\n";
+        if (Verbose) cout << "Fluent effect updated: " << (*(*e)) << "\n";
         if (!eid) {
-            eid = fluents.addEntry(myFac->makeFluentEntry((*e)));
+            eid = addFluent(*e);
         };
 
-        eid->addUpdatedBy(io, e.getUpdate(), e.getOp(), this);
+        BVEvaluator bve(*this, io->getIO()->getEnv());
+        e.getUpdate()->visit(&bve);
+        store.queue(eid, io, e.getUpdate(), e.getOp(), bve.getBounds(),
+                    bve.isContinuous());
         io->addUpdates(eid);
     }
 };
 
+FluentEntry *PlanGraph::addFluent(PNE *pne) {
+    FluentEntry *fe = myFac->makeFluentEntry(pne);
+    fe->attach(&store);
+    return fluents.addEntry(fe);
+};
+
 void PlanGraph::activateEntry(ActEntry *io) {
     for (instantiatedOp::PropEffectsIterator e = io->getIO()->addEffectsBegin();
             e != io->getIO()->addEffectsEnd(); ++e) {
         PropEntry *eid = props.find((*e));
         if (!eid) {
             eid = props.addEntry(myFac->makePropEntry((*e)));
-            cout << "Prop effect added: " << (*(*e)) << "\n";
+            if (Verbose) cout << "Prop effect added: " << (*(*e)) << "\n";
         };
         eid->addAchievedBy(io);
         io->addAchieves(eid);
@@ -739,7 +1073,7 @@ void PlanGraph::activateEntry(ActEntry *io) {
         PropEntry *eid = props.find((*e));
         if (!eid) {
             eid = props.addEntry(myFac->makePropEntry((*e)));
-            cout << "Prop effect deleted: " << (*(*e)) << "\n";
+            if (Verbose) cout << "Prop effect deleted: " << (*(*e)) << "\n";
         }
         eid->addDeletedBy(io);
         io->addDeletes(eid);
@@ -875,4 +1209,501 @@ vector< ActEntry * > PlanGraph::relevantActions(Validator *v,
 
     return actives;
 };
+CompactPlanGraph::CompactPlanGraph() {
+    unsigned int numFacts = instantiatedOp::howManyLiteralsOfAnySort();
+    preStart.push_back(0);
+    addStart.push_back(0);
+    for (OpStore::iterator i = instantiatedOp::opsBegin();
+            i != instantiatedOp::opsEnd(); ++i) {
+        PreconditionIndexer pi((*i)->getEnv());
+        (*i)->forOp()->visit(&pi);
+        if (pi.getResidue() == PlanGraph::NEVER) continue;
+
+        if (pi.getLiterals().empty()) unconditional.push_back(ops.size());
+        ops.push_back(*i);
+        for (vector< Literal * >::const_iterator l = pi.getLiterals().begin();
+                l != pi.getLiterals().end(); ++l) {
+            pres.push_back((*l)->getGlobalID());
+            numFacts = std::max(numFacts, pres.back() + 1);
+        };
+        preStart.push_back(pres.size());
+        for (instantiatedOp::PropEffectsIterator e = (*i)->addEffectsBegin();
+                e != (*i)->addEffectsEnd(); ++e) {
+            adds.push_back((*e)->getGlobalID());
+            numFacts = std::max(numFacts, adds.back() + 1);
+        };
+        addStart.push_back(adds.size());
+    };
+
+    // Count the consumers of each literal, then place them.
+    consumerStart.assign(numFacts + 1, 0);
+    for (vector< unsigned int >::const_iterator p = pres.begin();
+            p != pres.end(); ++p) {
+        ++consumerStart[*p + 1];
+    };
+    for (unsigned int f = 0; f < numFacts; ++f) {
+        consumerStart[f + 1] += consumerStart[f];
+    };
+    consumers.resize(pres.size());
+    vector< unsigned int > placed(consumerStart.begin(), consumerStart.end() - 1);
+    for (unsigned int op = 0; op < ops.size(); ++op) {
+        for (iterator p = presBegin(op); p != presEnd(op); ++p) {
+            consumers[placed[*p]++] = op;
+        };
+    };
+
+    unsatisfied.resize(ops.size());
+    facts.resize(numFacts);
+    acts.resize(ops.size());
+};
+
+void CompactPlanGraph::build(const vector< unsigned int > &initial) {
+    facts.clear();
+    acts.clear();
+    for (unsigned int op = 0; op < ops.size(); ++op) {
+        unsatisfied[op] = preStart[op + 1] - preStart[op];
+    };
+
+    for (vector< unsigned int >::const_iterator f = initial.begin();
+            f != initial.end(); ++f) {
+        if (*f < facts.size()) facts.add(*f);
+    };
+    for (vector< unsigned int >::const_iterator op = unconditional.begin();
+            op != unconditional.end(); ++op) {
+        acts.add(*op);
+    };
+
+    // The operators of a level are those the literals of the level complete,
+    // and their add effects make the next level. Each new literal decrements
+    // the counts of its consumers, rather than each level ANDing every
+    // operator's precondition mask against the literal bits: a level adds few
+    // literals and each has few consumers, so this touches only the operators
+    // that might change, where the masks would be scanned in full every level.
+    // The bitsets still make copying a level to the next, and membership, a
+    // matter of words.
+    for (int l = 0;; ++l) {
+        for (BitSpike::iterator f = facts.begin(l); f != facts.end(l); ++f) {
+            for (unsigned int c = consumerStart[*f]; c != consumerStart[*f + 1];
+                    ++c) {
+                if (!--unsatisfied[consumers[c]]) acts.add(consumers[c]);
+            };
+        };
+        facts.finishedLevel();
+        acts.finishedLevel();
+
+        bool grown = false;
+        for (BitSpike::iterator op = acts.begin(l); op != acts.end(l); ++op) {
+            for (iterator a = addsBegin(*op); a != addsEnd(*op); ++a) {
+                if (facts.add(*a)) grown = true;
+            };
+        };
+        if (!grown) break;
+    };
+};
+
+// Looking up the literals of a State may create them, so search should keep
+// its states as literal IDs and use the other form.
+void CompactPlanGraph::build(const VAL::State *s) {
+    stateFacts.clear();
+    for (State::const_iterator i = s->begin(); i != s->end(); ++i) {
+        stateFacts.push_back(toLiteral(*i)->getGlobalID());
+    };
+    build(stateFacts);
+};
+
+RelaxedPlanHeuristic::RelaxedPlanHeuristic(CompactPlanGraph &g)
+    : graph(g), reachable(true) {
+    const unsigned int numFacts = graph.getFacts().size();
+    if (current_analysis->the_problem->the_goal) {
+        FastEnvironment bs(0);
+        PreconditionIndexer pi(&bs);
+        current_analysis->the_problem->the_goal->visit(&pi);
+        // A goal literal that was never made leaves the goal NEVER. One the
+        // graph has no ID for is neither in the initial state nor added by
+        // any operator. Either way no state can hold it.
+        reachable = pi.getResidue() != PlanGraph::NEVER;
+        for (vector< Literal * >::const_iterator l = pi.getLiterals().begin();
+                l != pi.getLiterals().end(); ++l) {
+            if (static_cast< unsigned int >((*l)->getGlobalID()) >= numFacts) {
+                reachable = false;
+            } else {
+                goals.push_back((*l)->getGlobalID());
+            };
+        };
+    };
+
+    // Count the achievers of each literal, then place them.
+    achieverStart.assign(numFacts + 1, 0);
+    for (unsigned int op = 0; op < graph.numOps(); ++op) {
+        for (CompactPlanGraph::iterator a = graph.addsBegin(op);
+                a != graph.addsEnd(op); ++a) {
+            ++achieverStart[*a + 1];
+        };
+    };
+    for (unsigned int f = 0; f < numFacts; ++f) {
+        achieverStart[f + 1] += achieverStart[f];
+    };
+    achievers.resize(achieverStart[numFacts]);
+    vector< unsigned int > placed(achieverStart.begin(), achieverStart.end() - 1);
+    for (unsigned int op = 0; op < graph.numOps(); ++op) {
+        for (CompactPlanGraph::iterator a = graph.addsBegin(op);
+                a != graph.addsEnd(op); ++a) {
+            achievers[placed[*a]++] = op;
+        };
+    };
+
+    factCost.assign(numFacts, std::numeric_limits< int >::max());
+    opCost.assign(graph.numOps(), 0);
+    opUnsatisfied.resize(graph.numOps());
+    for (unsigned int op = 0; op < graph.numOps(); ++op) {
+        opUnsatisfied[op] = graph.presEnd(op) - graph.presBegin(op);
+    };
+    isGoal.assign(numFacts, false);
+    markedAt.assign(numFacts, std::numeric_limits< int >::max());
+    isHelpful.assign(graph.numOps(), false);
+};
+
+int RelaxedPlanHeuristic::evaluate(const vector< unsigned int > &state,
+                                   Measure m) {
+    graph.build(state);
+    return evaluate(m);
+};
+
+int RelaxedPlanHeuristic::evaluate(const VAL::State *s, Measure m) {
+    graph.build(s);
+    return evaluate(m);
+};
+
+int RelaxedPlanHeuristic::evaluate(Measure m) {
+    plan.clear();
+    helpful.clear();
+    if (!reachable) return deadEnd;
+    for (vector< unsigned int >::const_iterator g = goals.begin();
+            g != goals.end(); ++g) {
+        if (!graph.getFacts().contains(*g)) return deadEnd;
+    };
+    switch (m) {
+    case HMAX:
+        return hMax();
+    case HADD:
+        return hAdd();
+    default:
+        return relaxedPlan();
+    };
+};
+
+// With unit costs, h_max is the level at which the last goal first appears.
+int RelaxedPlanHeuristic::hMax() const {
+    int h = 0;
+    for (vector< unsigned int >::const_iterator g = goals.begin();
+            g != goals.end(); ++g) {
+        h = std::max(h, graph.getFacts().getWhen(*g));
+    };
+    return h;
+};
+
+void RelaxedPlanHeuristic::achieve(unsigned int op, int cost) {
+    for (CompactPlanGraph::iterator a = graph.addsBegin(op);
+            a != graph.addsEnd(op); ++a) {
+        if (cost < factCost[*a]) {
+            factCost[*a] = cost;
+            heap.push_back(std::make_pair(cost, *a));
+            std::push_heap(heap.begin(), heap.end(),
+                           std::greater< std::pair< int, unsigned int > >());
+        };
+    };
+};
+
+// Literals are settled in order of cost, so an operator's cost is final when
+// its last precondition is settled. The literals and operators the search
+// touched are then reset for the next evaluation.
+int RelaxedPlanHeuristic::hAdd() {
+    const BitSpike &facts = graph.getFacts();
+    const BitSpike &acts = graph.getActs();
+    heap.clear();
+    for (BitSpike::iterator f = facts.begin(0); f != facts.end(0); ++f) {
+        factCost[*f] = 0;
+        heap.push_back(std::make_pair(0, *f));
+    };
+    for (BitSpike::iterator op = acts.begin(0); op != acts.end(0); ++op) {
+        if (graph.presBegin(*op) == graph.presEnd(*op)) achieve(*op, 1);
+    };
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(),
+                      std::greater< std::pair< int, unsigned int > >());
+        const int cost = heap.back().first;
+        const unsigned int f = heap.back().second;
+        heap.pop_back();
+        if (cost > factCost[f]) continue;
+        for (CompactPlanGraph::iterator op = graph.consumersBegin(f);
+                op != graph.consumersEnd(f); ++op) {
+            opCost[*op] += cost;
+            if (!--opUnsatisfied[*op]) achieve(*op, opCost[*op] + 1);
+        };
+    };
+
+    int h = 0;
+    for (vector< unsigned int >::const_iterator g = goals.begin();
+            g != goals.end(); ++g) {
+        h += factCost[*g];
+    };
+
+    for (BitSpike::iterator f = facts.begin(0); f != facts.end(facts.numLevels());
+            ++f) {
+        factCost[*f] = std::numeric_limits< int >::max();
+        for (CompactPlanGraph::iterator op = graph.consumersBegin(*f);
+                op != graph.consumersEnd(*f); ++op) {
+            opCost[*op] = 0;
+            opUnsatisfied[*op] = graph.presEnd(*op) - graph.presBegin(*op);
+        };
+    };
+    return h;
+};
+
+// FF's extraction: each goal is achieved by an operator from the level
+// before the one it first appears at, choosing the one whose preconditions
+// appear earliest, and those preconditions become goals at their own levels.
+// The operator chosen for a goal at level l also achieves the goals it adds
+// at l and at l - 1, which need no achiever of their own.
+int RelaxedPlanHeuristic::relaxedPlan() {
+    const BitSpike &facts = graph.getFacts();
+    const BitSpike &acts = graph.getActs();
+    if (levelGoals.size() < static_cast< size_t >(facts.numLevels())) {
+        levelGoals.resize(facts.numLevels());
+    };
+    int top = 0;
+    for (vector< unsigned int >::const_iterator g = goals.begin();
+            g != goals.end(); ++g) {
+        const int l = facts.getWhen(*g);
+        if (l && !isGoal[*g]) {
+            isGoal[*g] = true;
+            levelGoals[l].push_back(*g);
+            top = std::max(top, l);
+        };
+    };
+
+    for (int l = top; l > 0; --l) {
+        for (size_t i = 0; i < levelGoals[l].size(); ++i) {
+            const unsigned int g = levelGoals[l][i];
+            if (markedAt[g] <= l) continue;
+            unsigned int best = 0;
+            int difficulty = std::numeric_limits< int >::max();
+            for (unsigned int a = achieverStart[g]; a != achieverStart[g + 1];
+                    ++a) {
+                const unsigned int op = achievers[a];
+                if (acts.getWhen(op) != l - 1) continue;
+                int d = 0;
+                for (CompactPlanGraph::iterator p = graph.presBegin(op);
+                        p != graph.presEnd(op); ++p) {
+                    d += facts.getWhen(*p);
+                };
+                if (d < difficulty) {
+                    best = op;
+                    difficulty = d;
+                };
+            };
+
+            plan.push_back(best);
+            for (CompactPlanGraph::iterator p = graph.presBegin(best);
+                    p != graph.presEnd(best); ++p) {
+                if (!isGoal[*p] && facts.getWhen(*p)) {
+                    isGoal[*p] = true;
+                    levelGoals[facts.getWhen(*p)].push_back(*p);
+                };
+            };
+            for (CompactPlanGraph::iterator a = graph.addsBegin(best);
+                    a != graph.addsEnd(best); ++a) {
+                markedAt[*a] = std::min(markedAt[*a], l - 1);
+            };
+        };
+    };
+
+    if (top) {
+        for (vector< unsigned int >::const_iterator g = levelGoals[1].begin();
+                g != levelGoals[1].end(); ++g) {
+            for (unsigned int a = achieverStart[*g]; a != achieverStart[*g + 1];
+                    ++a) {
+                const unsigned int op = achievers[a];
+                if (acts.getWhen(op) == 0 && !isHelpful[op]) {
+                    isHelpful[op] = true;
+                    helpful.push_back(op);
+                };
+            };
+        };
+    };
+
+    for (vector< unsigned int >::const_iterator op = helpful.begin();
+            op != helpful.end(); ++op) {
+        isHelpful[*op] = false;
+    };
+    for (int l = 1; l <= top; ++l) {
+        for (vector< unsigned int >::const_iterator g = levelGoals[l].begin();
+                g != levelGoals[l].end(); ++g) {
+            isGoal[*g] = false;
+        };
+        levelGoals[l].clear();
+    };
+    for (vector< unsigned int >::const_iterator op = plan.begin();
+            op != plan.end(); ++op) {
+        for (CompactPlanGraph::iterator a = graph.addsBegin(*op);
+                a != graph.addsEnd(*op); ++a) {
+            markedAt[*a] = std::numeric_limits< int >::max();
+        };
+    };
+    return plan.size();
+};
+
+namespace {
+
+// Orders operators by their sorted conditions, lexicographically.
+struct ConditionOrder {
+    const vector< unsigned int > &start;
+    const vector< unsigned int > &conds;
+
+    ConditionOrder(const vector< unsigned int > &s,
+                   const vector< unsigned int > &c)
+        : start(s), conds(c) {};
+    bool operator()(unsigned int a, unsigned int b) const {
+        return std::lexicographical_compare(
+                   conds.begin() + start[a], conds.begin() + start[a + 1],
+                   conds.begin() + start[b], conds.begin() + start[b + 1]);
+    };
+};
+
+};  // namespace
+
+SuccessorGenerator::SuccessorGenerator() {
+    condStart.push_back(0);
+    for (OpStore::iterator i = instantiatedOp::opsBegin();
+            i != instantiatedOp::opsEnd(); ++i) {
+        PreconditionIndexer pi((*i)->getEnv());
+        (*i)->forOp()->visit(&pi);
+        if (pi.getResidue() == PlanGraph::NEVER) continue;
+
+        const unsigned int first = conds.size();
+        for (vector< Literal * >::const_iterator l = pi.getLiterals().begin();
+                l != pi.getLiterals().end(); ++l) {
+            conds.push_back(2 * (*l)->getGlobalID() + 1);
+        };
+        for (vector< Literal * >::const_iterator l =
+                    pi.getNegativeLiterals().begin();
+                l != pi.getNegativeLiterals().end(); ++l) {
+            conds.push_back(2 * (*l)->getGlobalID());
+        };
+        std::sort(conds.begin() + first, conds.end());
+        // An operator needing a literal both true and false never applies.
+        bool contradictory = false;
+        for (unsigned int c = first + 1; c < conds.size(); ++c) {
+            if (conds[c] / 2 == conds[c - 1] / 2) contradictory = true;
+        };
+        if (contradictory) {
+            conds.resize(first);
+            continue;
+        };
+
+        ops.push_back(*i);
+        decided.push_back(pi.literalsOnly());
+        condStart.push_back(conds.size());
+    };
+
+    for (unsigned int op = 0; op < ops.size(); ++op) {
+        sorted.push_back(op);
+    };
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     ConditionOrder(condStart, conds));
+    build(0, sorted.size(), 0);
+};
+
+// Build the chain of nodes for the operators sorted[begin] to sorted[end - 1],
+// which share their first depth conditions, returning the first node of the
+// chain, or -1 if there are no operators.
+int SuccessorGenerator::build(unsigned int begin, unsigned int end,
+                              unsigned int depth) {
+    if (begin == end) return -1;
+    const int first = nodes.size();
+    int previous = -1;
+    while (begin != end) {
+        const int n = nodes.size();
+        const Node empty = {0, -1, -1, -1, begin, begin};
+        nodes.push_back(empty);
+        if (previous >= 0) nodes[previous].dontCare = n;
+
+        while (begin != end &&
+                condStart[sorted[begin] + 1] - condStart[sorted[begin]] == depth) {
+            ++begin;
+        };
+        nodes[n].opsEnd = begin;
+        if (begin == end) break;
+
+        // The rest are sorted by their next condition, which is on the
+        // literal of the first of them or one after it.
+        const unsigned int literal = conds[condStart[sorted[begin]] + depth] / 2;
+        unsigned int whenTrue = begin;
+        while (whenTrue != end &&
+                conds[condStart[sorted[whenTrue]] + depth] == 2 * literal) {
+            ++whenTrue;
+        };
+        unsigned int dontCare = whenTrue;
+        while (dontCare != end &&
+                conds[condStart[sorted[dontCare]] + depth] == 2 * literal + 1) {
+            ++dontCare;
+        };
+        const int f = build(begin, whenTrue, depth + 1);
+        const int t = build(whenTrue, dontCare, depth + 1);
+        nodes[n].literal = literal;
+        nodes[n].whenFalse = f;
+        nodes[n].whenTrue = t;
+        previous = n;
+        begin = dontCare;
+    };
+    return first;
+};
+
+void SuccessorGenerator::applicable(const vector< Word > &state,
+                                    vector< unsigned int > &result) {
+    result.clear();
+    if (nodes.empty()) return;
+    stack.clear();
+    stack.push_back(0);
+    while (!stack.empty()) {
+        int n = stack.back();
+        stack.pop_back();
+        for (; n >= 0; n = nodes[n].dontCare) {
+            const Node &node = nodes[n];
+            result.insert(result.end(), sorted.begin() + node.opsBegin,
+                          sorted.begin() + node.opsEnd);
+            const unsigned int w = node.literal / wordBits;
+            const int next =
+                w < state.size() && ((state[w] >> (node.literal % wordBits)) & 1)
+                ? node.whenTrue
+                : node.whenFalse;
+            if (next >= 0) stack.push_back(next);
+        };
+    };
+};
+
+// Looking up the literals of a State may create them, so search should keep
+// its states packed and use the other form.
+void SuccessorGenerator::applicable(Validator *v, const State *s,
+                                    vector< instantiatedOp * > &result) {
+    packed.clear();
+    for (State::const_iterator i = s->begin(); i != s->end(); ++i) {
+        const unsigned int id = toLiteral(*i)->getGlobalID();
+        if (id / wordBits >= packed.size()) packed.resize(id / wordBits + 1, 0);
+        packed[id / wordBits] |= Word(1) << (id % wordBits);
+    };
+    applicable(packed, found);
+
+    result.clear();
+    for (vector< unsigned int >::const_iterator op = found.begin();
+            op != found.end(); ++op) {
+        if (!decided[*op]) {
+            Evaluator ev(v, s, ops[*op]);
+            ops[*op]->forOp()->visit(&ev);
+            if (!ev()) continue;
+        };
+        result.push_back(ops[*op]);
+    };
+};
+
 };  // namespace Inst
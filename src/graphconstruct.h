@@ -6,7 +6,11 @@
 
 #include "instantiation.h"
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <queue>
 #include <vector>
 
 using std::ostream;
@@ -152,6 +156,9 @@ public:
     bool represents(const Literal *lit) const {
         return theprop == lit;
     };
+    Literal *getLiteral() const {
+        return theprop;
+    };
     void setInitiallyFalse() {
         initiallyTrue = false;
     };
@@ -496,35 +503,155 @@ inline ostream &operator<<(ostream &o, const Constraint &b) {
     return o;
 };
 
+// The bounds of a value as plain data: a point or an interval, whose ends
+// are infinite where it is unbounded, or undefined (taken as 0 by the
+// arithmetic, as Undefined is).
+struct Bounds {
+    enum Kind { UNDEFINED, POINT, INTERVAL };
+
+    Kind kind;
+    double lo;
+    double hi;
+
+    static Bounds undefined() {
+        const Bounds b = {UNDEFINED, 0, 0};
+        return b;
+    };
+    static Bounds point(double d) {
+        const Bounds b = {POINT, d, d};
+        return b;
+    };
+
+    bool gotLB() const {
+        return lo != -std::numeric_limits< double >::infinity();
+    };
+    bool gotUB() const {
+        return hi != std::numeric_limits< double >::infinity();
+    };
+
+    // The arithmetic of the BoundedValue classes.
+    Bounds operator+(const Bounds &b) const;
+    Bounds operator-(const Bounds &b) const;
+    Bounds operator*(const Bounds &b) const;
+    Bounds operator/(const Bounds &b) const;
+    Bounds operator-() const;
+    Bounds infUpper() const;
+    Bounds infLower() const;
+    bool contains(double d) const;
+    Bounds accum(const Bounds &b) const;
+
+    // The BoundedValue for these bounds, to write or keep.
+    BoundedValue *toBoundedValue() const;
+};
+
+ostream &operator<<(ostream &o, const Bounds &b);
+
+// The bounds of the fluents of a PlanGraph, held as a structure of arrays
+// with a slot for each FluentEntry. The updates made at a level are queued
+// with their right-hand sides already evaluated, and are applied together
+// when the level is finished: each updated slot takes the hull of its old
+// value and the values it is updated to.
+class FluentStore {
+private:
+    struct Update {
+        unsigned int slot;
+        VAL::assign_op op;
+        bool continuous;
+        Bounds rhs;
+        FluentEntry *fluent;
+        ActEntry *updater;
+        const VAL::expression *exp;
+    };
+
+    vector< char > kind;
+    vector< double > lo;
+    vector< double > hi;
+
+    vector< char > nextKind;
+    vector< double > nextLo;
+    vector< double > nextHi;
+    vector< char > touched;
+    vector< unsigned int > touchedSlots;
+
+    vector< Update > batch;
+
+public:
+    unsigned int add() {
+        kind.push_back(Bounds::UNDEFINED);
+        lo.push_back(0);
+        hi.push_back(0);
+        nextKind.push_back(Bounds::UNDEFINED);
+        nextLo.push_back(0);
+        nextHi.push_back(0);
+        touched.push_back(false);
+        return kind.size() - 1;
+    };
+    Bounds get(unsigned int i) const {
+        const Bounds b = {static_cast< Bounds::Kind >(kind[i]), lo[i], hi[i]};
+        return b;
+    };
+    void set(unsigned int i, const Bounds &b) {
+        kind[i] = b.kind;
+        lo[i] = b.lo;
+        hi[i] = b.hi;
+    };
+
+    static Bounds update(const Bounds &bv, const Bounds &b, bool continuous,
+                         VAL::assign_op op);
+
+    void queue(FluentEntry *fe, ActEntry *ae, const VAL::expression *exp,
+               VAL::assign_op op, const Bounds &rhs, bool continuous);
+    // Apply the queued updates, reporting whether any bounds have changed.
+    bool finishLevel();
+};
+
 class FluentEntry : public SpikeEntry {
 private:
+    // An update made to the fluent while the graph grew. These are kept as
+    // plain bounds and only turned into UpdateValue constraints when the
+    // entry is written.
+    struct Update {
+        ActEntry *updater;
+        const VAL::expression *exp;
+        VAL::assign_op op;
+        Bounds value;
+    };
+
     vector< Constraint * > constrs;
+    vector< Update > updates;
     PNE *thefluent;
 
-    BoundedValue *bval;
-    BoundedValue *tmpaccum;
+    FluentStore *store;
+    unsigned int slot;
 
 public:
-    FluentEntry(PNE *pne)
-        : thefluent(pne), bval(new Undefined()), tmpaccum(0) {};
+    FluentEntry(PNE *pne) : thefluent(pne), store(0), slot(0) {};
+    void attach(FluentStore *s) {
+        store = s;
+        slot = s->add();
+    };
     void addInitial(double d) {
-        delete bval;
-        bval = new PointValue(d);
-        constrs.push_back(new InitialValue(bval->copy()));
+        store->set(slot, Bounds::point(d));
+        constrs.push_back(new InitialValue(new PointValue(d)));
+    };
+    void addConstraint(Constraint *c) {
+        constrs.push_back(c);
+    };
+    void addUpdate(ActEntry *ae, const VAL::expression *e, VAL::assign_op op,
+                   const Bounds &b) {
+        const Update u = {ae, e, op, b};
+        updates.push_back(u);
     };
-    void addUpdatedBy(ActEntry *ae, const VAL::expression *expr,
-                      const VAL::assign_op op, PlanGraph *pg);
     void write(ostream &o) const;
-    BoundedValue *getBV() const {
-        return bval;
+    Bounds getBounds() const {
+        return store->get(slot);
+    };
+    unsigned int getSlot() const {
+        return slot;
     };
     bool represents(const PNE *pne) const {
         return pne == thefluent;
     };
-    ~FluentEntry() {
-        delete bval;
-    };
-    void transferValue();
 };
 
 class GraphFactory {
@@ -542,12 +669,19 @@ public:
 };
 
 class PlanGraph {
+public:
+    // What is left of a precondition once the positive literals of its
+    // top-level conjunction are counted: nothing, comparisons, other
+    // conditions, or an equality that can never hold.
+    enum Residue { COUNTED, NUMERIC, OTHER, NEVER };
+
 private:
     GraphFactory *myFac;
 
     Spike< PropEntry > props;
     Spike< ActEntry > acts;
     Spike< FluentEntry > fluents;
+    FluentStore store;
 
     // Use a list of candidates and filter them
     list< instantiatedOp * > inactive;
@@ -555,11 +689,41 @@ private:
 
     vector< ActEntry * > iteratingActs;
 
+    // Event-driven construction. Each candidate counts the positive literals
+    // of its precondition that are not yet in the graph, and is found from
+    // those literals through consumers, so that it is only looked at once the
+    // count reaches zero. Conditions that cannot be counted are left to
+    // activated(): numeric ones are checked again only when a fluent's bounds
+    // have changed, the others at every level.
+    bool counted;
+    vector< instantiatedOp * > candidates;
+    vector< Residue > residue;
+    vector< int > unsatisfied;
+    vector< vector< int > > consumers;  // by literal
+    vector< bool > satisfied;           // by literal
+    vector< PropEntry * > unachieved;
+    int visibleProps;
+    vector< int > ready;
+    vector< int > rechecks;
+    bool fluentsChanged;
+    std::priority_queue< int, vector< int >, std::greater< int > > thisLevel;
+    int current;
+
+    FluentEntry *addFluent(PNE *pne);
+
+    void indexCandidates();
+    void propsVisible();
+    void satisfy(const Literal *lit);
+    bool extendCounted();
+
 public:
     class BVEvaluator;
     friend class BVEvaluator;
 
-    PlanGraph(GraphFactory *gf);  // Constructor can set up initial state.
+    // Constructor can set up initial state. A counted graph is built
+    // event-driven rather than by scanning every inactive action at every
+    // level; the graphs are the same.
+    PlanGraph(GraphFactory *gf, bool c = false);
     ~PlanGraph() {
         delete myFac;
     };
@@ -571,8 +735,6 @@ public:
     void activateEntry(ActEntry *);
     void iterateEntry(ActEntry *);
 
-    BoundedValue *update(BoundedValue *bv, const VAL::expression *exp,
-                         const VAL::assign_op op, VAL::FastEnvironment *fenv);
 
     vector< ActEntry * > applicableActions(VAL::Validator *v,
                                            const VAL::State *s);
@@ -585,6 +747,306 @@ inline ostream &operator<<(ostream &o, const PlanGraph &pg) {
     return o;
 };
 
+// The levels of a spike held compactly over dense IDs: for each level, a
+// bitset of the IDs that have appeared by then, and for each ID the level at
+// which it first appeared. The bitset of a level starts as a word-by-word
+// copy of the one before. Clearing keeps the storage, so a spike can be
+// filled again and again without allocating once it has grown to size.
+class BitSpike {
+public:
+    typedef unsigned long long Word;
+    static const unsigned int wordBits = 64;
+
+private:
+    unsigned int ids;
+    unsigned int words;
+    // Level l occupies bits[l * words] to bits[(l + 1) * words - 1]; the
+    // level being built follows the finished ones.
+    vector< Word > bits;
+    vector< int > firstLevel;
+    vector< unsigned int > entries;  // in the order they were added
+    vector< unsigned int > levelheads;
+
+public:
+    BitSpike() : ids(0), words(0) {};
+
+    // Size the spike for IDs below n, and empty it.
+    void resize(unsigned int n) {
+        ids = n;
+        words = (n + wordBits - 1) / wordBits;
+        firstLevel.assign(n, -1);
+        entries.clear();
+        levelheads.clear();
+        bits.assign(words, 0);
+    };
+    void clear() {
+        for (vector< unsigned int >::const_iterator i = entries.begin();
+                i != entries.end(); ++i) {
+            firstLevel[*i] = -1;
+        };
+        entries.clear();
+        levelheads.clear();
+        std::fill(bits.begin(), bits.begin() + words, 0);
+    };
+
+    // Add id to the level being built, unless it is already in the spike.
+    bool add(unsigned int id) {
+        if (firstLevel[id] >= 0) return false;
+        firstLevel[id] = levelheads.size();
+        entries.push_back(id);
+        bits[levelheads.size() * words + id / wordBits] |= Word(1)
+                << (id % wordBits);
+        return true;
+    };
+    void finishedLevel() {
+        levelheads.push_back(entries.size());
+        const size_t from = (levelheads.size() - 1) * words;
+        if (bits.size() < from + 2 * words) bits.resize(from + 2 * words);
+        std::copy(bits.begin() + from, bits.begin() + from + words,
+                  bits.begin() + from + words);
+    };
+
+    unsigned int size() const {
+        return ids;
+    };
+    int numLevels() const {
+        return levelheads.size();
+    };
+    // The level at which id first appeared, or -1 if it has not.
+    int getWhen(unsigned int id) const {
+        return firstLevel[id];
+    };
+    bool contains(unsigned int id) const {
+        return firstLevel[id] >= 0;
+    };
+    bool containsAt(unsigned int id, int l) const {
+        return (bits[l * words + id / wordBits] >> (id % wordBits)) & 1;
+    };
+    // The bitset of level l, of numWords() words.
+    const Word *level(int l) const {
+        return &bits[l * words];
+    };
+    unsigned int numWords() const {
+        return words;
+    };
+
+    // The IDs that first appeared at level l, in the order they were added.
+    typedef vector< unsigned int >::const_iterator iterator;
+    iterator begin(int l) const {
+        return entries.begin() + (l ? levelheads[l - 1] : 0);
+    };
+    iterator end(int l) const {
+        return l < numLevels() ? entries.begin() + levelheads[l]
+               : entries.end();
+    };
+};
+
+// A relaxed planning graph over the dense IDs of the ground literals and
+// operators, for evaluating many states against one grounding. The operators
+// are indexed once, from the operator store, and the graph is then built from
+// each state in turn, reusing its storage. Preconditions are relaxed to the
+// positive literals of their top-level conjunction: deletes and the residue
+// of each precondition are ignored, except that operators with an equality
+// that can never hold are left out.
+class CompactPlanGraph {
+private:
+    vector< instantiatedOp * > ops;
+
+    // The preconditions, add effects and consumers of each operator or
+    // literal i run from Start[i] to Start[i + 1].
+    vector< unsigned int > preStart;
+    vector< unsigned int > pres;
+    vector< unsigned int > addStart;
+    vector< unsigned int > adds;
+    vector< unsigned int > consumerStart;
+    vector< unsigned int > consumers;
+
+    vector< unsigned int > unconditional;
+    vector< unsigned int > unsatisfied;
+    vector< unsigned int > stateFacts;
+
+    BitSpike facts;
+    BitSpike acts;
+
+public:
+    CompactPlanGraph();
+
+    // Build the graph to its fixpoint from the given literals. Literals that
+    // no operator mentions make no difference, and are ignored if the index
+    // has never seen them.
+    void build(const vector< unsigned int > &initial);
+    void build(const VAL::State *s);
+
+    const BitSpike &getFacts() const {
+        return facts;
+    };
+    const BitSpike &getActs() const {
+        return acts;
+    };
+
+    unsigned int numOps() const {
+        return ops.size();
+    };
+    instantiatedOp *getOp(unsigned int op) const {
+        return ops[op];
+    };
+    typedef vector< unsigned int >::const_iterator iterator;
+    iterator presBegin(unsigned int op) const {
+        return pres.begin() + preStart[op];
+    };
+    iterator presEnd(unsigned int op) const {
+        return pres.begin() + preStart[op + 1];
+    };
+    iterator addsBegin(unsigned int op) const {
+        return adds.begin() + addStart[op];
+    };
+    iterator addsEnd(unsigned int op) const {
+        return adds.begin() + addStart[op + 1];
+    };
+    iterator consumersBegin(unsigned int fact) const {
+        return consumers.begin() + consumerStart[fact];
+    };
+    iterator consumersEnd(unsigned int fact) const {
+        return consumers.begin() + consumerStart[fact + 1];
+    };
+};
+
+// Delete-relaxation heuristics for the goal of the problem, evaluated over a
+// CompactPlanGraph built from each state in turn. Every operator costs 1, and
+// the goal, like the preconditions, is relaxed to the positive literals of
+// its top-level conjunction. The storage is kept from one evaluation to the
+// next and only the entries the graph reached are reset, so an evaluation
+// allocates nothing once the first few have sized it.
+class RelaxedPlanHeuristic {
+public:
+    enum Measure { HMAX, HADD, FF };
+
+    // The value of a state from which the goal cannot be reached.
+    static const int deadEnd = -1;
+
+private:
+    CompactPlanGraph &graph;
+
+    vector< unsigned int > goals;
+    bool reachable;
+
+    // The operators adding each literal f run from achieverStart[f] to
+    // achieverStart[f + 1].
+    vector< unsigned int > achieverStart;
+    vector< unsigned int > achievers;
+
+    // h_add, by a generalised Dijkstra search over the literals.
+    vector< int > factCost;
+    vector< int > opCost;
+    vector< unsigned int > opUnsatisfied;
+    vector< std::pair< int, unsigned int > > heap;
+
+    // FF extraction, through goals sorted by the level they first appear at.
+    vector< vector< unsigned int > > levelGoals;
+    vector< char > isGoal;
+    vector< int > markedAt;
+    vector< char > isHelpful;
+    vector< unsigned int > plan;
+    vector< unsigned int > helpful;
+
+    int evaluate(Measure m);
+    int hMax() const;
+    int hAdd();
+    void achieve(unsigned int op, int cost);
+    int relaxedPlan();
+
+public:
+    RelaxedPlanHeuristic(CompactPlanGraph &g);
+
+    // Evaluate a state, given as literal IDs or as a State, building the
+    // graph from it. The relaxed plan and helpful actions are only found for
+    // FF, and are left empty by the other measures.
+    int evaluate(const vector< unsigned int > &state, Measure m);
+    int evaluate(const VAL::State *s, Measure m);
+
+    // The operators of the last relaxed plan, as indices into the graph, in
+    // the order extraction chose them.
+    const vector< unsigned int > &getRelaxedPlan() const {
+        return plan;
+    };
+    // The operators the graph has at its first level that add a literal the
+    // last relaxed plan needs at its second, as FF's helpful actions. The
+    // relaxation means that an operator with conditions beyond its positive
+    // literals may not in fact be applicable.
+    const vector< unsigned int > &getHelpfulActions() const {
+        return helpful;
+    };
+};
+
+// The operators of the store that apply in a state, found by a decision tree
+// over the literals of their preconditions, in the manner of the successor
+// generator of Fast Downward. Each operator's conditions are the literals of
+// the top-level conjunction of its precondition, sorted by ID, and the
+// operators are sorted by their conditions, so that each node of the tree
+// holds a run of them: the ones with no conditions left, which apply, then
+// those needing its literal false, those needing it true, and those that do
+// not care, which continue to the next node. Operators with an equality that
+// can never hold are left out. Looking up a state visits only the nodes
+// whose conditions it meets, so takes time in the number of operators found
+// rather than the number in the store.
+class SuccessorGenerator {
+public:
+    typedef unsigned long long Word;
+    static const unsigned int wordBits = 64;
+
+private:
+    struct Node {
+        unsigned int literal;
+        int whenFalse;
+        int whenTrue;
+        int dontCare;
+        unsigned int opsBegin;
+        unsigned int opsEnd;
+    };
+
+    vector< instantiatedOp * > ops;
+    vector< bool > decided;
+
+    // The conditions of each operator i run from condStart[i] to
+    // condStart[i + 1], each as twice the literal's ID, plus one if the
+    // literal must be true.
+    vector< unsigned int > condStart;
+    vector< unsigned int > conds;
+
+    vector< unsigned int > sorted;
+    vector< Node > nodes;
+
+    vector< int > stack;
+    vector< Word > packed;
+    vector< unsigned int > found;
+
+    int build(unsigned int begin, unsigned int end, unsigned int depth);
+
+public:
+    SuccessorGenerator();
+
+    // The operators whose conditions a packed state meets, where bit i of
+    // the state is set if the literal with ID i is true. Literals beyond the
+    // end of the state are false.
+    void applicable(const vector< Word > &state, vector< unsigned int > &result);
+    // The operators that apply in a State, evaluating what is left of the
+    // precondition of those whose conditions it meets.
+    void applicable(VAL::Validator *v, const VAL::State *s,
+                    vector< instantiatedOp * > &result);
+
+    unsigned int numOps() const {
+        return ops.size();
+    };
+    instantiatedOp *getOp(unsigned int op) const {
+        return ops[op];
+    };
+    // Whether an operator's conditions are the whole of its precondition,
+    // so that it applies wherever they are met.
+    bool isDecided(unsigned int op) const {
+        return decided[op];
+    };
+};
+
 };  // namespace Inst
 
 #endif
@@ -2,36 +2,111 @@
 // This source code is licensed under the BSD license found in the LICENSE file in the root directory of this source tree.
 
 #include "DebugWriteController.h"
+#include "GroundedTaskCache.h"
 #include "SimpleEval.h"
 #include "TIM.h"
 #include "instantiation.h"
 #include "ptree.h"
 #include "typecheck.h"
 #include <FlexLexer.h>
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 
 using std::cerr;
 using std::ifstream;
+using std::max;
 
 using namespace TIM;
 using namespace Inst;
 using namespace VAL;
 
 int main(int argc, char *argv[]) {
-    performTIMAnalysis(&argv[1]);
+    // -J <n> grounds the operators on n threads; -C <file> loads the ground
+    // operators from a cache file, grounding them and writing it if it is
+    // missing or out of date; -R erases the operators, and the literals, that
+    // cannot be reached even when delete effects are ignored; -S writes the
+    // operators, unfiltered, each as soon as it is instantiated, followed by
+    // the counts, and cannot be used with any of the others.
+    int argcount = 1;
+    unsigned int jobs = 1;
+    string cacheFile;
+    bool pruneUnreachable = false;
+    bool streaming = false;
+    bool threaded = false;
+    while (argc > argcount + 2 && argv[argcount][0] == '-') {
+        const string option(argv[argcount]);
+        if (option == "-R") {
+            pruneUnreachable = true;
+            ++argcount;
+            continue;
+        };
+        if (option == "-S") {
+            streaming = true;
+            ++argcount;
+            continue;
+        };
+        if (argc == argcount + 3) break;
+        if (option == "-J") {
+            jobs = max(atoi(argv[argcount + 1]), 1);
+            threaded = true;
+        } else if (option == "-C") {
+            cacheFile = argv[argcount + 1];
+        } else {
+            break;
+        };
+        argcount += 2;
+    };
+
+    // Streamed operators are written one at a time, as they are made, so
+    // they are neither grounded on threads, cached nor pruned.
+    if (streaming && (threaded || !cacheFile.empty() || pruneUnreachable)) {
+        cerr << "-S cannot be used with -J, -C or -R\n";
+        return 1;
+    };
+
+    performTIMAnalysis(&argv[argcount]);
 
     SimpleEvaluator::setInitialState();
-    for (operator_list::const_iterator os =
-                current_analysis->the_domain->ops->begin();
-            os != current_analysis->the_domain->ops->end(); ++os) {
+    const operator_list *ops = current_analysis->the_domain->ops;
+    if (streaming) {
+        // Only the static preconditions are checked before an operator is
+        // written; the filter against the literals needs every operator, so
+        // the stream can hold operators that the full listing drops.
+        cout << "Unfiltered operators, as they are instantiated:\n";
+        instantiatedOp::streamTo(cout);
+        const vector< int > counts = instantiatedOp::instantiateAll(
+            ops, current_analysis->the_problem, *theTC, 1);
+        vector< int >::const_iterator count = counts.begin();
+        for (operator_list::const_iterator os = ops->begin();
+                os != ops->end(); ++os, ++count) {
+            cout << (*os)->name->getName() << "\n";
+            cout << *count << " so far\n";
+        };
+        cout << instantiatedOp::howMany() << "\n";
+        return 0;
+    };
+    const vector< int > counts =
+        cacheFile.empty()
+        ? instantiatedOp::instantiateAll(ops, current_analysis->the_problem,
+                                         *theTC, jobs)
+        : GroundedTaskCache::instantiateAll(
+            cacheFile, argv[argcount], argv[argcount + 1], ops,
+            current_analysis->the_problem, *theTC, jobs);
+    vector< int >::const_iterator count = counts.begin();
+    for (operator_list::const_iterator os = ops->begin(); os != ops->end();
+            ++os, ++count) {
         cout << (*os)->name->getName() << "\n";
-        instantiatedOp::instantiate(*os, current_analysis->the_problem, *theTC);
-        cout << instantiatedOp::howMany() << " so far\n";
+        cout << *count << " so far\n";
     };
     instantiatedOp::createAllLiterals(current_analysis->the_problem, theTC);
     instantiatedOp::filterOps(theTC);
+    if (pruneUnreachable) {
+        instantiatedOp::filterUnreachableOps(current_analysis->the_problem,
+                                             theTC);
+    };
     cout << instantiatedOp::howMany() << "\n";
     instantiatedOp::writeAll(cout);
 
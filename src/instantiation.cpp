@@ -11,9 +11,18 @@
 #include "typecheck.h"
 #include <FlexLexer.h>
 #include <assert.h>
+#include <atomic>
+#include <climits>
+#include <cmath>
 #include <cstdio>
+#include <exception>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 using std::cerr;
 using std::endl;
@@ -73,6 +82,22 @@ void instantiatedOp::writeAll(ostream &o) {
     instOps.write(o);
 };
 
+void instantiatedOp::add(instantiatedOp *o) {
+    if (!stream) {
+        if (instOps.insert(o)) {
+            delete o;
+        };
+        return;
+    };
+    bool &written = streamed.insert(o->getHead(), o->begin(), o->end(), false);
+    if (!written) {
+        written = true;
+        *stream << *o << "\n";
+        ++streamedCount;
+    };
+    delete o;
+};
+
 void instantiatedDrv::writeAll(ostream &o) {
     instDrvs.write(o);
 };
@@ -199,6 +224,10 @@ void LitStoreEvaluator::evaluateSimpleGoal(FastEnvironment *f,
 };
 
 OpStore instantiatedOp::instOps;
+ostream *instantiatedOp::stream = 0;
+AtomTable< VAL::operator_symbol, VAL::const_symbol, bool >
+instantiatedOp::streamed;
+int instantiatedOp::streamedCount = 0;
 DrvStore instantiatedDrv::instDrvs;
 
 map< VAL::pddl_type *, vector< VAL::const_symbol * > > instantiatedValues;
@@ -918,6 +947,187 @@ struct ConstSymbolLT {
 
 class PDCIterator;
 
+/**
+ * Return the type-correct values for <code>p</code>, the
+ * <code>(i+1)</code>th parameter of the action or derivation rule
+ * <code>name</code>, recording them in <code>instantiatedValues</code> the
+ * first time its type is seen.  A type error ends the program.
+ */
+template < typename T >
+static const vector< VAL::const_symbol * > &parameterValues(
+    T *p, const int &i, const string &name, VAL::TypeChecker &tc) {
+    map< VAL::pddl_type *, vector< VAL::const_symbol * > >::const_iterator v =
+        instantiatedValues.find(p->type);
+    if (v != instantiatedValues.end()) return v->second;
+
+    try {
+        return instantiatedValues[p->type] = tc.range(p);
+    } catch (const TypeException &e) {
+        cerr << "A problem has been encountered with your domain/problem "
+                "file.\n";
+        cerr << "--------------------------------------------------------"
+                "--"
+                "---\n";
+        cerr << "Unfortunately, a type error has been encountered in your "
+                "domain and problem file,\n";
+        cerr << "and the planner has to terminate.  Specifically, for "
+                "parameter "
+             << (i + 1) << "\n";
+        cerr << "of the action/derivation rule '" << name << "':\n\n\t";
+
+        Verbose = true;
+        try {
+            instantiatedValues[p->type] = tc.range(p);
+        } catch (const TypeException &f) {
+        }
+        exit(1);
+    }
+}
+
+/** Multiply sizes, giving the largest size if the product will not fit. */
+static size_t saturatingProduct(size_t a, size_t b) {
+    if (a && b > std::numeric_limits< size_t >::max() / a) {
+        return std::numeric_limits< size_t >::max();
+    }
+    return a * b;
+}
+
+/**
+ * The bindings the static preconditions of an operator join to, in the order
+ * a <code>PDCIterator</code> would visit them.  Only the rows of values for
+ * the parameters the preconditions mention are stored: the parameters they
+ * do not mention take every value left in their domains, and are combined
+ * with the rows as the bindings are visited.
+ */
+class JoinedBindings {
+private:
+    int width;
+    /** Values for the parameters the preconditions mention, width to a row
+     * and 0 for the others, in order and with no repeats. */
+    vector< VAL::const_symbol * > rows;
+    size_t rowCount;
+    /** For each parameter the preconditions do not mention, the values left
+     * in its domain; empty for the others. */
+    vector< vector< VAL::const_symbol * > > freeValues;
+    vector< bool > free;
+    /** For each parameter, the number of combinations of the values of the
+     * free parameters before it. */
+    vector< size_t > freeBelow;
+
+    /** The end of the run of rows from <code>r</code> that agree with it on
+     * parameter <code>v</code>. */
+    size_t groupEnd(int v, size_t r, size_t hi) const {
+        const VAL::const_symbol *const c = rows[r * width + v];
+        while (++r != hi && rows[r * width + v] == c) {
+        }
+        return r;
+    }
+
+public:
+    JoinedBindings() : width(0), rows(), rowCount(0) {};
+
+    /** Take the rows, and the values of the parameters that are not
+     * <code>bound</code> by them. */
+    void set(const vector< bool > &bound, vector< VAL::const_symbol * > &r,
+             vector< vector< VAL::const_symbol * > > &fv) {
+        width = bound.size();
+        rows.swap(r);
+        rowCount = width ? rows.size() / width : 0;
+        freeValues.swap(fv);
+        free.assign(width, false);
+        freeBelow.assign(width, 1);
+        for (int v = 0; v < width; ++v) {
+            free[v] = !bound[v];
+            if (v) {
+                freeBelow[v] =
+                    free[v - 1] ? saturatingProduct(freeBelow[v - 1],
+                                                    freeValues[v - 1].size())
+                    : freeBelow[v - 1];
+            }
+        }
+    }
+
+    /** The number of bindings, or the largest size if there are more. */
+    size_t size() const {
+        if (!width) return 0;
+        return saturatingProduct(
+                   rowCount, free[width - 1]
+                   ? saturatingProduct(freeBelow[width - 1],
+                                       freeValues[width - 1].size())
+                   : freeBelow[width - 1]);
+    }
+
+    /** Give the bindings at positions <code>[from,to)</code> to
+     * <code>f</code> in turn, each as an array with a value for every
+     * parameter. */
+    template < typename F >
+    void visit(size_t from, size_t to, F f) const {
+        if (from >= std::min(to, size())) return;
+
+        // For each parameter, the rows that agree with the values chosen for
+        // the later ones, and the position of its value: an index into its
+        // free values, or the first of the rows giving it that value.
+        vector< size_t > lo(width), hi(width), at(width), end(width);
+        vector< VAL::const_symbol * > binding(width);
+
+        size_t k = from;
+        size_t l = 0, h = rowCount;
+        for (int v = width - 1; v >= 0; --v) {
+            lo[v] = l;
+            hi[v] = h;
+            const size_t each = saturatingProduct(h - l, freeBelow[v]);
+            if (free[v]) {
+                at[v] = k / each;
+                k %= each;
+            } else {
+                size_t r = l;
+                size_t e = groupEnd(v, r, h);
+                for (size_t c; k >= (c = saturatingProduct(e - r, freeBelow[v]));
+                        e = groupEnd(v, r, h)) {
+                    k -= c;
+                    r = e;
+                }
+                at[v] = r;
+                end[v] = e;
+                l = r;
+                h = e;
+            }
+        }
+
+        for (size_t n = to - from;;) {
+            for (int v = 0; v < width; ++v) {
+                binding[v] =
+                    free[v] ? freeValues[v][at[v]] : rows[at[v] * width + v];
+            }
+            f(&binding[0]);
+            if (!--n) return;
+
+            // Move to the next value of the first parameter that has one,
+            // and start the parameters before it again.
+            int v = 0;
+            for (; v < width; ++v) {
+                if (free[v]) {
+                    if (++at[v] < freeValues[v].size()) break;
+                } else if ((at[v] = end[v]) < hi[v]) {
+                    end[v] = groupEnd(v, at[v], hi[v]);
+                    break;
+                }
+            }
+            if (v == width) return;
+            for (int u = v - 1; u >= 0; --u) {
+                lo[u] = free[u + 1] ? lo[u + 1] : at[u + 1];
+                hi[u] = free[u + 1] ? hi[u + 1] : end[u + 1];
+                if (free[u]) {
+                    at[u] = 0;
+                } else {
+                    at[u] = lo[u];
+                    end[u] = groupEnd(u, lo[u], hi[u]);
+                }
+            }
+        }
+    }
+};
+
 class ParameterDomainConstraints : public VAL::VisitController {
 protected:
     typedef map< const VAL::const_symbol *const, int, ConstSymbolLT > pviLookup;
@@ -1004,35 +1214,10 @@ protected:
                     p != parameters->end(); ++p, ++i) {
                 //   symbols[i] = *p;
 
-                if (instantiatedValues.find((*p)->type) == instantiatedValues.end()) {
-                    try {
-                        instantiatedValues[(*p)->type] = tc.range(*p);
-                    } catch (const TypeException &e) {
-                        cerr << "A problem has been encountered with your domain/problem "
-                                "file.\n";
-                        cerr << "--------------------------------------------------------"
-                                "--"
-                                "---\n";
-                        cerr
-                                << "Unfortunately, a type error has been encountered in your "
-                           "domain and problem file,\n";
-                        cerr << "and the planner has to terminate.  Specifically, for "
-                                "parameter "
-                             << (i + 1) << "\n";
-                        cerr << "of the action/derivation rule '" << name << "':\n\n\t";
-
-                        Verbose = true;
-                        try {
-                            instantiatedValues[(*p)->type] = tc.range(*p);
-                        } catch (const TypeException &f) {
-                        }
-                        exit(1);
-                    }
-                };
-                possibleParameterValues[i].insert(
-                    possibleParameterValues[i].end(),
-                    instantiatedValues[(*p)->type].begin(),
-                    instantiatedValues[(*p)->type].end());
+                const vector< VAL::const_symbol * > &values =
+                    parameterValues(*p, i, name, tc);
+                possibleParameterValues[i].insert(possibleParameterValues[i].end(),
+                                                  values.begin(), values.end());
                 vars[i] = *p;
             };
         }
@@ -1620,6 +1805,44 @@ public:
      * bindings
      */
     virtual PDCIterator *getIterator();
+
+    /**
+     * Obtain an iterator over the combinations of parameter bindings in which
+     * the last parameter takes one of the values at positions
+     * <code>[from,to)</code> of its domain.  The last parameter varies
+     * slowest, so iterators over consecutive ranges visit, between them, the
+     * combinations <code>getIterator()</code> would, in the same order.
+     * Iterators only read the constraints, so several can be used at once.
+     */
+    PDCIterator *getIterator(const int &from, const int &to);
+
+    /** @brief  The number of values left in the domain of the last parameter.
+     */
+    int lastParameterDomainSize() const;
+
+    /**
+     * Compute the parameter bindings that satisfy the static preconditions in
+     * the conjunctions at the root of <code>g</code>, by treating each as a
+     * relation over the facts of the initial state and joining these.  Each
+     * relation is restricted to the current parameter domains before it is
+     * joined, and the relations are joined smallest first, preferring those
+     * that share parameters with the bindings so far, each with a hash join.
+     * Parameters that no static precondition mentions take every value left
+     * in their domains.
+     *
+     * @param g  The precondition whose static facts are to be joined
+     * @param bindings  Set to the bindings, in the order a
+     * <code>PDCIterator</code> would visit them
+     * @Return <code>false</code> if <code>g</code> has no static preconditions
+     * to join, in which case <code>getIterator</code> should be used instead
+     */
+    bool joinStaticPreconditions(const VAL::goal *g, JoinedBindings &bindings);
+
+protected:
+    /** Collect the positive static facts in the conjunctions at the root of
+     * <code>g</code>, looking through timed goals. */
+    void collectStaticPreconditions(const VAL::goal *g,
+                                    vector< const VAL::simple_goal * > &sgs);
 };
 
 class OperatorParameterDomainConstraints : public ParameterDomainConstraints {
@@ -1902,7 +2125,8 @@ protected:
         return (x == 0);
     }
 
-    PDCIterator(ParameterDomainConstraints *const p)
+    PDCIterator(ParameterDomainConstraints *const p, const int &from = 0,
+                const int &to = INT_MAX)
         : parent(p),
           pds(parent->domainStack.front()),
           varCount(p->varCount),
@@ -1938,6 +2162,17 @@ protected:
                 make_pair(&(wholeSets[i]), whole));
         }
 
+        if (from > 0 || to < (int)wholeSets[lim].size()) {
+            set< int >::iterator first = wholeSets[lim].begin();
+            int i = 0;
+            for (; i < from && first != wholeSets[lim].end(); ++i, ++first)
+                ;
+            set< int >::iterator last = first;
+            for (; i < to && last != wholeSets[lim].end(); ++i, ++last)
+                ;
+            wholeSets[lim] = set< int >(first, last);
+        }
+
         valItrs[lim] = wholeSets[lim].begin();
         valEnds[lim] = wholeSets[lim].end();
 
@@ -1991,8 +2226,7 @@ public:
     void next() {
         static const bool debug = false;
 
-        static int x;
-        x = 0;
+        int x = 0;
         ++(valItrs[x]);
 
         if (debug) {
@@ -2040,6 +2274,580 @@ PDCIterator *ParameterDomainConstraints::getIterator() {
     return new PDCIterator(this);
 }
 
+PDCIterator *ParameterDomainConstraints::getIterator(const int &from,
+        const int &to) {
+    return new PDCIterator(this, from, to);
+}
+
+int ParameterDomainConstraints::lastParameterDomainSize() const {
+    if (!varCount) return 0;
+    const pair< bool, set< int > > &d = domainStack.front().domains[varCount - 1];
+    return d.first ? possibleParameterValues[varCount - 1].size()
+           : d.second.size();
+}
+
+/** Whether every typed form of the predicate <code>hps</code> appears static,
+ * so that its initial facts are all the facts of it there will be. */
+static bool allFormsAppearStatic(holding_pred_symbol *const hps) {
+    holding_pred_symbol::PIt epsItr = hps->pBegin();
+    const holding_pred_symbol::PIt epsEnd = hps->pEnd();
+    for (; epsItr != epsEnd; ++epsItr) {
+        if (!(*epsItr)->appearsStatic()) return false;
+    }
+    return true;
+}
+
+void ParameterDomainConstraints::collectStaticPreconditions(
+    const VAL::goal *g, vector< const VAL::simple_goal * > &sgs) {
+    if (const conj_goal *cg = dynamic_cast< const conj_goal * >(g)) {
+        for (goal_list::const_iterator i = cg->getGoals()->begin();
+                i != cg->getGoals()->end(); ++i) {
+            collectStaticPreconditions(*i, sgs);
+        }
+    } else if (const timed_goal *tg = dynamic_cast< const timed_goal * >(g)) {
+        collectStaticPreconditions(tg->getGoal(), sgs);
+    } else if (const simple_goal *sg = dynamic_cast< const simple_goal * >(g)) {
+        if (sg->getPolarity() != E_POS) return;
+
+        holding_pred_symbol *const hps = EPS(sg->getProp()->head)->getParent();
+        if (hps == equality || !allFormsAppearStatic(hps)) return;
+
+        sgs.push_back(sg);
+    }
+}
+
+/** Orders bindings as a <code>PDCIterator</code> visits them: the value of
+ * the last parameter varies slowest, and that of the first fastest. */
+struct BindingLT {
+    const vector< int > &rows;
+    const int width;
+
+    BindingLT(const vector< int > &r, int w) : rows(r), width(w) {};
+
+    bool operator()(size_t a, size_t b) const {
+        for (int v = width - 1; v >= 0; --v) {
+            if (rows[a * width + v] != rows[b * width + v]) {
+                return rows[a * width + v] < rows[b * width + v];
+            }
+        }
+        return false;
+    }
+};
+
+bool ParameterDomainConstraints::joinStaticPreconditions(
+    const VAL::goal *g, JoinedBindings &bindings) {
+    vector< const VAL::simple_goal * > sgs;
+    if (g) collectStaticPreconditions(g, sgs);
+    if (sgs.empty()) return false;
+
+    const ParameterDomainsAndConstraints &pds = domainStack.front();
+
+    // For each static precondition, the parameters it mentions, and the
+    // tuples of value indices for these taken from the consistent facts
+    const int relCount = sgs.size();
+    vector< vector< int > > relParams(relCount);
+    vector< vector< int > > relTuples(relCount);
+
+    for (int r = 0; r < relCount; ++r) {
+        const VAL::proposition *const prop = sgs[r]->getProp();
+        const int affects = prop->args->size();
+
+        // Facts of arity 0 are kept apart from the others, and either rule
+        // out every binding or none
+        if (!affects) {
+            if (InitialStateEvaluator::init0State.find(prop->head) ==
+                    InitialStateEvaluator::init0State.end()) {
+                return true;
+            }
+            continue;
+        }
+
+        // If parameterIndex[x]=y then predicate arg x is parameter y of the
+        // action, and if it is -1 the argument is the constant in hasToMatch[x]
+        vector< int > parameterIndex(affects, -1);
+        vector< const VAL::const_symbol * > hasToMatch(affects,
+                (VAL::const_symbol *)0);
+        // The position of predicate arg x's parameter in relParams[r]
+        vector< int > column(affects, -1);
+
+        VAL::parameter_symbol_list::const_iterator argItr = prop->args->begin();
+        for (int aff = 0; aff < affects; ++aff, ++argItr) {
+            if (const VAL::const_symbol *const c =
+                        dynamic_cast< const VAL::const_symbol * >(*argItr)) {
+                hasToMatch[aff] = c;
+            } else {
+                const int paramID =
+                    static_cast< const VAL::IDsymbol< VAL::var_symbol > * >(*argItr)
+                    ->getId();
+                parameterIndex[aff] = paramID;
+                column[aff] = std::find(relParams[r].begin(), relParams[r].end(),
+                                        paramID) -
+                              relParams[r].begin();
+                if (column[aff] == (int)relParams[r].size()) {
+                    relParams[r].push_back(paramID);
+                }
+            }
+        }
+
+        const int width = relParams[r].size();
+        vector< int > scratch(width);
+        int consistent = 0;
+
+        holding_pred_symbol *const hps = EPS(prop->head)->getParent();
+        holding_pred_symbol::PIt epsItr = hps->pBegin();
+        const holding_pred_symbol::PIt epsEnd = hps->pEnd();
+        const IState::iterator isEnd = InitialStateEvaluator::initState.end();
+
+        for (; epsItr != epsEnd; ++epsItr) {
+            const IState::iterator isItr =
+                InitialStateEvaluator::initState.find(*epsItr);
+            if (isItr == isEnd) continue;
+
+            vector< VAL::parameter_symbol_list * >::const_iterator groundItr =
+                isItr->second.begin();
+            const vector< VAL::parameter_symbol_list * >::const_iterator
+            groundEnd = isItr->second.end();
+
+            // Loop over each instance of the predicate in the initial state
+            for (; groundItr != groundEnd; ++groundItr) {
+                std::fill(scratch.begin(), scratch.end(), -1);
+                bool keep = true;
+
+                VAL::parameter_symbol_list::const_iterator wwItr =
+                    (*groundItr)->begin();
+                for (int aff = 0; keep && aff < affects; ++aff, ++wwItr) {
+                    const VAL::const_symbol *const asConst =
+                        dynamic_cast< const VAL::const_symbol * >(*wwItr);
+
+                    if (hasToMatch[aff]) {
+                        keep = (hasToMatch[aff] == asConst);
+                        continue;
+                    }
+
+                    const int paramID = parameterIndex[aff];
+                    const pviLookup::const_iterator findEntry =
+                        parameterValuesToIndices[paramID].find(asConst);
+                    if (findEntry == parameterValuesToIndices[paramID].end()) {
+                        keep = false;
+                        continue;
+                    }
+
+                    const int asInt = findEntry->second;
+                    if (!pds.domains[paramID].first &&
+                            pds.domains[paramID].second.find(asInt) ==
+                            pds.domains[paramID].second.end()) {
+                        keep = false;
+                        continue;
+                    }
+
+                    // a parameter appearing twice must be given the same value
+                    int &val = scratch[column[aff]];
+                    if (val != -1 && val != asInt) {
+                        keep = false;
+                    }
+                    val = asInt;
+                }
+
+                if (keep) {
+                    relTuples[r].insert(relTuples[r].end(), scratch.begin(),
+                                        scratch.end());
+                    ++consistent;
+                }
+            }
+        }
+
+        // A static precondition with no consistent facts rules out every
+        // binding
+        if (!consistent) return true;
+    }
+
+    // The bindings so far, varCount values to a row, -1 where unbound
+    vector< int > rows(varCount, -1);
+    size_t rowCount = 1;
+    vector< bool > bound(varCount, false);
+    vector< bool > joined(relCount, false);
+
+    for (int step = 0; step < relCount && rowCount; ++step) {
+        // Prefer relations sharing a parameter with the bindings so far, so
+        // as not to take a cross product, and amongst those the smallest
+        int best = -1;
+        bool bestShared = false;
+        size_t bestSize = 0;
+        for (int r = 0; r < relCount; ++r) {
+            if (joined[r]) continue;
+            const int width = relParams[r].size();
+            const size_t size = width ? relTuples[r].size() / width : 1;
+            bool shared = false;
+            for (int c = 0; c < width; ++c) {
+                if (bound[relParams[r][c]]) shared = true;
+            }
+            if (best == -1 || (shared && !bestShared) ||
+                    (shared == bestShared && size < bestSize)) {
+                best = r;
+                bestShared = shared;
+                bestSize = size;
+            }
+        }
+        joined[best] = true;
+
+        const vector< int > &params = relParams[best];
+        const vector< int > &tuples = relTuples[best];
+        const int width = params.size();
+        if (!width) continue;
+        const int tupleCount = tuples.size() / width;
+
+        vector< int > sharedCols;
+        vector< int > newCols;
+        for (int c = 0; c < width; ++c) {
+            (bound[params[c]] ? sharedCols : newCols).push_back(c);
+        }
+
+        // Hash the tuples on their values for the parameters already bound
+        typedef std::unordered_map< size_t, vector< int > > HashIndex;
+        HashIndex index;
+        for (int t = 0; t < tupleCount; ++t) {
+            size_t h = 0;
+            for (vector< int >::const_iterator c = sharedCols.begin();
+                    c != sharedCols.end(); ++c) {
+                h = h * 1000003 + tuples[t * width + *c];
+            }
+            index[h].push_back(t);
+        }
+
+        vector< int > newRows;
+        size_t newRowCount = 0;
+        for (size_t row = 0; row < rowCount; ++row) {
+            const int *const binding = &rows[row * varCount];
+            size_t h = 0;
+            for (vector< int >::const_iterator c = sharedCols.begin();
+                    c != sharedCols.end(); ++c) {
+                h = h * 1000003 + binding[params[*c]];
+            }
+            const HashIndex::const_iterator bucket = index.find(h);
+            if (bucket == index.end()) continue;
+
+            for (vector< int >::const_iterator t = bucket->second.begin();
+                    t != bucket->second.end(); ++t) {
+                const int *const tuple = &tuples[*t * width];
+                bool match = true;
+                for (vector< int >::const_iterator c = sharedCols.begin();
+                        match && c != sharedCols.end(); ++c) {
+                    match = (binding[params[*c]] == tuple[*c]);
+                }
+                if (!match) continue;
+
+                newRows.insert(newRows.end(), binding, binding + varCount);
+                for (vector< int >::const_iterator c = newCols.begin();
+                        c != newCols.end(); ++c) {
+                    newRows[newRowCount * varCount + params[*c]] = tuple[*c];
+                }
+                ++newRowCount;
+            }
+        }
+
+        rows.swap(newRows);
+        rowCount = newRowCount;
+        for (vector< int >::const_iterator c = newCols.begin();
+                c != newCols.end(); ++c) {
+            bound[params[*c]] = true;
+        }
+    }
+
+    // Parameters no static precondition mentions take any value left in their
+    // domains
+    vector< vector< VAL::const_symbol * > > freeValues(varCount);
+    for (int v = 0; v < varCount; ++v) {
+        if (bound[v]) continue;
+        if (pds.domains[v].first) {
+            freeValues[v] = possibleParameterValues[v];
+        } else {
+            for (set< int >::const_iterator i = pds.domains[v].second.begin();
+                    i != pds.domains[v].second.end(); ++i) {
+                freeValues[v].push_back(possibleParameterValues[v][*i]);
+            }
+        }
+    }
+
+    vector< size_t > order(rowCount);
+    for (size_t row = 0; row < rowCount; ++row) {
+        order[row] = row;
+    }
+    const BindingLT before(rows, varCount);
+    std::sort(order.begin(), order.end(), before);
+
+    vector< VAL::const_symbol * > symbols;
+    symbols.reserve(rowCount * varCount);
+    for (size_t i = 0; i < rowCount; ++i) {
+        // repeated facts in the initial state give repeated bindings
+        if (i && !before(order[i - 1], order[i])) continue;
+        for (int v = 0; v < varCount; ++v) {
+            symbols.push_back(
+                bound[v] ? possibleParameterValues[v][rows[order[i] * varCount + v]]
+                : 0);
+        }
+    }
+    bindings.set(bound, symbols, freeValues);
+
+    return true;
+}
+
+/**
+ * The preconditions of an operator that can be decided from the initial state
+ * alone, compiled into a flat list of probes so that most bindings that fail
+ * them are ruled out without walking the precondition.  A probe compares two
+ * arguments, or looks up a fact whose arguments are parameters or constants
+ * in the hashed initial facts, and only rules out bindings the
+ * <code>SimpleEvaluator</code> would find the preconditions false for: those
+ * it passes must still be evaluated.
+ *
+ * The probes are taken from the conjuncts at the root of the precondition.
+ * Comparisons run first, then the facts that must hold, those with the fewest
+ * initial facts first, then the facts that must not.
+ */
+class StaticPreconditionCheck {
+private:
+    enum Test { SAME, DIFFERENT, HOLDS, MISSING };
+
+    /** An argument of a probe: a constant, or else the parameter with the
+     * given identifier. */
+    typedef pair< VAL::const_symbol *, int > Arg;
+
+    struct Probe {
+        Test test;
+        const VAL::proposition *prop;
+        extended_pred_symbol *eps;
+        /** Whether the fact is only decided if it is completely static. */
+        bool checkStatic;
+        /** Whether an arity 0 fact with the same head is initially true. */
+        bool init0;
+        /** The number of initial facts of the predicate. */
+        size_t facts;
+        vector< Arg > args;
+
+        bool operator<(const Probe &p) const {
+            if (test != p.test) return test < p.test;
+            if (test == HOLDS) return facts < p.facts;
+            if (test == MISSING) return facts > p.facts;
+            return false;
+        }
+    };
+
+    /** The values of a probe's arguments under a binding, as a sequence of
+     * constants. */
+    struct ArgValues {
+        vector< Arg >::const_iterator a;
+        FastEnvironment::const_iterator syms;
+
+        ArgValues(vector< Arg >::const_iterator i,
+                  FastEnvironment::const_iterator s)
+            : a(i), syms(s) {};
+        VAL::const_symbol *operator*() const {
+            return a->first ? a->first : syms[a->second];
+        }
+        ArgValues &operator++() {
+            ++a;
+            return *this;
+        }
+        bool operator!=(const ArgValues &v) const {
+            return a != v.a;
+        }
+    };
+
+    vector< Probe > probes;
+    const VAL::pred_symbol *const equality;
+
+    /**
+     * Add the probes for <code>g</code>.  The result is <code>false</code> if
+     * compiling should stop: when <code>leading</code> is set only the
+     * conjuncts before the first that might be false but cannot be compiled
+     * are used, as the <code>SimpleEvaluator</code> goes on to the duration
+     * constraints of a durative action after some conjuncts it finds false.  If
+     * <code>joined</code> is set the bindings are taken from the initial facts
+     * of every precondition <code>allFormsAppearStatic</code>, which need no
+     * probes.
+     */
+    bool compile(const VAL::goal *g, const bool &joined, const bool &leading) {
+        if (const conj_goal *cg = dynamic_cast< const conj_goal * >(g)) {
+            for (goal_list::const_iterator i = cg->getGoals()->begin();
+                    i != cg->getGoals()->end(); ++i) {
+                if (!compile(*i, joined, leading)) return false;
+            }
+            return true;
+        }
+        if (const timed_goal *tg = dynamic_cast< const timed_goal * >(g)) {
+            return compile(tg->getGoal(), joined, leading);
+        }
+        // A negative literal the evaluator cannot decide is left with a stale
+        // value, so only positive literals, and their negations, are compiled.
+        bool positive = true;
+        if (const neg_goal *ng = dynamic_cast< const neg_goal * >(g)) {
+            g = ng->getGoal();
+            positive = false;
+        }
+        const simple_goal *sg = dynamic_cast< const simple_goal * >(g);
+        if (!sg || sg->getPolarity() != E_POS) return !leading;
+
+        Probe p;
+        p.prop = sg->getProp();
+        p.eps = EPS(p.prop->head);
+        holding_pred_symbol *const hps = p.eps->getParent();
+        if (hps == equality) {
+            p.test = positive ? SAME : DIFFERENT;
+        } else if (p.eps->appearsStatic() || p.eps->cannotIncrease()) {
+            if (positive && joined && allFormsAppearStatic(hps)) return true;
+            p.test = positive ? HOLDS : MISSING;
+        } else {
+            // the evaluator leaves facts that can change unknown
+            return true;
+        }
+
+        p.checkStatic = p.eps->appearsStatic() && !p.eps->isDefinitelyStatic();
+        p.init0 = InitialStateEvaluator::init0State.find(p.prop->head) !=
+                  InitialStateEvaluator::init0State.end();
+        if (p.test == HOLDS && p.init0) return true;
+
+        p.facts = 0;
+        for (holding_pred_symbol::PIt i = hps->pBegin(); i != hps->pEnd(); ++i) {
+            const IState::const_iterator facts =
+                InitialStateEvaluator::initState.find(*i);
+            if (facts != InitialStateEvaluator::initState.end())
+                p.facts += facts->second.size();
+        }
+
+        for (parameter_symbol_list::const_iterator a = p.prop->args->begin();
+                a != p.prop->args->end(); ++a) {
+            if (VAL::const_symbol *c = dynamic_cast< VAL::const_symbol * >(*a)) {
+                p.args.push_back(Arg(c, -1));
+            } else {
+                const int id =
+                    static_cast< const IDsymbol< var_symbol > * >(*a)->getId();
+                p.args.push_back(Arg(0, id));
+            }
+        }
+        probes.push_back(p);
+        return true;
+    }
+
+public:
+    StaticPreconditionCheck(const VAL::operator_ *op, const bool &joined)
+        : probes(),
+          equality(VAL::current_analysis->pred_tab.symbol_probe("=")) {
+        if (op->precondition) {
+            compile(op->precondition, joined,
+                    dynamic_cast< const durative_action * >(op));
+        }
+        std::stable_sort(probes.begin(), probes.end());
+    };
+
+    /** Whether the preconditions are false for the binding in <code>e</code>;
+     * if not, they may still be. */
+    bool rulesOut(FastEnvironment &e) const {
+        for (vector< Probe >::const_iterator p = probes.begin();
+                p != probes.end(); ++p) {
+            const FastEnvironment::const_iterator syms = e.begin();
+            const ArgValues first(p->args.begin(), syms);
+            const ArgValues last(p->args.end(), syms);
+            bool falsified = false;
+            switch (p->test) {
+            case SAME:
+            case DIFFERENT:
+                falsified = (*first == *ArgValues(p->args.end() - 1, syms)) !=
+                            (p->test == SAME);
+                break;
+            case HOLDS:
+                falsified = !InitialStateEvaluator::initFacts.find(
+                                p->eps->getParent(), first, last);
+                break;
+            case MISSING:
+                falsified = p->init0 || (InitialStateEvaluator::initFacts.find(
+                                             p->eps->getParent(), first, last) &&
+                                         p->eps->contains(&e, p->prop));
+                break;
+            }
+            if (falsified && (!p->checkStatic ||
+                              p->eps->isCompletelyStatic(&e, p->prop))) {
+                return true;
+            }
+        }
+        return false;
+    };
+};
+
+/**
+ * Check the binding of the parameters of <code>op</code> in <code>e</code>,
+ * returning the ground operator it gives unless it is self mutex or its
+ * preconditions cannot be satisfied, in which case 0 is returned.  The
+ * preconditions are only walked if <code>check</code> does not rule the
+ * binding out.
+ */
+static instantiatedOp *groundBinding(const VAL::operator_ *op,
+                                     FastEnvironment &e, SimpleEvaluator &se,
+                                     const StaticPreconditionCheck &check) {
+    if (!TIM::selfMutex(op, makeIterator(&e, op->parameters->begin()),
+                        makeIterator(&e, op->parameters->end()))) {
+        bool possible = !check.rulesOut(e);
+        if (possible) {
+            se.prepareForVisit(&e);
+            const_cast< VAL::operator_ * >(op)->visit(&se);
+            possible = !se.reallyFalse();
+        }
+        if (possible) {
+            return new instantiatedOp(op, e.copy());
+        }
+#ifndef NDEBUG
+        else if (instantiatedOp::insistOnOp &&
+                 instantiatedOp::insistOnOp == op) {
+            bool allMatched = true;
+            int p = 0;
+            for (var_symbol_list::const_iterator a = op->parameters->begin();
+                    a != op->parameters->end(); ++a, ++p) {
+                if (e[*a] != instantiatedOp::insistOnOpParameters[p]) {
+                    allMatched = false;
+                    break;
+                }
+            }
+
+            if (allMatched) {
+                cout << "Killed\n" << op->name->getName() << "(";
+                for (var_symbol_list::const_iterator a = op->parameters->begin();
+                        a != op->parameters->end(); ++a) {
+                    cout << e[*a]->getName() << " ";
+                };
+                cout << ") - preconditions evaluated to false\n";
+                exit(1);
+            }
+        }
+#endif
+
+    }
+#ifndef NDEBUG
+    else if (instantiatedOp::insistOnOp &&
+             instantiatedOp::insistOnOp == op) {
+        bool allMatched = true;
+        int p = 0;
+        for (var_symbol_list::const_iterator a = op->parameters->begin();
+                a != op->parameters->end(); ++a, ++p) {
+            if (e[*a] != instantiatedOp::insistOnOpParameters[p]) {
+                allMatched = false;
+                break;
+            }
+        }
+
+        if (allMatched) {
+            cout << "Decided that (" << op->name->getName();
+            for (var_symbol_list::const_iterator a = op->parameters->begin();
+                    a != op->parameters->end(); ++a) {
+                cout << " " << e[*a]->getName();
+            };
+            cout << ") was self mutex\n";
+
+            exit(1);
+        }
+    }
+#endif
+    return 0;
+}
+
 void instantiatedOp::instantiate(const VAL::operator_ *op,
                                  const VAL::problem *prb,
                                  VAL::TypeChecker &tc) {
@@ -2083,10 +2891,7 @@ void instantiatedOp::instantiate(const VAL::operator_ *op,
         op->visit(&se);
         if (!se.reallyFalse()) {
             FastEnvironment *ecpy = e.copy();
-            instantiatedOp *o = new instantiatedOp(op, ecpy);
-            if (instOps.insert(o)) {
-                delete o;
-            };
+            add(new instantiatedOp(op, ecpy));
         };
         return;
     };
@@ -2103,76 +2908,266 @@ void instantiatedOp::instantiate(const VAL::operator_ *op,
         }
     }
 
+    JoinedBindings bindings;
+    const bool joined = pdc.joinStaticPreconditions(op->precondition, bindings);
+    const StaticPreconditionCheck check(op, joined);
+
+    // Keep the operator the binding in e gives, if there is one.
+    auto consider = [&]() {
+        if (instantiatedOp *o = groundBinding(op, e, se, check)) add(o);
+    };
+
+    if (joined) {
+        bindings.visit(0, bindings.size(), [&](VAL::const_symbol *const *b) {
+            for (int x = 0; x < opParamCount; ++x) {
+                e[vars[x]] = b[x];
+            }
+            consider();
+        });
+        return;
+    }
+
     std::unique_ptr< PDCIterator > options(pdc.getIterator());
 
     while (options->isValid()) {
         for (int x = 0; x < opParamCount; ++x) {
             e[vars[x]] = (*options)[x];
         }
-        if (!TIM::selfMutex(op, makeIterator(&e, op->parameters->begin()),
-                            makeIterator(&e, op->parameters->end()))) {
-            se.prepareForVisit(&e);
-            const_cast< VAL::operator_ * >(op)->visit(&se);
-            if (!se.reallyFalse()) {
-                FastEnvironment *ecpy = e.copy();
-                instantiatedOp *o = new instantiatedOp(op, ecpy);
-                if (instOps.insert(o)) {
-                    delete o;
-                };
+        consider();
+        options->next();
+    }
+};
+
+/**
+ * Record the values of every quantified variable in <code>g</code> in
+ * <code>instantiatedValues</code>, as the <code>SimpleEvaluator</code> would
+ * when it first reached them.
+ */
+static void recordQuantifiedValues(const VAL::goal *g, VAL::TypeChecker &tc) {
+    if (const conj_goal *cg = dynamic_cast< const conj_goal * >(g)) {
+        for (goal_list::const_iterator i = cg->getGoals()->begin();
+                i != cg->getGoals()->end(); ++i) {
+            recordQuantifiedValues(*i, tc);
+        }
+    } else if (const disj_goal *dg = dynamic_cast< const disj_goal * >(g)) {
+        for (goal_list::const_iterator i = dg->getGoals()->begin();
+                i != dg->getGoals()->end(); ++i) {
+            recordQuantifiedValues(*i, tc);
+        }
+    } else if (const neg_goal *ng = dynamic_cast< const neg_goal * >(g)) {
+        recordQuantifiedValues(ng->getGoal(), tc);
+    } else if (const imply_goal *ig = dynamic_cast< const imply_goal * >(g)) {
+        recordQuantifiedValues(ig->getAntecedent(), tc);
+        recordQuantifiedValues(ig->getConsequent(), tc);
+    } else if (const timed_goal *tg = dynamic_cast< const timed_goal * >(g)) {
+        recordQuantifiedValues(tg->getGoal(), tc);
+    } else if (const qfied_goal *qg = dynamic_cast< const qfied_goal * >(g)) {
+        for (var_symbol_list::const_iterator v = qg->getVars()->begin();
+                v != qg->getVars()->end(); ++v) {
+            if (instantiatedValues.find((*v)->type) == instantiatedValues.end()) {
+                instantiatedValues[(*v)->type] = tc.range(*v);
             }
-#ifndef NDEBUG
-            else if (insistOnOp && insistOnOp == op) {
-                bool allMatched = true;
-                int p = 0;
-                for (var_symbol_list::const_iterator a = op->parameters->begin();
-                        a != op->parameters->end(); ++a, ++p) {
-                    if (e[*a] != insistOnOpParameters[p]) {
-                        allMatched = false;
-                        break;
-                    }
-                }
+        }
+        recordQuantifiedValues(qg->getGoal(), tc);
+    }
+}
 
-                if (allMatched) {
-                    cout << "Killed\n" << op->name->getName() << "(";
-                    for (var_symbol_list::const_iterator a = op->parameters->begin();
-                            a != op->parameters->end(); ++a) {
-                        cout << e[*a]->getName() << " ";
-                    };
-                    cout << ") - preconditions evaluated to false\n";
-                    exit(1);
+/**
+ * Call <code>work(i)</code> for each <code>i</code> below <code>count</code>,
+ * on <code>jobs</code> threads, each taking the next <code>i</code> as it
+ * finishes the last.  The first exception thrown is rethrown once the
+ * threads have stopped.
+ */
+template < typename F >
+static void runOnThreads(const size_t &count, const unsigned int &jobs,
+                         F work) {
+    std::atomic< size_t > next(0);
+    std::exception_ptr failure;
+    std::mutex failureLock;
+
+    vector< std::thread > threads;
+    for (unsigned int j = 0; j < jobs && j < count; ++j) {
+        threads.push_back(std::thread([&]() {
+            for (size_t i = next++; i < count; i = next++) {
+                try {
+                    work(i);
+                } catch (...) {
+                    std::lock_guard< std::mutex > lock(failureLock);
+                    if (!failure) failure = std::current_exception();
+                    next = count;
                 }
             }
+        }));
+    }
+
+    for (vector< std::thread >::iterator t = threads.begin(); t != threads.end();
+            ++t)
+        t->join();
+
+    if (failure) std::rethrow_exception(failure);
+}
+
+/**
+ * A share of the grounding of one operator: the bindings at positions
+ * <code>[from,to)</code> of those its static preconditions join to or, if
+ * they could not be joined, those with the last parameter at positions
+ * <code>[from,to)</code> of its domain.
+ */
+struct GroundingTask {
+    size_t op;
+    size_t from;
+    size_t to;
+    vector< instantiatedOp * > shard;
+
+    GroundingTask(size_t o, size_t f, size_t t)
+        : op(o), from(f), to(t), shard() {};
+};
+
+vector< int > instantiatedOp::instantiateAll(const VAL::operator_list *ops,
+        const VAL::problem *prb,
+        VAL::TypeChecker &tc,
+        const unsigned int &jobs) {
+    vector< int > counts;
+
+    bool sequential = (jobs < 2) || stream;
+#ifndef NDEBUG
+    sequential = sequential || insistOnOp;
 #endif
+    if (sequential) {
+        for (operator_list::const_iterator o = ops->begin(); o != ops->end();
+                ++o) {
+            instantiate(*o, prb, tc);
+            counts.push_back(howMany());
+        }
+        return counts;
+    }
+
+    const vector< const VAL::operator_ * > opv(ops->begin(), ops->end());
 
+    // The threads share the values recorded for each type, so record every one
+    // they will need first.
+    for (size_t i = 0; i < opv.size(); ++i) {
+        int p = 0;
+        for (var_symbol_list::const_iterator v = opv[i]->parameters->begin();
+                v != opv[i]->parameters->end(); ++v, ++p) {
+            parameterValues(*v, p, opv[i]->name->getName(), tc);
         }
-#ifndef NDEBUG
-        else if (insistOnOp && insistOnOp == op) {
-            bool allMatched = true;
-            int p = 0;
-            for (var_symbol_list::const_iterator a = op->parameters->begin();
-                    a != op->parameters->end(); ++a, ++p) {
-                if (e[*a] != insistOnOpParameters[p]) {
-                    allMatched = false;
-                    break;
-                }
-            }
+        if (opv[i]->precondition)
+            recordQuantifiedValues(opv[i]->precondition, tc);
+    }
 
-            if (allMatched) {
-                cout << "Decided that (" << op->name->getName();
-                for (var_symbol_list::const_iterator a = op->parameters->begin();
-                        a != op->parameters->end(); ++a) {
-                    cout << " " << e[*a]->getName();
-                };
-                cout << ") was self mutex\n";
+    // Work out the candidate bindings of each operator: those its static
+    // preconditions join to, or else the domain of its last parameter.
+    vector< std::unique_ptr< OperatorParameterDomainConstraints > > pdcs(
+        opv.size());
+    vector< JoinedBindings > joined(opv.size());
+    vector< size_t > candidates(opv.size(), 0);
+    vector< char > joins(opv.size(), false);
+    vector< std::unique_ptr< StaticPreconditionCheck > > checks(opv.size());
+
+    runOnThreads(opv.size(), jobs, [&](size_t i) {
+        pdcs[i].reset(new OperatorParameterDomainConstraints(opv[i], tc));
+        const int params = opv[i]->parameters->size();
+        if (!params) {
+            candidates[i] = 1;
+        } else if (pdcs[i]->joinStaticPreconditions(opv[i]->precondition,
+                   joined[i])) {
+            joins[i] = true;
+            candidates[i] = joined[i].size();
+        } else {
+            std::unique_ptr< PDCIterator > options(pdcs[i]->getIterator());
+            if (options->isValid())
+                candidates[i] = pdcs[i]->lastParameterDomainSize();
+        }
+        checks[i].reset(new StaticPreconditionCheck(opv[i], joins[i]));
+    });
+
+    // Split each operator's candidates into ranges, several per thread so
+    // that the threads finish together.
+    vector< GroundingTask > tasks;
+    for (size_t i = 0; i < opv.size(); ++i) {
+        if (!candidates[i]) continue;
+        if (opv[i]->parameters->size()) {
+            // The self mutex checks record the operator's mutexes the first
+            // time they are made, so that is done here instead.
+            VAL::operator_ *op = const_cast< VAL::operator_ * >(opv[i]);
+            if (TIM::MutexStore *tm = MEX(op)) tm->getMutex(op);
+        }
+        const size_t slices = std::min(candidates[i], size_t(4 * jobs));
+        const size_t share = candidates[i] / slices;
+        const size_t extra = candidates[i] % slices;
+        for (size_t s = 0; s < slices; ++s) {
+            tasks.push_back(
+                GroundingTask(i, share * s + std::min(s, extra),
+                              share * (s + 1) + std::min(s + 1, extra)));
+        }
+    }
 
-                exit(1);
+    runOnThreads(tasks.size(), jobs, [&](size_t t) {
+        GroundingTask &task = tasks[t];
+        const VAL::operator_ *op = opv[task.op];
+        const int opParamCount = op->parameters->size();
+
+        FastEnvironment e(
+            static_cast< const id_var_symbol_table * >(op->symtab)->numSyms());
+        SimpleEvaluator se(&tc, 0, ISC());
+
+        if (!opParamCount) {
+            se.prepareForVisit(&e);
+            op->visit(&se);
+            if (!se.reallyFalse()) {
+                task.shard.push_back(new instantiatedOp(op, e.copy()));
             }
+            return;
         }
-#endif
 
-        options->next();
+        vector< VAL::var_symbol * > vars(op->parameters->begin(),
+                                         op->parameters->end());
+        const StaticPreconditionCheck &check = *checks[task.op];
+
+        if (joins[task.op]) {
+            joined[task.op].visit(
+            task.from, task.to, [&](VAL::const_symbol *const *b) {
+                for (int x = 0; x < opParamCount; ++x) {
+                    e[vars[x]] = b[x];
+                }
+                if (instantiatedOp *o = groundBinding(op, e, se, check)) {
+                    task.shard.push_back(o);
+                }
+            });
+            return;
+        }
+
+        std::unique_ptr< PDCIterator > options(
+            pdcs[task.op]->getIterator(task.from, task.to));
+        while (options->isValid()) {
+            for (int x = 0; x < opParamCount; ++x) {
+                e[vars[x]] = (*options)[x];
+            }
+            if (instantiatedOp *o = groundBinding(op, e, se, check)) {
+                task.shard.push_back(o);
+            }
+            options->next();
+        }
+    });
+
+    // Add the shards in the order the operators and their bindings would have
+    // been ground in on one thread, so the identifiers are the same.
+    vector< GroundingTask >::const_iterator task = tasks.begin();
+    for (size_t i = 0; i < opv.size(); ++i) {
+        for (; task != tasks.end() && task->op == i; ++task) {
+            for (vector< instantiatedOp * >::const_iterator o =
+                        task->shard.begin();
+                    o != task->shard.end(); ++o) {
+                if (instOps.insert(*o)) {
+                    delete *o;
+                };
+            }
+        }
+        counts.push_back(howMany());
     }
-};
+    return counts;
+}
 
 void instantiatedDrv::instantiate(const VAL::derivation_rule *op,
                                   const VAL::problem *prb,
@@ -2244,6 +3239,18 @@ PNEStore &instantiatedOp::pnes = instantiatedPNEs;
 LiteralStore &instantiatedDrv::literals = instantiatedLiterals;
 PNEStore &instantiatedDrv::pnes = instantiatedPNEs;
 
+/** @brief  A numeric effect of a ground operator or of the initial state. */
+struct GroundAssignment {
+    PNE *pne;
+    VAL::assign_op op;
+    const VAL::expression *expr;
+    FastEnvironment *env;
+
+    GroundAssignment(PNE *p, VAL::assign_op o, const VAL::expression *e,
+                     FastEnvironment *f)
+        : pne(p), op(o), expr(e), env(f) {};
+};
+
 class Collector : public VisitController {
 private:
     VAL::TypeChecker *tc;
@@ -2258,6 +3265,29 @@ private:
     bool checkpos;
     bool onlyCollectEffects;
 
+    // If set, where to list the literals added and the numeric effects met.
+    vector< Literal * > *added;
+    vector< GroundAssignment > *assigned;
+    // If set, where to list every literal the goals and effects visited
+    // mention, whatever their polarity, storing any not yet stored.
+    vector< Literal * > *mentioned;
+
+    void recordAdded(Literal *l) {
+        if (Literal *existing = literals.insert(l)) {
+            delete l;
+            l = existing;
+        };
+        if (added) added->push_back(l);
+    };
+    void recordMentioned(const proposition *p) {
+        Literal *l = new Literal(p, fe);
+        if (Literal *existing = literals.insert(l)) {
+            delete l;
+            l = existing;
+        };
+        mentioned->push_back(l);
+    };
+
 public:
     Collector(const VAL::operator_ *o, FastEnvironment *f, LiteralStore &l,
               PNEStore &p, VAL::TypeChecker *t = 0)
@@ -2270,7 +3300,10 @@ public:
           pnes(p),
           inpres(true),
           checkpos(true),
-          onlyCollectEffects(true) {};
+          onlyCollectEffects(true),
+          added(0),
+          assigned(0),
+          mentioned(0) {};
 
     Collector(const VAL::derivation_rule *o, FastEnvironment *f,
               LiteralStore &l, PNEStore &p, VAL::TypeChecker *t = 0)
@@ -2283,15 +3316,20 @@ public:
           pnes(p),
           inpres(true),
           checkpos(true),
-          onlyCollectEffects(true) {};
+          onlyCollectEffects(true),
+          added(0),
+          assigned(0),
+          mentioned(0) {};
 
     virtual void visit_simple_goal(simple_goal *p) {
-        if (onlyCollectEffects) return;
+        if (onlyCollectEffects && !mentioned) return;
         VAL::extended_pred_symbol *s = EPS(p->getProp()->head);
 
         if (VAL::current_analysis->pred_tab.symbol_probe("=") == s->getParent()) {
             return;
         };
+        if (mentioned) recordMentioned(p->getProp());
+        if (onlyCollectEffects) return;
         if (!inpres || (p->getPolarity() && !checkpos) ||
                 (!p->getPolarity() && checkpos)) {
             Literal *l = new Literal(p->getProp(), fe);
@@ -2373,12 +3411,20 @@ public:
     virtual void visit_preference(preference *p) {
         p->getGoal()->visit(this);
     };
+    /** @brief  List the literals each effect visited adds, and its numeric
+     * effects, as well as collecting them. */
+    void record(vector< Literal * > *a, vector< GroundAssignment > *n) {
+        added = a;
+        assigned = n;
+    };
+    /** @brief  List the literals mentioned by the goals and effects visited,
+     * including negated goals and delete effects, and store them. */
+    void recordMentions(vector< Literal * > *m) { mentioned = m; };
+
     virtual void visit_simple_effect(simple_effect *p) {
+        if (mentioned) recordMentioned(p->prop);
         if (!adding && onlyCollectEffects) return;
-        Literal *l = new Literal(p->prop, fe);
-        if (literals.insert(l)) {
-            delete l;
-        };
+        recordAdded(new Literal(p->prop, fe));
     };
     virtual void visit_constraint_goal(constraint_goal *cg) {
         if (cg->getRequirement()) {
@@ -2481,12 +3527,7 @@ public:
         inpres = false;
 
         adding = true;
-        Literal *l = new Literal(p->get_head(), fe);
-        if (literals.insert(l)) {
-            delete l;
-        } else {
-            //			cout << "Created " << *l << "\n";
-        }
+        recordAdded(new Literal(p->get_head(), fe));
     };
 
     virtual void visit_action(VAL::action *p) {
@@ -2511,8 +3552,13 @@ public:
     virtual void visit_assignment(assignment *a) {
         const func_term *ft = a->getFTerm();
         PNE *pne = new PNE(ft, fe);
-        if (pnes.insert(pne)) {
+        if (PNE *existing = pnes.insert(pne)) {
             delete pne;
+            pne = existing;
+        };
+        if (assigned) {
+            assigned->push_back(
+                GroundAssignment(pne, a->getOp(), a->getExpr(), fe));
         };
     };
 };
@@ -2548,6 +3594,357 @@ void instantiatedDrv::collectLiterals(VAL::TypeChecker *tc) {
     op->visit(&c);
 };
 
+namespace {
+
+/** @brief  An interval holding every value a numeric fluent or expression
+ * could take.  It is empty while the fluent could have no value. */
+struct RelaxedBounds {
+    double lo;
+    double hi;
+
+    RelaxedBounds() : lo(HUGE_VAL), hi(-HUGE_VAL) {};
+    RelaxedBounds(double l, double h) : lo(l), hi(h) {
+        // Arithmetic on infinities can leave no sensible bound.
+        if (l != l || h != h) {
+            lo = -HUGE_VAL;
+            hi = HUGE_VAL;
+        };
+    };
+
+    bool empty() const {
+        return lo > hi;
+    };
+};
+
+RelaxedBounds unbounded() {
+    return RelaxedBounds(-HUGE_VAL, HUGE_VAL);
+};
+
+RelaxedBounds hull(double a, double b, double c, double d) {
+    return RelaxedBounds(std::min(std::min(a, b), std::min(c, d)),
+                         std::max(std::max(a, b), std::max(c, d)));
+};
+
+/** @brief  The bounds on the value of <code>e</code>, given the bounds on
+ * the values of the PNEs. */
+RelaxedBounds relaxedValue(const VAL::expression *e, FastEnvironment *env,
+                           const vector< RelaxedBounds > &pneBounds) {
+    if (const num_expression *ne = dynamic_cast< const num_expression * >(e)) {
+        return RelaxedBounds(ne->double_value(), ne->double_value());
+    };
+    if (const func_term *ft = dynamic_cast< const func_term * >(e)) {
+        PNE p(ft, env);
+        PNE *q = instantiatedOp::findPNE(&p);
+        return q ? pneBounds[q->getGlobalID()] : RelaxedBounds();
+    };
+    if (const uminus_expression *ue =
+                dynamic_cast< const uminus_expression * >(e)) {
+        const RelaxedBounds b = relaxedValue(ue->getExpr(), env, pneBounds);
+        return b.empty() ? b : RelaxedBounds(-b.hi, -b.lo);
+    };
+    const binary_expression *be = dynamic_cast< const binary_expression * >(e);
+    if (!be) return unbounded();
+
+    const RelaxedBounds l = relaxedValue(be->getLHS(), env, pneBounds);
+    const RelaxedBounds r = relaxedValue(be->getRHS(), env, pneBounds);
+    if (l.empty() || r.empty()) return RelaxedBounds();
+    if (dynamic_cast< const plus_expression * >(e)) {
+        return RelaxedBounds(l.lo + r.lo, l.hi + r.hi);
+    };
+    if (dynamic_cast< const minus_expression * >(e)) {
+        return RelaxedBounds(l.lo - r.hi, l.hi - r.lo);
+    };
+    if (dynamic_cast< const mul_expression * >(e)) {
+        return hull(l.lo * r.lo, l.lo * r.hi, l.hi * r.lo, l.hi * r.hi);
+    };
+    if (dynamic_cast< const div_expression * >(e) && (r.lo > 0 || r.hi < 0)) {
+        return hull(l.lo / r.lo, l.lo / r.hi, l.hi / r.lo, l.hi / r.hi);
+    };
+    return unbounded();
+};
+
+/** @brief  Whether a comparison could hold, given the bounds on the values of
+ * the PNEs. */
+bool couldHold(const comparison *c, FastEnvironment *env,
+               const vector< RelaxedBounds > &pneBounds) {
+    const RelaxedBounds l = relaxedValue(c->getLHS(), env, pneBounds);
+    const RelaxedBounds r = relaxedValue(c->getRHS(), env, pneBounds);
+    if (l.empty() || r.empty()) return false;
+    switch (c->getOp()) {
+    case E_GREATER:
+        return l.hi > r.lo;
+    case E_GREATEQ:
+        return l.hi >= r.lo;
+    case E_LESS:
+        return l.lo < r.hi;
+    case E_LESSEQ:
+        return l.lo <= r.hi;
+    default:
+        return l.lo <= r.hi && r.lo <= l.hi;
+    };
+};
+
+/** @brief  Widen the bounds on a PNE to include <code>b</code>.  Once they
+ * have changed often enough, bounds that still grow are taken to grow without
+ * limit, so that effects feeding one another cannot widen them forever.
+ *
+ * @return  Whether the bounds changed.
+ */
+bool widen(RelaxedBounds &bounds, int &changes, const RelaxedBounds &b) {
+    static const int changesBeforeUnbounded = 8;
+    if (b.empty()) return false;
+    const bool lower = bounds.empty() || b.lo < bounds.lo;
+    const bool higher = bounds.empty() || b.hi > bounds.hi;
+    if (lower) bounds.lo = changes < changesBeforeUnbounded ? b.lo : -HUGE_VAL;
+    if (higher) bounds.hi = changes < changesBeforeUnbounded ? b.hi : HUGE_VAL;
+    if (!lower && !higher) return false;
+    ++changes;
+    return true;
+};
+
+/** @brief  Widen the bounds on the PNE a numeric effect changes to include
+ * the values it could give it.
+ *
+ * @return  Whether the bounds changed.
+ */
+bool applyRelaxed(const GroundAssignment &a, vector< RelaxedBounds > &pneBounds,
+                  vector< int > &changes) {
+    const int id = a.pne->getGlobalID();
+    const RelaxedBounds v = relaxedValue(a.expr, a.env, pneBounds);
+    RelaxedBounds &bounds = pneBounds[id];
+    if (a.op == E_ASSIGN) return widen(bounds, changes[id], v);
+    if (bounds.empty() || v.empty()) return false;
+    if (a.op == E_INCREASE || a.op == E_DECREASE) {
+        const bool up = (a.op == E_INCREASE) ? v.hi > 0 : v.lo < 0;
+        const bool down = (a.op == E_INCREASE) ? v.lo < 0 : v.hi > 0;
+        return widen(bounds, changes[id],
+                     RelaxedBounds(down ? -HUGE_VAL : bounds.lo,
+                                   up ? HUGE_VAL : bounds.hi));
+    };
+    return widen(bounds, changes[id], unbounded());
+};
+
+/** @brief  Collects what a ground operator needs before it can be applied in
+ * the delete relaxation: the positive literals and the comparisons conjoined
+ * in its precondition.  Other conditions are taken to hold, as are those a
+ * durative action needs after it starts, which its own effects might achieve.
+ */
+class RelaxedPreconditions : public VisitController {
+private:
+    FastEnvironment *env;
+    const VAL::pred_symbol *equality;
+
+public:
+    vector< int > literals;
+    vector< const comparison * > comparisons;
+    bool impossible;
+
+    RelaxedPreconditions(FastEnvironment *e)
+        : env(e),
+          equality(VAL::current_analysis->pred_tab.symbol_probe("=")),
+          impossible(false) {};
+
+    virtual void visit_simple_goal(simple_goal *p) {
+        if (p->getPolarity() == E_NEG ||
+                EPS(p->getProp()->head)->getParent() == equality) {
+            return;
+        };
+        Literal l(p->getProp(), env);
+        if (Literal *found = instantiatedOp::findLiteral(&l)) {
+            literals.push_back(found->getGlobalID());
+        } else {
+            impossible = true;
+        };
+    };
+    virtual void visit_conj_goal(conj_goal *p) {
+        p->getGoals()->visit(this);
+    };
+    virtual void visit_timed_goal(timed_goal *p) {
+        if (p->getTime() == E_AT_START) p->getGoal()->visit(this);
+    };
+    virtual void visit_comparison(comparison *p) {
+        comparisons.push_back(p);
+    };
+};
+
+/** @brief  A ground operator or derivation rule in the delete relaxation. */
+struct RelaxedAction {
+    FastEnvironment *env;
+    vector< const comparison * > comparisons;
+    vector< Literal * > adds;
+    vector< GroundAssignment > assigns;
+    int unsatisfied;
+    bool applied;
+
+    RelaxedAction() : env(0), unsatisfied(0), applied(false) {};
+};
+
+};  // namespace
+
+void instantiatedOp::filterUnreachableOps(VAL::problem *p,
+        VAL::TypeChecker *const tc) {
+    vector< bool > reached(literals.size(), false);
+    vector< int > toPropagate;
+    vector< RelaxedBounds > pneBounds(pnes.size());
+    vector< int > changes(pnes.size(), 0);
+
+    // The literals and values of the initial state, including those the timed
+    // initial literals will add.
+    {
+        vector< Literal * > initial;
+        vector< GroundAssignment > initialValues;
+        Collector c((VAL::operator_ *)0, 0, literals, pnes, tc);
+        c.record(&initial, &initialValues);
+        p->visit(&c);
+        for (vector< Literal * >::const_iterator l = initial.begin();
+                l != initial.end(); ++l) {
+            if (!reached[(*l)->getGlobalID()]) {
+                reached[(*l)->getGlobalID()] = true;
+                toPropagate.push_back((*l)->getGlobalID());
+            };
+        };
+        for (vector< GroundAssignment >::const_iterator a =
+                    initialValues.begin();
+                a != initialValues.end(); ++a) {
+            applyRelaxed(*a, pneBounds, changes);
+        };
+    }
+
+    // The operators come first, so that the index of an operator is its ID,
+    // and the derivation rules after them.
+    const int opCount = instOps.size();
+    vector< RelaxedAction > actions(opCount + instantiatedDrv::howMany());
+    vector< vector< int > > neededBy(literals.size());
+    for (int a = 0; a < int(actions.size()); ++a) {
+        RelaxedAction &action = actions[a];
+        const VAL::goal *pre;
+        if (a < opCount) {
+            instantiatedOp *o = instOps[a];
+            action.env = o->getEnv();
+            pre = o->op->precondition;
+            Collector c(o->op, action.env, literals, pnes, tc);
+            c.record(&action.adds, &action.assigns);
+            o->op->effects->visit(&c);
+        } else {
+            instantiatedDrv *d = instantiatedDrv::getInstDrv(a - opCount);
+            action.env = d->getEnv();
+            pre = d->forDrv()->get_body();
+            Collector c(d->forDrv(), action.env, literals, pnes, tc);
+            c.record(&action.adds, &action.assigns);
+            d->forDrv()->visit(&c);
+        };
+
+        RelaxedPreconditions pres(action.env);
+        if (pre) pre->visit(&pres);
+        if (pres.impossible) {
+            action.unsatisfied = -1;
+            continue;
+        };
+        action.comparisons.swap(pres.comparisons);
+        action.unsatisfied = pres.literals.size();
+        for (vector< int >::const_iterator l = pres.literals.begin();
+                l != pres.literals.end(); ++l) {
+            neededBy[*l].push_back(a);
+        };
+    };
+
+    // Apply each action once its literals have been reached, if its
+    // comparisons could hold; otherwise it waits until the bounds change.
+    vector< int > blocked;
+    vector< int > numeric;
+    bool boundsChanged = false;
+    auto apply = [&](const int a) {
+        RelaxedAction &action = actions[a];
+        for (vector< const comparison * >::const_iterator c =
+                    action.comparisons.begin();
+                c != action.comparisons.end(); ++c) {
+            if (!couldHold(*c, action.env, pneBounds)) {
+                blocked.push_back(a);
+                return;
+            };
+        };
+        action.applied = true;
+        for (vector< Literal * >::const_iterator l = action.adds.begin();
+                l != action.adds.end(); ++l) {
+            if (!reached[(*l)->getGlobalID()]) {
+                reached[(*l)->getGlobalID()] = true;
+                toPropagate.push_back((*l)->getGlobalID());
+            };
+        };
+        if (action.assigns.empty()) return;
+        numeric.push_back(a);
+        for (vector< GroundAssignment >::const_iterator n =
+                    action.assigns.begin();
+                n != action.assigns.end(); ++n) {
+            if (applyRelaxed(*n, pneBounds, changes)) boundsChanged = true;
+        };
+    };
+
+    for (int a = 0; a < int(actions.size()); ++a) {
+        if (!actions[a].unsatisfied) apply(a);
+    };
+    while (true) {
+        while (!toPropagate.empty()) {
+            const int l = toPropagate.back();
+            toPropagate.pop_back();
+            for (vector< int >::const_iterator a = neededBy[l].begin();
+                    a != neededBy[l].end(); ++a) {
+                if (!--actions[*a].unsatisfied) apply(*a);
+            };
+        };
+        if (!boundsChanged) break;
+
+        // Effects already applied might now give values outside the bounds,
+        // and blocked actions might now be applicable.
+        boundsChanged = false;
+        for (size_t i = 0; i < numeric.size(); ++i) {
+            const RelaxedAction &action = actions[numeric[i]];
+            for (vector< GroundAssignment >::const_iterator n =
+                        action.assigns.begin();
+                    n != action.assigns.end(); ++n) {
+                if (applyRelaxed(*n, pneBounds, changes)) boundsChanged = true;
+            };
+        };
+        vector< int > retry;
+        retry.swap(blocked);
+        for (vector< int >::const_iterator a = retry.begin(); a != retry.end();
+                ++a) {
+            apply(*a);
+        };
+    };
+
+    instOps.eraseUnless(
+    [&](const instantiatedOp *o) {
+        return actions[o->getID()].applied;
+    });
+
+    // The operators kept, and the derivation rules, might still delete or
+    // test literals that cannot be reached, or that no operator grounded
+    // adds, so those are stored and kept too.
+    vector< Literal * > mentioned;
+    for (OpStore::iterator o = instOps.begin(); o != instOps.end(); ++o) {
+        Collector c((*o)->op, (*o)->getEnv(), literals, pnes, tc);
+        c.recordMentions(&mentioned);
+        (*o)->op->visit(&c);
+    };
+    for (int d = 0; d < instantiatedDrv::howMany(); ++d) {
+        instantiatedDrv *drv = instantiatedDrv::getInstDrv(d);
+        Collector c(drv->forDrv(), drv->getEnv(), literals, pnes, tc);
+        c.recordMentions(&mentioned);
+        drv->forDrv()->visit(&c);
+    };
+    reached.resize(literals.size(), false);
+    for (vector< Literal * >::const_iterator l = mentioned.begin();
+            l != mentioned.end(); ++l) {
+        reached[(*l)->getGlobalID()] = true;
+    };
+
+    literals.eraseUnless(
+    [&](const Literal *l) {
+        return reached[l->getGlobalID()];
+    });
+};
+
 void instantiatedOp::writeAllLiterals(ostream &o) {
     literals.write(o);
 };
@@ -3,6 +3,7 @@
 
 #ifndef __INSTANTIATION
 #define __INSTANTIATION
+#include "AtomTable.h"
 #include "FastEnvironment.h"
 #include "SimpleEval.h"
 #include <algorithm>
@@ -121,7 +122,7 @@ public:
     };
 };
 
-class PNE {
+class PNE : public VAL::Pooled< PNE > {
 private:
     /** @brief A unique integer identifier for the PNE. */
     int id;
@@ -232,7 +233,7 @@ public:
 
 ostream &operator<<(ostream &o, const PNE &p);
 
-class Literal {
+class Literal : public VAL::Pooled< Literal > {
 protected:
     /** @brief A unique integer identifier for the fact. */
     int id;
@@ -391,10 +392,23 @@ struct Purifier< func_symbol > {
 template < typename S, typename V >
 class GenStore {
 private:
-    typedef map< const S *, CascadeMap< VAL::const_symbol *, V > > PredMap;
-
-    PredMap literals;
+    AtomTable< S, VAL::const_symbol, V * > literals;
     deque< V * > allLits;
+    // The entries for each (purified) head, so allContents need not scan
+    // the whole table, and where each entry of allLits sits in its head's
+    // vector.  Erased entries are left null in both until clearUp.
+    map< const S *, vector< V * > > byHead;
+    deque< size_t > headSlots;
+
+    void indexHeads() {
+        byHead.clear();
+        headSlots.resize(allLits.size());
+        for (size_t x = 0; x < allLits.size(); ++x) {
+            vector< V * > &hs = byHead[purify(allLits[x]->getHead())];
+            headSlots[x] = hs.size();
+            hs.push_back(allLits[x]);
+        };
+    }
 
     Purifier< S > purify;
 
@@ -416,12 +430,15 @@ public:
 
     V *insert(V *lit) {
         assert(!locked);
-        V *&str =
-            literals[purify(lit->getHead())].forceGet(lit->begin(), lit->end());
+        V *&str = literals.insert(purify(lit->getHead()), lit->begin(),
+                                  lit->end(), (V *)0);
 
         if (str == 0) {
             str = lit;
             allLits.push_back(lit);
+            vector< V * > &hs = byHead[purify(lit->getHead())];
+            headSlots.push_back(hs.size());
+            hs.push_back(lit);
             lit->setID(allLits.size() - 1);
             return 0;
         }
@@ -429,20 +446,17 @@ public:
     };
 
     V *find(V *lit) {
-        V *&str =
-            literals[purify(lit->getHead())].myGet(lit->begin(), lit->end());
-        return str;
+        V **v = literals.find(purify(lit->getHead()), lit->begin(), lit->end());
+        return v ? *v : 0;
     };
 
     set< V * > allContents(const S *p) {
-        set< V * > slits;
-        for (typename CascadeMap< VAL::const_symbol *, V >::iterator i =
-                    literals[purify(p)].begin();
-                i != literals[purify(p)].end(); ++i) {
-            slits.insert(*i);
-        };
-        slits.erase((V *)0);
-        return slits;
+        typename map< const S *, vector< V * > >::const_iterator i =
+            byHead.find(purify(p));
+        if (i == byHead.end()) return set< V * >();
+        set< V * > contents(i->second.begin(), i->second.end());
+        contents.erase(0);
+        return contents;
     };
 
     typedef typename deque< V * >::iterator iterator;
@@ -469,22 +483,46 @@ public:
     };
     template < typename TI >
     V *get(S *s, TI b, TI e) {
-        return literals[purify(s)].get(b, e);
+        V **v = literals.find(purify(s), b, e);
+        return v ? *v : 0;
     };
 
     template < typename TI >
     V *find(S *s, TI b, TI e) {
-        return literals[purify(s)].myGet(b, e);
+        return get(s, b, e);
     };
 
     void erase(const V *v) {
-        literals[purify(v->getHead())].myGet(v->begin(), v->end()) = 0;
+        const S *h = purify(v->getHead());
+        literals.erase(h, v->begin(), v->end());
+        byHead[h][headSlots[v->getID()]] = 0;
         allLits[v->getID()] = 0;
     }
 
     void clearUp() {
         allLits.erase(std::remove(allLits.begin(), allLits.end(), ((V *)0)),
                       allLits.end());
+        indexHeads();
+    }
+
+    /** @brief  Erase and free the entries for which <code>keep</code> is
+     * false, and number those kept afresh, in the same order. */
+    template < typename P >
+    void eraseUnless(P keep) {
+        size_t kept = 0;
+        for (size_t x = 0; x < allLits.size(); ++x) {
+            V *v = allLits[x];
+            if (!v) continue;
+            if (keep(static_cast< const V * >(v))) {
+                v->setID(kept);
+                allLits[kept++] = v;
+            } else {
+                literals.erase(purify(v->getHead()), v->begin(), v->end());
+                delete v;
+            };
+        };
+        allLits.resize(kept);
+        indexHeads();
     }
 
     void clear() {
@@ -495,6 +533,8 @@ public:
 
         literals.clear();
         allLits.clear();
+        byHead.clear();
+        headSlots.clear();
     }
 };
 
@@ -530,7 +570,7 @@ public:
 
 typedef PrimitiveEvaluatorConstructor< LitStoreEvaluator > LSE;
 
-class instantiatedOp {
+class instantiatedOp : public VAL::Pooled< instantiatedOp > {
 private:
     int id;
     const VAL::operator_ *op;
@@ -538,6 +578,14 @@ private:
 
     static OpStore instOps;
 
+    // While streaming, where each operator is written as it is instantiated,
+    // and the bindings of those written so far.
+    static ostream *stream;
+    static AtomTable< VAL::operator_symbol, VAL::const_symbol, bool > streamed;
+    static int streamedCount;
+
+    static void add(instantiatedOp *o);
+
     static map< VAL::pddl_type *, vector< VAL::const_symbol * > > &values;
 
     struct ActionParametersOutput {
@@ -568,6 +616,34 @@ public:
         : id(0), op(o), env(e) {};
     static void instantiate(const VAL::operator_ *op, const VAL::problem *p,
                             VAL::TypeChecker &tc);
+
+    /** @brief  Instantiate each of the operators in turn, on up to
+     * <code>jobs</code> threads.
+     *
+     * The candidate bindings of each operator are split into ranges, each
+     * ground by one thread into a shard of its own.  The shards are then
+     * added in the order a single thread would have ground them in, so the
+     * operators are given the same identifiers however many threads are used.
+     *
+     * @return  For each operator, <code>howMany()</code> once it has been
+     * instantiated.
+     */
+    static vector< int > instantiateAll(const VAL::operator_list *ops,
+                                        const VAL::problem *p,
+                                        VAL::TypeChecker &tc,
+                                        const unsigned int &jobs);
+
+    /** @brief  Write each operator to <code>o</code>, one to a line, as soon
+     * as it is instantiated, instead of keeping it.
+     *
+     * Only what is needed to recognise duplicates is kept, so the operators
+     * cannot be looked up, filtered or written again afterwards, and
+     * <code>howMany()</code> counts those written.  While streaming, operators
+     * are instantiated on one thread, so that they are written in order.
+     */
+    static void streamTo(ostream &o) {
+        stream = &o;
+    };
     ~instantiatedOp() {
         delete env;
     };
@@ -576,6 +652,19 @@ public:
      * unreachable. */
     static void filterOps(VAL::TypeChecker *const);
 
+    /** @brief  Erase the ground operators that cannot be reached from the
+     * initial state when delete effects are ignored, and the literals that
+     * only they add.  Every literal an operator kept mentions, in its
+     * preconditions or its effects, is stored and kept.
+     *
+     * Numeric fluents are approximated by intervals holding every value they
+     * could reach.  Conditions other than the positive literals and
+     * comparisons conjoined in a precondition are taken to hold, so no
+     * operator that could be applied is erased.  Call after
+     * <code>createAllLiterals</code>.
+     */
+    static void filterUnreachableOps(VAL::problem *p, VAL::TypeChecker *const);
+
     /** @brief  Assign unique identifiers to non-static literals and PNEs.
      *
      * @see Literal::stateID , PNE::stateID
@@ -620,7 +709,7 @@ public:
 
     /** @brief  Return the number of instantiated operators. */
     static int howMany() {
-        return instOps.size();
+        return instOps.size() + streamedCount;
     };
 
     /** @brief  Return the number of ground <code>Literal</code>s (including
@@ -763,6 +852,7 @@ public:
     };
 
     friend class Collector;
+    friend class GroundedTaskCache;
 
     class PropEffectsIterator {
     private:
@@ -887,7 +977,7 @@ public:
     bool isGoalMetByEffect(VAL::timed_effect *teff, const Literal *lit);
 };
 
-class instantiatedDrv {
+class instantiatedDrv : public VAL::Pooled< instantiatedDrv > {
 private:
     int id;
     const VAL::derivation_rule *op;
@@ -15,10 +15,12 @@ extern bool ErrorReport;
 extern bool InvariantWarnings;
 extern bool LaTeX;
 extern bool LaTeXRecord;
-extern ostream *report;
+extern thread_local ostream *report;
 extern int NoGraphPoints;
 extern bool makespanDefault;
 extern bool stepLengthDefault;
+extern bool bottomUpDPs;
+extern bool indexedEvents;
 
 };  // namespace VAL
 
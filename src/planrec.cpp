@@ -52,7 +52,7 @@ extern bool ErrorReport;
 extern bool InvariantWarnings;
 extern bool LaTeX;
 
-extern ostream *report;
+extern thread_local ostream *report;
 
 };  // namespace VAL
 
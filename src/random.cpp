@@ -5,8 +5,9 @@
 
 namespace VAL {
 
-NormalGen Generators::randomNumberNormGenerator = NormalGen();
-UniformGen Generators::randomNumberUniGenerator = UniformGen(0, 0, 1);
+thread_local NormalGen Generators::randomNumberNormGenerator = NormalGen();
+thread_local UniformGen Generators::randomNumberUniGenerator =
+    UniformGen(0, 0, 1);
 
 // return a random number with norm prob over -1 to 1
 double getRandomNumberNormal() {
@@ -38,4 +39,21 @@ double getRandomNumberPsuedoNormal() {
     return total / noToAverage;
 };
 
+// Restart this thread's generators on the stream of random numbers given by
+// the seed and the stream number. The seeds for the generators are drawn from
+// a hash of the pair, so the numbers drawn on a stream depend only on the pair
+// and not on which thread draws them.
+void seedRandomNumbers(unsigned long seed, uint64_t stream) {
+    unsigned long long z = seed * 0x9E3779B97F4A7C15ULL + stream;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+
+    // a zero seed would seed from the clock
+    Generators::randomNumberUniGenerator =
+        UniformGen(static_cast< UINT32 >(z) | 1, 0, 1);
+    Generators::randomNumberNormGenerator =
+        NormalGen(static_cast< UINT32 >(z >> 32) | 1);
+};
+
 };  // namespace VAL
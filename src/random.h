@@ -16,6 +16,7 @@
  */
 
 #include <cmath>
+#include <cstdint>
 #include <ctime>
 
 #ifndef __RANDOM_H
@@ -299,14 +300,17 @@ public:
     }
 };
 
+// The generators are held per thread, so that threads drawing random numbers
+// do not share generator state.
 struct Generators {
-    static UniformGen randomNumberUniGenerator;
-    static NormalGen randomNumberNormGenerator;
+    static thread_local UniformGen randomNumberUniGenerator;
+    static thread_local NormalGen randomNumberNormGenerator;
 };
 
 double getRandomNumberNormal();
 double getRandomNumberUniform();
 double getRandomNumberPsuedoNormal();
+void seedRandomNumbers(unsigned long seed, uint64_t stream);
 
 };  // namespace VAL
 
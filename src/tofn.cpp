@@ -10,14 +10,35 @@
 using namespace SAS;
 
 int main(int argc, char *argv[]) {
-    performTIMAnalysis(&argv[1]);
+    // -C <file> loads the ground operators from a cache file, grounding them
+    // and writing it if it is missing or out of date; -R erases the operators
+    // that cannot be reached even when delete effects are ignored before the
+    // layers are built.
+    int argcount = 1;
+    string cacheFile;
+    bool pruneUnreachable = false;
+    while (argc > argcount + 2 && argv[argcount][0] == '-') {
+        const string option(argv[argcount]);
+        if (option == "-R") {
+            pruneUnreachable = true;
+            ++argcount;
+        } else if (option == "-C" && argc > argcount + 3) {
+            cacheFile = argv[argcount + 1];
+            argcount += 2;
+        } else {
+            break;
+        };
+    };
+
+    performTIMAnalysis(&argv[argcount]);
     use_sasoutput = true;
     FunctionStructure fs;
     fs.normalise();
     fs.initialise();
 
     fs.processActions();
-    fs.buildLayers();
+    fs.buildLayers(cacheFile, argv[argcount], argv[argcount + 1],
+                   pruneUnreachable);
 
     fs.setUpInitialState();
     int level = 0;
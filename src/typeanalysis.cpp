@@ -17,7 +17,7 @@ using std::ofstream;
 namespace VAL {
 
 extern bool Verbose;
-extern ostream *report;
+extern thread_local ostream *report;
 extern parse_category *top_thing;
 
 extern analysis an_analysis;
@@ -25,7 +25,8 @@ void TypeHierarchy::addDown(const PTypeRef &t1, const PTypeRef &t2) {
     downGraph[&t1].insert(j->first);
 };
 
-TypeHierarchy::TypeHierarchy(const analysis *a) : leafNodes() {
+TypeHierarchy::TypeHierarchy(const analysis *a)
+    : leafNodes(), typeIndex(), subtypeBits(), rowWords(0) {
     if (!a || !a->the_domain) {
         ParseFailure pf;
         throw(pf);
@@ -55,6 +56,32 @@ TypeHierarchy::TypeHierarchy(const analysis *a) : leafNodes() {
             };
         };
     };
+    computeSubtypes();
+};
+
+void TypeHierarchy::computeSubtypes() {
+    for (GIC i = graph.begin(); i != graph.end(); ++i) {
+        typeIndex.insert(std::make_pair(**(i->first), typeIndex.size()));
+    };
+    rowWords = (typeIndex.size() + 63) / 64;
+    subtypeBits.assign(typeIndex.size() * rowWords, 0);
+
+    // Set the bits of the types reachable from each type by a search of the
+    // graph from it.
+    for (GIC i = graph.begin(); i != graph.end(); ++i) {
+        unsigned long long *const row =
+            &subtypeBits[0] + typeIndex[**(i->first)] * rowWords;
+        vector< const TypeRef * > pending(1, i->first);
+        while (!pending.empty()) {
+            const TypeRef *t = pending.back();
+            pending.pop_back();
+            const size_t j = typeIndex[**t];
+            if (row[j / 64] & (1ULL << (j % 64))) continue;
+            row[j / 64] |= 1ULL << (j % 64);
+            const Nodes &ns = graph.find(t)->second;
+            pending.insert(pending.end(), ns.begin(), ns.end());
+        };
+    };
 };
 
 TypeHierarchy::~TypeHierarchy() {
@@ -182,6 +209,32 @@ bool TypeHierarchy::reachable(const TypeRef &t1, const TypeRef &t2) {
     return closure(graph, i, ns, i, j->first);
 };
 
+bool TypeHierarchy::subtypeBit(const size_t &i1, const pddl_type *t2) const {
+    std::unordered_map< const pddl_type *, size_t >::const_iterator j =
+        typeIndex.find(t2);
+    if (j == typeIndex.end()) return false;
+    return subtypeBits[i1 * rowWords + j->second / 64] &
+           (1ULL << (j->second % 64));
+};
+
+bool TypeHierarchy::reachable(const pddl_type *t1, const pddl_type *t2) const {
+    if (t1 == t2) return true;
+    std::unordered_map< const pddl_type *, size_t >::const_iterator i =
+        typeIndex.find(t1);
+    return i != typeIndex.end() && subtypeBit(i->second, t2);
+};
+
+bool TypeHierarchy::reachable(const pddl_type *t1,
+                              const pddl_type_list *ts) const {
+    std::unordered_map< const pddl_type *, size_t >::const_iterator i =
+        typeIndex.find(t1);
+    for (pddl_type_list::const_iterator t = ts->begin(); t != ts->end(); ++t) {
+        if (*t == t1) return true;
+        if (i != typeIndex.end() && subtypeBit(i->second, *t)) return true;
+    };
+    return false;
+};
+
 void TypeHierarchy::add(const PTypeRef &t1, const TypeRef &t2) {
     Graph::const_iterator i = graph.find(&t1);
     Graph::const_iterator j = graph.find(&t2);
@@ -298,10 +351,10 @@ bool TypeChecker::subType(const pddl_typed_symbol *tp1,
     if (!isTyped) return true;
     if (tp1->type) {
         if (tp2->type) {
-            return th.reachable(PTypeRef(tp1->type), PTypeRef(tp2->type));
+            return th.reachable(tp1->type, tp2->type);
         } else {
             if (tp2->either_types) {
-                return th.reachable(PTypeRef(tp1->type), UTypeRef(tp2->either_types));
+                return th.reachable(tp1->type, tp2->either_types);
             };
             if (Verbose) *report << tp2->getName() << " has bad type definition\n";
             TypeException te;
@@ -348,7 +401,7 @@ bool TypeChecker::subType(const pddl_typed_symbol *tp1,
 bool TypeChecker::subType(const pddl_type *t, const pddl_typed_symbol *s) {
     if (!isTyped) return true;
     if (s->type) {
-        return th.reachable(PTypeRef(t), PTypeRef(s->type));
+        return th.reachable(t, s->type);
     };
 
     if (!s->either_types) {
@@ -357,7 +410,7 @@ bool TypeChecker::subType(const pddl_type *t, const pddl_typed_symbol *s) {
         throw(te);
     };
 
-    return th.reachable(PTypeRef(t), UTypeRef(s->either_types));
+    return th.reachable(t, s->either_types);
 };
 
 bool TypeChecker::subType(const pddl_type *t1, const pddl_type *t2) {
@@ -368,7 +421,7 @@ bool TypeChecker::subType(const pddl_type *t1, const pddl_type *t2) {
         throw(te);
     };
 
-    return th.reachable(PTypeRef(t1), PTypeRef(t2));
+    return th.reachable(t1, t2);
 };
 
 bool TypeChecker::typecheckProposition(const proposition *p) {
@@ -718,27 +771,34 @@ bool TypeChecker::typecheckPlan(const plan *p) {
     return p->end() == std::find_if(p->begin(), p->end(), badchecker(this));
 };
 
-vector< const_symbol * > TypeChecker::range(const var_symbol *v) {
-    vector< const_symbol * > l;
-    for (const_symbol_table::const_iterator i = thea->const_tab.begin();
-            i != thea->const_tab.end(); ++i) {
-        if (subType(i->second, v)) l.push_back(i->second);
-    };
-
-    return l;
+const vector< const_symbol * > &TypeChecker::range(const var_symbol *v) {
+    return range(static_cast< const parameter_symbol * >(v));
 };
 
-vector< const_symbol * > TypeChecker::range(const parameter_symbol *v) {
+// Nothing is removed until the checker goes: a range handed out stays valid
+// after constants are added, which only makes ranges under a new key.
+const vector< const_symbol * > &TypeChecker::range(const parameter_symbol *v) {
+    // Untyped, every constant is in range.
+    const bool byType = !isTyped || v->type;
+    const RangeKey k(thea->const_tab.size(), isTyped ? v->type : 0,
+                     byType ? 0 : v->either_types);
+    std::lock_guard< std::mutex > guard(rangesLock);
+    map< RangeKey, vector< const_symbol * > >::iterator r =
+        ranges.lower_bound(k);
+    if (r != ranges.end() && r->first == k) return r->second;
+
     vector< const_symbol * > l;
     for (const_symbol_table::const_iterator i = thea->const_tab.begin();
             i != thea->const_tab.end(); ++i) {
         if (subType(i->second, v)) l.push_back(i->second);
     };
 
-    return l;
+    r = ranges.insert(r, std::make_pair(k, vector< const_symbol * >()));
+    r->second.swap(l);
+    return r->second;
 };
 
-vector< const_symbol * > TypeChecker::range(const pddl_type *t) {
+const vector< const_symbol * > &TypeChecker::range(const pddl_type *t) {
     var_symbol v("");
     v.type = const_cast< pddl_type * >(t);  // OK - we will keep v const.
     v.either_types = 0;
@@ -5,9 +5,14 @@
 #define __TYPECHECK
 
 #include "ptree.h"
+#include <map>
+#include <mutex>
 #include <set>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 
+using std::map;
 using std::set;
 using std::vector;
 
@@ -140,10 +145,21 @@ private:
     Graph downGraph;
     Graph leafNodes;
 
+    // The transitive closure of graph over the declared types, as a bit
+    // matrix: row typeIndex[t1] has bit typeIndex[t2] set if t1 - t2.
+    std::unordered_map< const pddl_type *, size_t > typeIndex;
+    vector< unsigned long long > subtypeBits;
+    size_t rowWords;
+
+    void computeSubtypes();
+    bool subtypeBit(const size_t &i1, const pddl_type *t2) const;
+
 public:
     TypeHierarchy(const analysis *a);
     ~TypeHierarchy();
     bool reachable(const TypeRef &t1, const TypeRef &t2);
+    bool reachable(const pddl_type *t1, const pddl_type *t2) const;
+    bool reachable(const pddl_type *t1, const pddl_type_list *ts) const;
     void add(const PTypeRef &t, const TypeRef &u);
 
     const Nodes &leaves(PTypeRef &t);
@@ -156,6 +172,15 @@ private:
     TypeHierarchy th;
     const bool isTyped;
 
+    // A range is made from one number of constants, for either a type or
+    // (when typed variables carry none) an either type. Ranges live as long
+    // as the checker and are made under rangesLock, since one checker can be
+    // shared by threads checking plans concurrently.
+    typedef std::tuple< size_t, const pddl_type *, const pddl_type_list * >
+        RangeKey;
+    map< RangeKey, vector< const_symbol * > > ranges;
+    std::mutex rangesLock;
+
 public:
     TypeChecker(const analysis *a)
         : thea(a), th(a), isTyped(a->the_domain->types) {};
@@ -175,9 +200,9 @@ public:
     bool subType(const pddl_type *, const pddl_typed_symbol *);
     bool subType(const pddl_type *, const pddl_type *);
 
-    vector< const_symbol * > range(const var_symbol *v);
-    vector< const_symbol * > range(const parameter_symbol *v);
-    vector< const_symbol * > range(const pddl_type *t);
+    const vector< const_symbol * > &range(const var_symbol *v);
+    const vector< const_symbol * > &range(const parameter_symbol *v);
+    const vector< const_symbol * > &range(const pddl_type *t);
     vector< const pddl_type * > leaves(const pddl_type *t);
     vector< const pddl_type * > accumulateAll(const pddl_type *t);
     bool isLeafType(const pddl_type *t);
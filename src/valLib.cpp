@@ -41,7 +41,7 @@ bool ErrorReport = false;
 bool InvariantWarnings = false;
 bool LaTeX = false;
 TypeChecker *theTC;
-ostream *report = &std::cout;
+thread_local ostream *report = &std::cout;
 
 };  // namespace VAL
 
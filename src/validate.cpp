@@ -11,20 +11,35 @@
 #include "FlexLexer.h"
 #include "Utils.h"
 #include "ptree.h"
+#include <atomic>
 #include <cstdio>
+#include <exception>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
 #include <time.h>
 
 #include "LaTeXSupport.h"
 #include "main.h"
 
+using std::atomic;
 using std::cerr;
 using std::copy;
 using std::cout;
+using std::current_exception;
+using std::exception_ptr;
 using std::for_each;
 using std::ifstream;
+using std::lock_guard;
+using std::max;
+using std::mutex;
 using std::ofstream;
+using std::ostringstream;
+using std::rethrow_exception;
+using std::streamsize;
+using std::thread;
 
 //#define vector std::vector
 
@@ -49,7 +64,7 @@ extern bool ErrorReport;
 extern bool InvariantWarnings;
 extern bool LaTeX;
 
-extern ostream *report;
+extern thread_local ostream *report;
 };  // namespace VAL
 
 typedef map< double, vector< pair< string, vector< double > > > > Ranking;
@@ -77,6 +92,9 @@ void usage() {
             "maximum; x = a, accumulative; x = d, delay. (default x = m).\n"
          << "    -rd <x>    -- Set distribution for robustness testing: x = u, "
             "uniform; x = n, normal; x = p, psuedo-normal. (default x = u).\n"
+         << "    -rs <n>    -- Seed the random variations for robustness testing "
+            "with n, to reproduce an analysis. (default: seeded from the "
+            "clock).\n"
          << "    -j         -- When varying the values of PNEs also vary for "
             "event preconditions. (default = false)\n"
          << "    -v         -- Verbose reporting of plan check progress.\n"
@@ -93,6 +111,12 @@ void usage() {
             "graphs of PNEs (default = 500).\n"
          << "    -d         -- Do not check set of derived predicates for "
             "stratification.\n"
+         << "    -b         -- Evaluate stratified derived predicates bottom "
+            "up, materialising them in each state.\n"
+         << "    -w         -- Ground events and processes up front and check "
+            "only those whose preconditions a happening changed.\n"
+         << "    -J <n>     -- Check the plans, or the test plans for robustness, "
+            "on n threads (not with -v, -l or -e).\n"
          << "    -c         -- Continue executing plan even if an action "
             "precondition is unsatisfied.\n"
          << "    -e         -- Produce error report for the full plan, and try "
@@ -118,7 +142,7 @@ plan *getPlan(int &argc, char *argv[], int &argcount, TypeChecker &tc,
     if (LaTeX) {
         latex.LaTeXPlanReportPrepare(argv[argcount]);
     } else if (!Silent)
-        cout << "Checking plan: " << argv[argcount] << "\n";
+        *report << "Checking plan: " << argv[argcount] << "\n";
 
     ifstream planFile(argv[argcount++]);
     if (!planFile) {
@@ -190,181 +214,303 @@ void deleteTimedIntitialLiteralActions(vector< plan_step * > tila) {
     };
 };
 
-// execute all the plans in the usual manner without robustness checking
-void executePlans(int &argc, char *argv[], int &argcount, TypeChecker &tc,
-                  const DerivationRules *derivRules, double tolerance,
-                  bool lengthDefault, bool giveAdvice) {
-    Ranking rnk;
-    Ranking rnkInv;
-    vector< string > failed;
-    vector< string > queries;
+// The outcome of checking one plan. Plans checked concurrently each write
+// their report to their own output, and the outcomes are gathered in the order
+// the plans were given so that the rankings do not depend on scheduling.
+struct PlanCheck {
+    string name;
+    plan *the_plan;
+    vector< plan_step * > timedInitialLiteralActions;
+
+    bool valid;
+    bool subjectToInvariants;
+    vector< double > value;
+    bool failed;
+    bool error;
+    bool query;
+
+    ostringstream output;
+
+    PlanCheck(const string &n)
+        : name(n),
+          the_plan(0),
+          timedInitialLiteralActions(),
+          valid(false),
+          subjectToInvariants(false),
+          value(),
+          failed(false),
+          error(false),
+          query(false),
+          output() {};
+};
 
-    while (argcount < argc) {
-        string name(argv[argcount]);
+// Read the next plan named on the command line, and the timed initial
+// literals to add to it.
+void readPlan(PlanCheck &pc, int &argc, char *argv[], int &argcount,
+              TypeChecker &tc) {
+    vector< string > failed;
 
-        plan *the_plan = getPlan(argc, argv, argcount, tc, failed, name);
-        if (the_plan == 0) continue;
+    pc.the_plan = getPlan(argc, argv, argcount, tc, failed, pc.name);
+    pc.failed = !failed.empty();
+    if (pc.the_plan)
+        pc.timedInitialLiteralActions = getTimedInitialLiteralActions();
+};
 
-        plan *copythe_plan = new plan(*the_plan);
-        plan *planNoTimedLits = new plan();
-        vector< plan_step * > timedInitialLiteralActions =
-            getTimedInitialLiteralActions();
-        double deadLine = 101;
-
-        // add timed initial literals to the plan from the problem spec
-        for (vector< plan_step * >::iterator ps =
-                    timedInitialLiteralActions.begin();
-                ps != timedInitialLiteralActions.end(); ++ps) {
-            the_plan->push_back(*ps);
-        };
+// check a plan, reporting on it to report
+void checkPlan(PlanCheck &pc, TypeChecker &tc,
+               const DerivationRules *derivRules, double tolerance,
+               bool lengthDefault, bool giveAdvice) {
+    plan *the_plan = pc.the_plan;
+    plan *copythe_plan = new plan(*the_plan);
+    plan *planNoTimedLits = new plan();
+    double deadLine = 101;
+
+    // add timed initial literals to the plan from the problem spec
+    for (vector< plan_step * >::iterator ps =
+                pc.timedInitialLiteralActions.begin();
+            ps != pc.timedInitialLiteralActions.end(); ++ps) {
+        the_plan->push_back(*ps);
+    };
 
-        // add actions that are not to be moved to the timed intitial literals
-        // otherwise to the plan to be repaired i.e. pretend these actions are timed
-        // initial literals
-        for (pc_list< plan_step * >::const_iterator i = copythe_plan->begin();
-                i != copythe_plan->end(); ++i) {
-            planNoTimedLits->push_back(*i);
-        };
+    // add actions that are not to be moved to the timed intitial literals
+    // otherwise to the plan to be repaired i.e. pretend these actions are timed
+    // initial literals
+    for (pc_list< plan_step * >::const_iterator i = copythe_plan->begin();
+            i != copythe_plan->end(); ++i) {
+        planNoTimedLits->push_back(*i);
+    };
 
-        copythe_plan->clear();
-        delete copythe_plan;
+    copythe_plan->clear();
+    delete copythe_plan;
 
-        PlanRepair pr(timedInitialLiteralActions, deadLine, derivRules, tolerance,
-                      tc, an_analysis.the_domain->ops,
-                      an_analysis.the_problem->initial_state, the_plan,
-                      planNoTimedLits, an_analysis.the_problem->metric,
-                      lengthDefault, an_analysis.the_domain->isDurative(),
-                      an_analysis.the_problem->the_goal, current_analysis);
+    PlanRepair pr(pc.timedInitialLiteralActions, deadLine, derivRules, tolerance,
+                  tc, an_analysis.the_domain->ops,
+                  an_analysis.the_problem->initial_state, the_plan,
+                  planNoTimedLits, an_analysis.the_problem->metric,
+                  lengthDefault, an_analysis.the_domain->isDurative(),
+                  an_analysis.the_problem->the_goal, current_analysis);
 
-        if (LaTeX) {
-            latex.LaTeXPlanReport(&(pr.getValidator()), the_plan);
-        } else if (Verbose)
-            pr.getValidator().displayPlan();
+    if (LaTeX) {
+        latex.LaTeXPlanReport(&(pr.getValidator()), the_plan);
+    } else if (Verbose)
+        pr.getValidator().displayPlan();
 
-        bool showGraphs = false;
+    bool showGraphs = false;
 
-        try {
-            if (pr.getValidator().execute()) {
-                if (LaTeX)
-                    *report << "Plan executed successfully - checking goal\\\\\n";
-                else if (!Silent)
-                    cout << "Plan executed successfully - checking goal\n";
+    try {
+        if (pr.getValidator().execute()) {
+            if (LaTeX)
+                *report << "Plan executed successfully - checking goal\\\\\n";
+            else if (!Silent)
+                *report << "Plan executed successfully - checking goal\n";
 
-                if (pr.getValidator().checkGoal(an_analysis.the_problem->the_goal))
+            if (pr.getValidator().checkGoal(an_analysis.the_problem->the_goal))
 
-                {
-                    if (!(pr.getValidator().hasInvariantWarnings())) {
-                        vector< double > vs(pr.getValidator().finalValue());
-                        rnk[vs[0]].push_back(make_pair(name, vs));
-                        if (!Silent && !LaTeX) *report << "Plan valid\n";
-                        if (LaTeX) *report << "\\\\\n";
-                        if (!Silent && !LaTeX) *report << "Final value: ";
-                        if (Silent > 1 || (!Silent && !LaTeX)) {
-                            vector< double > vs(pr.getValidator().finalValue());
-                            for (unsigned int i = 0; i < vs.size(); ++i)
-                                *report << vs[i] << " ";
-                            *report << "\n";
-                        }
-                    } else {
+            {
+                if (!(pr.getValidator().hasInvariantWarnings())) {
+                    pc.valid = true;
+                    pc.value = pr.getValidator().finalValue();
+                    if (!Silent && !LaTeX) *report << "Plan valid\n";
+                    if (LaTeX) *report << "\\\\\n";
+                    if (!Silent && !LaTeX) *report << "Final value: ";
+                    if (Silent > 1 || (!Silent && !LaTeX)) {
                         vector< double > vs(pr.getValidator().finalValue());
-                        rnkInv[vs[0]].push_back(make_pair(name, vs));
-                        if (!Silent && !LaTeX)
-                            *report << "Plan valid (subject to further invariant checks)\n";
-                        if (LaTeX) *report << "\\\\\n";
-                        if (!Silent && !LaTeX) {
-                            *report << "Final value: ";
-                            vector< double > vs(pr.getValidator().finalValue());
-                            for (unsigned int i = 0; i < vs.size(); ++i)
-                                *report << vs[i] << " ";
-                            *report << "\n";
-                        };
-                        if (Silent > 1) {
-                            *report << "failed\n";
-                        }
-                    };
-                    if (Verbose) {
-                        pr.getValidator().reportViolations();
-                    };
+                        for (unsigned int i = 0; i < vs.size(); ++i)
+                            *report << vs[i] << " ";
+                        *report << "\n";
+                    }
                 } else {
-                    failed.push_back(name);
-                    if (Silent < 2) *report << "Goal not satisfied\n";
-                    if (Silent > 1) *report << "failed\n";
-
+                    pc.valid = true;
+                    pc.subjectToInvariants = true;
+                    pc.value = pr.getValidator().finalValue();
+                    if (!Silent && !LaTeX)
+                        *report << "Plan valid (subject to further invariant checks)\n";
                     if (LaTeX) *report << "\\\\\n";
-                    if (Silent < 2) *report << "Plan invalid\n";
-                    ++errorCount;
+                    if (!Silent && !LaTeX) {
+                        *report << "Final value: ";
+                        vector< double > vs(pr.getValidator().finalValue());
+                        for (unsigned int i = 0; i < vs.size(); ++i)
+                            *report << vs[i] << " ";
+                        *report << "\n";
+                    };
+                    if (Silent > 1) {
+                        *report << "failed\n";
+                    }
+                };
+                if (Verbose) {
+                    pr.getValidator().reportViolations();
                 };
-
             } else {
-                failed.push_back(name);
-                ++errorCount;
-                if (ContinueAnyway) {
-                    if (LaTeX)
-                        *report << "\nPlan failed to execute - checking goal\\\\\n";
-                    else {
-                        if (Silent < 2)
-                            *report << "\nPlan failed to execute - checking goal\n";
-                        if (Silent > 1) *report << "failed\n";
-                    }
-                    if (!pr.getValidator().checkGoal(an_analysis.the_problem->the_goal))
-                        *report << "\nGoal not satisfied\n";
+                pc.failed = true;
+                if (Silent < 2) *report << "Goal not satisfied\n";
+                if (Silent > 1) *report << "failed\n";
 
-                }
+                if (LaTeX) *report << "\\\\\n";
+                if (Silent < 2) *report << "Plan invalid\n";
+                pc.error = true;
+            };
 
+        } else {
+            pc.failed = true;
+            pc.error = true;
+            if (ContinueAnyway) {
+                if (LaTeX)
+                    *report << "\nPlan failed to execute - checking goal\\\\\n";
                 else {
-                    if (Silent < 2) *report << "\nPlan failed to execute\n";
+                    if (Silent < 2)
+                        *report << "\nPlan failed to execute - checking goal\n";
                     if (Silent > 1) *report << "failed\n";
                 }
-            };
-
-            if (pr.getValidator().hasInvariantWarnings()) {
-                if (LaTeX)
-                    *report << "\\\\\n\\\\\n";
-                else if (Silent < 2)
-                    *report << "\n\n";
+                if (!pr.getValidator().checkGoal(an_analysis.the_problem->the_goal))
+                    *report << "\nGoal not satisfied\n";
 
-                *report << "This plan has the following further condition(s) to check:";
+            }
 
-                if (LaTeX)
-                    *report << "\\\\\n\\\\\n";
-                else if (Silent < 2)
-                    *report << "\n\n";
+            else {
+                if (Silent < 2) *report << "\nPlan failed to execute\n";
+                if (Silent > 1) *report << "failed\n";
+            }
+        };
 
-                pr.getValidator().displayInvariantWarnings();
-            };
+        if (pr.getValidator().hasInvariantWarnings()) {
+            if (LaTeX)
+                *report << "\\\\\n\\\\\n";
+            else if (Silent < 2)
+                *report << "\n\n";
 
-            if (pr.getValidator().graphsToShow()) showGraphs = true;
-        } catch (const exception &e) {
-            if (LaTeX) {
-                *report << "\\error \\\\\n";
-                *report << "\\end{tabbing}\n";
-                *report << "Error occurred in validation attempt:\\\\\n  " << e.what()
-                        << "\n";
-            } else if (Silent < 2)
-                *report << "Error occurred in validation attempt:\n  " << e.what()
-                        << "\n";
-
-            queries.push_back(name);
-        };
+            *report << "This plan has the following further condition(s) to check:";
 
-        // display error report and plan repair advice
-        if (giveAdvice && (Verbose || ErrorReport)) {
-            pr.firstPlanAdvice();
-        };
+            if (LaTeX)
+                *report << "\\\\\n\\\\\n";
+            else if (Silent < 2)
+                *report << "\n\n";
 
-        // display LaTeX graphs of PNEs
-        if (LaTeX && showGraphs) {
-            latex.LaTeXGraphs(&(pr.getValidator()));
+            pr.getValidator().displayInvariantWarnings();
         };
 
-        // display gantt chart of plan
+        if (pr.getValidator().graphsToShow()) showGraphs = true;
+    } catch (const exception &e) {
         if (LaTeX) {
-            latex.LaTeXGantt(&(pr.getValidator()));
+            *report << "\\error \\\\\n";
+            *report << "\\end{tabbing}\n";
+            *report << "Error occurred in validation attempt:\\\\\n  " << e.what()
+                    << "\n";
+        } else if (Silent < 2)
+            *report << "Error occurred in validation attempt:\n  " << e.what()
+                    << "\n";
+
+        pc.query = true;
+    };
+
+    // display error report and plan repair advice
+    if (giveAdvice && (Verbose || ErrorReport)) {
+        pr.firstPlanAdvice();
+    };
+
+    // display LaTeX graphs of PNEs
+    if (LaTeX && showGraphs) {
+        latex.LaTeXGraphs(&(pr.getValidator()));
+    };
+
+    // display gantt chart of plan
+    if (LaTeX) {
+        latex.LaTeXGantt(&(pr.getValidator()));
+    };
+
+    planNoTimedLits->clear();
+    delete planNoTimedLits;
+    delete the_plan;
+    pc.the_plan = 0;
+};
+
+void gatherPlanCheck(const PlanCheck &pc, Ranking &rnk, Ranking &rnkInv,
+                     vector< string > &failed, vector< string > &queries) {
+    if (pc.valid)
+        (pc.subjectToInvariants ? rnkInv : rnk)[pc.value[0]].push_back(
+            make_pair(pc.name, pc.value));
+    if (pc.failed) failed.push_back(pc.name);
+    if (pc.error) ++errorCount;
+    if (pc.query) queries.push_back(pc.name);
+};
+
+// Check the plans on jobs threads. Plans are parsed here first, as the parser
+// is not reentrant, and each thread then takes the next unchecked plan.
+void checkPlansConcurrently(vector< PlanCheck * > &checks, unsigned int jobs,
+                            TypeChecker &tc, const DerivationRules *derivRules,
+                            double tolerance, bool lengthDefault,
+                            bool giveAdvice) {
+    const streamsize precision = report->precision();
+    atomic< unsigned int > next(0);
+    exception_ptr failure;
+    mutex failureLock;
+
+    vector< thread > threads;
+    for (unsigned int j = 0; j < jobs; ++j) {
+        threads.push_back(thread([&]() {
+            for (unsigned int i = next++; i < checks.size(); i = next++) {
+                PlanCheck &pc = *checks[i];
+                if (!pc.the_plan) continue;
+                report = &pc.output;
+                report->precision(precision);
+                try {
+                    checkPlan(pc, tc, derivRules, tolerance, lengthDefault,
+                              giveAdvice);
+                } catch (...) {
+                    lock_guard< mutex > lock(failureLock);
+                    if (!failure) failure = current_exception();
+                    next = checks.size();
+                };
+            };
+        }));
+    };
+
+    for (vector< thread >::iterator t = threads.begin(); t != threads.end(); ++t)
+        t->join();
+
+    if (failure) rethrow_exception(failure);
+};
+
+// execute all the plans in the usual manner without robustness checking
+void executePlans(int &argc, char *argv[], int &argcount, TypeChecker &tc,
+                  const DerivationRules *derivRules, double tolerance,
+                  bool lengthDefault, bool giveAdvice, unsigned int jobs) {
+    Ranking rnk;
+    Ranking rnkInv;
+    vector< string > failed;
+    vector< string > queries;
+
+    // Verbose, LaTeX and repair reports are written as the plan is checked,
+    // so those plans are checked one at a time.
+    if (jobs > 1 && !Verbose && !LaTeX && !ErrorReport) {
+        ostream *const out = report;
+        vector< PlanCheck * > checks;
+        while (argcount < argc) {
+            PlanCheck *pc = new PlanCheck(argv[argcount]);
+            report = &pc->output;
+            report->precision(out->precision());
+            readPlan(*pc, argc, argv, argcount, tc);
+            checks.push_back(pc);
         };
+        report = out;
 
-        planNoTimedLits->clear();
-        delete planNoTimedLits;
-        delete the_plan;
+        checkPlansConcurrently(checks, jobs, tc, derivRules, tolerance,
+                               lengthDefault, giveAdvice);
+
+        for (vector< PlanCheck * >::iterator i = checks.begin();
+                i != checks.end(); ++i) {
+            *report << (*i)->output.str();
+            gatherPlanCheck(**i, rnk, rnkInv, failed, queries);
+            delete *i;
+        };
+    } else {
+        while (argcount < argc) {
+            PlanCheck pc(argv[argcount]);
+            readPlan(pc, argc, argv, argcount, tc);
+            if (pc.the_plan)
+                checkPlan(pc, tc, derivRules, tolerance, lengthDefault,
+                          giveAdvice);
+            gatherPlanCheck(pc, rnk, rnkInv, failed, queries);
+        };
     };
 
     if (!rnk.empty()) {
@@ -471,7 +617,8 @@ void analysePlansForRobustness(int &argc, char *argv[], int &argcount,
                                double tolerance, bool lengthDefault,
                                bool giveAdvice, double robustMeasure,
                                int noTestPlans, bool car, bool cpr,
-                               RobustMetric robm, RobustDist robd) {
+                               RobustMetric robm, RobustDist robd,
+                               unsigned int jobs) {
     vector< string > failed;
     srand(time(0));  // Initialize random number generator.
     vector< plan_step * > timedIntitialLiteralActions =
@@ -487,7 +634,8 @@ void analysePlansForRobustness(int &argc, char *argv[], int &argcount,
             an_analysis.the_domain->ops, an_analysis.the_problem->initial_state,
             the_plan, an_analysis.the_problem->metric, lengthDefault,
             an_analysis.the_domain->isDurative(), an_analysis.the_problem->the_goal,
-            current_analysis, timedIntitialLiteralActions, car, cpr, robm, robd);
+            current_analysis, timedIntitialLiteralActions, car, cpr, robm, robd,
+            jobs);
 
         rpa.analyseRobustness();
 
@@ -517,16 +665,20 @@ int main(int argc, char *argv[]) {
         EventPNEJuddering = false;
         TestingPNERobustness = false;
         RobustPNEJudder = 0;
+        RobustSeed = 0;
 
         InvariantWarnings = false;
         LaTeX = false;
         ofstream possibleLatexReport;
         makespanDefault = false;
         stepLengthDefault = false;
+        bottomUpDPs = false;
+        indexedEvents = false;
         bool CheckDPs = true;
         bool giveAdvice = true;
 
         double tolerance = 0.01;
+        unsigned int jobs = 1;
         bool lengthDefault = true;
         double robustMeasure = 0;
         int noTestPlans = 1000;
@@ -576,6 +728,9 @@ int main(int argc, char *argv[]) {
 
                     ++argcount;
 
+                } else if (argv[argcount - 1][2] == 's') {
+                    RobustSeed = strtoul(argv[argcount++], 0, 10);
+
                 } else if (argv[argcount - 1][2] == 'd') {
                     if (argv[argcount][0] == 'u')
                         robustDist = UNIFORM;
@@ -629,6 +784,12 @@ int main(int argc, char *argv[]) {
                 ++argcount;
                 break;
 
+            case 'J':
+
+                jobs = max(atoi(argv[++argcount]), 1);
+                ++argcount;
+                break;
+
             case 'g':
 
                 lengthDefault = false;
@@ -659,6 +820,18 @@ int main(int argc, char *argv[]) {
                 ++argcount;
                 break;
 
+            case 'b':
+
+                bottomUpDPs = true;
+                ++argcount;
+                break;
+
+            case 'w':
+
+                indexedEvents = true;
+                ++argcount;
+                break;
+
             case 'i':
 
                 InvariantWarnings = true;
@@ -818,10 +991,10 @@ int main(int argc, char *argv[]) {
             analysePlansForRobustness(
                 argc, argv, argcount, tc, derivRules, tolerance, lengthDefault,
                 giveAdvice, robustMeasure, noTestPlans, calculateActionRobustness,
-                calculatePNERobustness, robustMetric, robustDist);
+                calculatePNERobustness, robustMetric, robustDist, jobs);
         else
             executePlans(argc, argv, argcount, tc, derivRules, tolerance,
-                         lengthDefault, giveAdvice);
+                         lengthDefault, giveAdvice, jobs);
 
         delete derivRules;
 
@@ -0,0 +1,41 @@
+# Runs the instantiate command lines FIRST and then SECOND, their arguments
+# separated by '|', and fails unless both write the same set of ground
+# operators, each of them once. Operators are the lines that start with '('
+# before the list of literals, in whatever order they are written.
+#
+#   cmake -DFIRST=... -DSECOND=... -P compare-operator-sets.cmake
+
+cmake_policy(VERSION 3.6)
+
+function(operator_lines commandLine result)
+    string(REPLACE "|" ";" command "${commandLine}")
+    execute_process(COMMAND ${command}
+        OUTPUT_VARIABLE output
+        RESULT_VARIABLE status)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "${commandLine} exited with ${status}")
+    endif()
+    string(FIND "${output}" "List of all literals:" literals)
+    if(literals GREATER -1)
+        string(SUBSTRING "${output}" 0 ${literals} output)
+    endif()
+    string(REPLACE ";" "\\;" output "${output}")
+    string(REPLACE "\n" ";" lines "${output}")
+    list(FILTER lines INCLUDE REGEX "^\\(")
+    set(unique ${lines})
+    list(REMOVE_DUPLICATES unique)
+    list(LENGTH lines count)
+    list(LENGTH unique uniqueCount)
+    if(NOT count EQUAL uniqueCount)
+        message(FATAL_ERROR "${commandLine} writes some operators more than once")
+    endif()
+    list(SORT lines)
+    set(${result} "${lines}" PARENT_SCOPE)
+endfunction()
+
+operator_lines("${FIRST}" firstOperators)
+operator_lines("${SECOND}" secondOperators)
+
+if(NOT firstOperators STREQUAL secondOperators)
+    message(FATAL_ERROR "The operators differ:\n${firstOperators}\n--- and ---\n${secondOperators}")
+endif()
@@ -0,0 +1,26 @@
+# Runs the command line FIRST and then SECOND, their arguments separated by
+# '|', and fails unless both write the same output and exit with the same
+# status. If REMOVE is set, that file is deleted before FIRST runs.
+#
+#   cmake -DFIRST=... -DSECOND=... [-DREMOVE=<file>] -P compare-outputs.cmake
+
+if(REMOVE)
+    file(REMOVE ${REMOVE})
+endif()
+
+string(REPLACE "|" ";" first "${FIRST}")
+string(REPLACE "|" ";" second "${SECOND}")
+
+execute_process(COMMAND ${first}
+    OUTPUT_VARIABLE firstOutput
+    RESULT_VARIABLE firstResult)
+execute_process(COMMAND ${second}
+    OUTPUT_VARIABLE secondOutput
+    RESULT_VARIABLE secondResult)
+
+if(NOT firstOutput STREQUAL secondOutput)
+    message(FATAL_ERROR "The outputs differ:\n${firstOutput}\n--- and ---\n${secondOutput}")
+endif()
+if(NOT firstResult STREQUAL secondResult)
+    message(FATAL_ERROR "The exit statuses differ: ${firstResult} and ${secondResult}")
+endif()
@@ -0,0 +1,125 @@
+// Copyright 2019 - University of Strathclyde, King's College London and Schlumberger Ltd
+// This source code is licensed under the BSD license found in the LICENSE file in the root directory of this source tree.
+
+#include "Evaluator.h"
+#include "SimpleEval.h"
+#include "TIM.h"
+#include "Validator.h"
+#include "graphconstruct.h"
+#include "instantiation.h"
+#include "ptree.h"
+#include "typecheck.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+using std::cout;
+using std::ostringstream;
+
+using namespace TIM;
+using namespace Inst;
+using namespace VAL;
+
+// Grounds a domain and problem and reports, for the initial state, what each
+// of the graph structures makes of it: whether the counted plan graph is the
+// same as the one built by scanning, the relaxed plan heuristics, how many
+// operators the successor generator finds applicable, and how many of those
+// whose conditions it matches the rest of their precondition rules out.  Both
+// forms of the successor generator are checked against evaluating every
+// operator in turn.
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        cout << "Usage: plangraphs <domain> <problem>\n";
+        return 1;
+    };
+    performTIMAnalysis(&argv[1]);
+    SimpleEvaluator::setInitialState();
+    instantiatedOp::instantiateAll(current_analysis->the_domain->ops,
+                                   current_analysis->the_problem, *theTC, 1);
+    instantiatedOp::createAllLiterals(current_analysis->the_problem, theTC);
+    instantiatedOp::filterOps(theTC);
+    instantiatedOp::filterUnreachableOps(current_analysis->the_problem, theTC);
+
+    // Both graphs are written out so that they can be compared.
+    ostringstream scanned;
+    ostringstream counted;
+    int levels = 0;
+    {
+        PlanGraph pg(new GraphFactory);
+        while (!pg.extendPlanGraph()) ++levels;
+        scanned << pg;
+    };
+    {
+        PlanGraph pg(new GraphFactory, true);
+        while (!pg.extendPlanGraph());
+        counted << pg;
+    };
+    cout << "\nlevels " << levels << "\n";
+    cout << (scanned.str() == counted.str() ? "same" : "different")
+         << " graphs\n";
+
+    vector< unsigned int > initial;
+    vector< SuccessorGenerator::Word > packed;
+    for (pc_list< simple_effect * >::const_iterator i =
+                current_analysis->the_problem->initial_state->add_effects
+                    .begin();
+            i != current_analysis->the_problem->initial_state->add_effects.end();
+            ++i) {
+        Literal lit((*i)->prop, 0);
+        const unsigned int id = instantiatedOp::findLiteral(&lit)->getGlobalID();
+        initial.push_back(id);
+        const unsigned int w = id / SuccessorGenerator::wordBits;
+        if (w >= packed.size()) packed.resize(w + 1, 0);
+        packed[w] |= SuccessorGenerator::Word(1)
+                     << (id % SuccessorGenerator::wordBits);
+    };
+
+    CompactPlanGraph cpg;
+    RelaxedPlanHeuristic h(cpg);
+    cout << "hmax " << h.evaluate(initial, RelaxedPlanHeuristic::HMAX)
+         << " hadd " << h.evaluate(initial, RelaxedPlanHeuristic::HADD)
+         << " ff " << h.evaluate(initial, RelaxedPlanHeuristic::FF) << "\n";
+
+    SuccessorGenerator sg;
+    vector< unsigned int > applicable;
+    sg.applicable(packed, applicable);
+    cout << "applicable " << applicable.size() << "\n";
+
+    Validator v(new DerivationRules(current_analysis->the_domain->drvs,
+                                    current_analysis->the_domain->ops),
+                0.01, *theTC, current_analysis->the_domain->ops,
+                current_analysis->the_problem->initial_state,
+                current_analysis->the_problem->metric, true, true,
+                current_analysis->the_domain->constraints,
+                current_analysis->the_problem->constraints);
+    vector< instantiatedOp * > evaluated;
+    for (OpStore::iterator i = instantiatedOp::opsBegin();
+            i != instantiatedOp::opsEnd(); ++i) {
+        Evaluator ev(&v, &v.getState(), *i);
+        (*i)->forOp()->visit(&ev);
+        if (ev()) evaluated.push_back(*i);
+    };
+    vector< instantiatedOp * > found;
+    sg.applicable(&v, &v.getState(), found);
+
+    vector< instantiatedOp * > matched;
+    vector< instantiatedOp * > decided;
+    for (vector< unsigned int >::const_iterator op = applicable.begin();
+            op != applicable.end(); ++op) {
+        matched.push_back(sg.getOp(*op));
+        if (sg.isDecided(*op)) decided.push_back(sg.getOp(*op));
+    };
+    std::sort(evaluated.begin(), evaluated.end());
+    std::sort(found.begin(), found.end());
+    std::sort(matched.begin(), matched.end());
+    std::sort(decided.begin(), decided.end());
+    const bool same =
+        found == evaluated &&
+        std::includes(matched.begin(), matched.end(), evaluated.begin(),
+                      evaluated.end()) &&
+        std::includes(evaluated.begin(), evaluated.end(), decided.begin(),
+                      decided.end());
+    cout << "rejected " << matched.size() - evaluated.size() << "\n"
+         << (same ? "same" : "different") << " as evaluated\n";
+    return 0;
+};
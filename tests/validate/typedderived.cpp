@@ -0,0 +1,73 @@
+// Copyright 2019 - University of Strathclyde, King's College London and Schlumberger Ltd
+// This source code is licensed under the BSD license found in the LICENSE file in the root directory of this source tree.
+
+#include "Proposition.h"
+#include "TIM.h"
+#include "Validator.h"
+#include "ptree.h"
+#include "typecheck.h"
+#include <iostream>
+#include <set>
+
+using std::cout;
+using std::set;
+
+using namespace TIM;
+using namespace VAL;
+
+// Runs TIM over the typed-derived domain, whose derived predicate reach is
+// read by each action and by its own rule through variables of different
+// types, so that TIM gives each of those reads a differently typed copy of the
+// predicate.  Reports how many heads name reach, how many ground derived atoms
+// (reach t1 l3) read through each of them comes to, and what a Validator
+// makes of each in the initial state.
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        cout << "Usage: typedderived <domain> <problem>\n";
+        return 1;
+    };
+    performTIMAnalysis(&argv[1]);
+
+    vector< const simple_goal * > reads;
+    for (operator_list::const_iterator i =
+                current_analysis->the_domain->ops->begin();
+            i != current_analysis->the_domain->ops->end(); ++i) {
+        reads.push_back(dynamic_cast< const simple_goal * >((*i)->precondition));
+    };
+    // (or (at ?v ?l) (exists (?m) (and (link ?m ?l) (reach ?v ?m))))
+    const derivation_rule *rule = current_analysis->the_domain->drvs->front();
+    const disj_goal *body = dynamic_cast< const disj_goal * >(rule->get_body());
+    const qfied_goal *some =
+        dynamic_cast< const qfied_goal * >(body->getGoals()->back());
+    const conj_goal *step = dynamic_cast< const conj_goal * >(some->getGoal());
+    reads.push_back(
+        dynamic_cast< const simple_goal * >(step->getGoals()->back()));
+
+    Validator v(new DerivationRules(current_analysis->the_domain->drvs,
+                                    current_analysis->the_domain->ops),
+                0.01, *theTC, current_analysis->the_domain->ops,
+                current_analysis->the_problem->initial_state,
+                current_analysis->the_problem->metric, true, true,
+                current_analysis->the_domain->constraints,
+                current_analysis->the_problem->constraints);
+
+    const const_symbol *t1 = current_analysis->const_tab.symbol_probe("t1");
+    const const_symbol *l3 = current_analysis->const_tab.symbol_probe("l3");
+    set< const pred_symbol * > heads;
+    set< unsigned int > atoms;
+    for (vector< const simple_goal * >::const_iterator i = reads.begin();
+            i != reads.end(); ++i) {
+        const proposition *p = (*i)->getProp();
+        heads.insert(p->head);
+        Environment bs;
+        bs[dynamic_cast< const var_symbol * >(p->args->front())] = t1;
+        bs[dynamic_cast< const var_symbol * >(p->args->back())] = l3;
+        atoms.insert(DerivedGoal::getDPID(p, bs));
+        const Proposition *dg = v.pf.buildProposition(*i, bs);
+        cout << *dg << " "
+             << (dg->evaluate(&v.getState()) ? "true" : "false") << "\n";
+        dg->destroy();
+    };
+    cout << "heads " << heads.size() << "\natoms " << atoms.size() << "\n";
+    return 0;
+};